@@ -0,0 +1,269 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "acl_queue.h"
+
+static acl_queue_link_t * m_p_links;
+static uint8_t            m_count;
+static uint8_t            m_next;       /* Link served first on the next turn */
+static uint8_t            m_turn;       /* Counts acl_queue_service() calls */
+static uint32_t           m_unbound;    /* Packets dropped for a handle without a link */
+
+
+static uint16_t m_handle_get(uint8_t const * p_packet)
+{
+    return (uint16_t)((p_packet[1] | (p_packet[2] << 8)) & 0x0FFF);
+}
+
+/* Link bound to a handle, or NULL. */
+static acl_queue_link_t * m_link_find(uint16_t handle)
+{
+    for (uint8_t i = 0; i < m_count; i++)
+    {
+        if (m_p_links[i].bound && m_p_links[i].stats.handle == handle)
+        {
+            return &m_p_links[i];
+        }
+    }
+    return NULL;
+}
+
+/* Drop the packets queued on a link. */
+static void m_link_flush(acl_queue_link_t * p_link, void (* free)(uint8_t * p_packet))
+{
+    while (p_link->stats.depth > 0)
+    {
+        free(p_link->q[p_link->out]);
+        p_link->out = (uint8_t)((p_link->out + 1) % RX_POOL_COUNT);
+        p_link->stats.depth--;
+        p_link->stats.dropped++;
+    }
+    p_link->blocked = false;
+}
+
+/* Bind an empty link to a handle, preferring one that is not bound. Links that are bound but
+   empty may belong to a connection that was closed without the event being seen. */
+static acl_queue_link_t * m_link_bind(uint16_t handle)
+{
+    acl_queue_link_t * p_link = NULL;
+
+    for (uint8_t i = 0; i < m_count; i++)
+    {
+        if (m_p_links[i].stats.depth == 0 && (p_link == NULL || !m_p_links[i].bound))
+        {
+            p_link = &m_p_links[i];
+            if (!p_link->bound)
+            {
+                break;
+            }
+        }
+    }
+
+    if (p_link != NULL)
+    {
+        memset(p_link, 0, sizeof(*p_link));
+        p_link->bound = true;
+        p_link->stats.handle = handle;
+    }
+    return p_link;
+}
+
+void acl_queue_init(acl_queue_link_t * p_links, uint8_t count)
+{
+    m_p_links = p_links;
+    m_count = count;
+    m_next = 0;
+    m_turn = 0;
+    m_unbound = 0;
+
+    memset(p_links, 0, count * sizeof(p_links[0]));
+    for (uint8_t i = 0; i < count; i++)
+    {
+        p_links[i].stats.handle = ACL_QUEUE_HANDLE_NONE;
+    }
+}
+
+void acl_queue_open(uint16_t handle)
+{
+    if (m_link_find(handle) == NULL)
+    {
+        (void)m_link_bind(handle);
+    }
+}
+
+void acl_queue_add(uint8_t * p_packet, uint32_t now, void (* free)(uint8_t * p_packet))
+{
+    acl_queue_link_t * p_link = m_link_find(m_handle_get(p_packet));
+    uint8_t            in;
+
+    if (p_link == NULL)
+    {
+        free(p_packet);
+        m_unbound++;
+        return;
+    }
+
+    in = (uint8_t)((p_link->out + p_link->stats.depth) % RX_POOL_COUNT);
+    p_link->q[in] = p_packet;
+    p_link->times[in] = now;
+    p_link->stats.depth++;
+    if (p_link->stats.depth > p_link->stats.depth_max)
+    {
+        p_link->stats.depth_max = p_link->stats.depth;
+    }
+}
+
+uint8_t acl_queue_service(acl_queue_put_t put, uint32_t now, uint8_t max)
+{
+    uint8_t passed = 0;
+    bool    progress;
+
+    if (m_count == 0)
+    {
+        return 0;
+    }
+
+    m_turn++;
+    do
+    {
+        progress = false;
+        for (uint8_t i = 0; i < m_count && passed < max; i++)
+        {
+            acl_queue_link_t *     p_link = &m_p_links[(m_next + i) % m_count];
+            acl_queue_put_result_t result;
+            uint32_t               wait;
+
+            if (p_link->stats.depth == 0 || (p_link->blocked && p_link->blocked_turn == m_turn))
+            {
+                continue;
+            }
+
+            result = put(p_link->q[p_link->out], p_link->blocked);
+            if (result == ACL_QUEUE_PUT_FULL)
+            {
+                p_link->blocked = true;
+                p_link->blocked_turn = m_turn;
+                p_link->stats.rejections++;
+                continue;
+            }
+
+            if (result == ACL_QUEUE_PUT_DROPPED)
+            {
+                p_link->stats.dropped++;
+            }
+            else
+            {
+                wait = now - p_link->times[p_link->out];
+                p_link->stats.packets++;
+                p_link->stats.wait_total += wait;
+                if (wait > p_link->stats.wait_max)
+                {
+                    p_link->stats.wait_max = wait;
+                }
+                p_link->progress_time = now;
+                p_link->stale = false;
+            }
+            p_link->out = (uint8_t)((p_link->out + 1) % RX_POOL_COUNT);
+            p_link->stats.depth--;
+            p_link->blocked = false;
+            progress = true;
+            passed++;
+        }
+    } while (progress && passed < max);
+
+    m_next = (uint8_t)((m_next + 1) % m_count);
+    return passed;
+}
+
+void acl_queue_expire(uint32_t now, uint32_t age, void (* free)(uint8_t * p_packet))
+{
+    for (uint8_t i = 0; i < m_count; i++)
+    {
+        acl_queue_link_t * p_link = &m_p_links[i];
+        uint32_t           idle;
+
+        if (p_link->stats.depth == 0)
+        {
+            continue;
+        }
+
+        /* The packet at the head may have been queued after the last one was passed on. */
+        idle = now - p_link->progress_time;
+        if (now - p_link->times[p_link->out] < idle)
+        {
+            idle = now - p_link->times[p_link->out];
+        }
+        /* Once expired, the link drops what the controller turns away until it takes a
+           packet again, rather than holding the buffers for another age. */
+        if (idle > age || (p_link->stale && p_link->blocked))
+        {
+            m_link_flush(p_link, free);
+            p_link->stale = true;
+        }
+    }
+}
+
+void acl_queue_close(uint16_t handle, void (* free)(uint8_t * p_packet))
+{
+    acl_queue_link_t * p_link = m_link_find(handle);
+
+    if (p_link == NULL)
+    {
+        return;
+    }
+
+    m_link_flush(p_link, free);
+    p_link->bound = false;
+}
+
+void acl_queue_close_all(void (* free)(uint8_t * p_packet))
+{
+    for (uint8_t i = 0; i < m_count; i++)
+    {
+        m_link_flush(&m_p_links[i], free);
+        m_p_links[i].bound = false;
+    }
+}
+
+bool acl_queue_pending(void)
+{
+    for (uint8_t i = 0; i < m_count; i++)
+    {
+        if (m_p_links[i].stats.depth > 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t acl_queue_stats_get(acl_queue_stats_t * p_stats, uint8_t count, uint32_t * p_unbound, bool reset)
+{
+    if (count > m_count)
+    {
+        count = m_count;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        p_stats[i] = m_p_links[i].stats;
+    }
+    *p_unbound = m_unbound;
+
+    if (reset)
+    {
+        m_unbound = 0;
+        for (uint8_t i = 0; i < m_count; i++)
+        {
+            acl_queue_stats_t * p_link_stats = &m_p_links[i].stats;
+
+            p_link_stats->depth_max = p_link_stats->depth;
+            p_link_stats->packets = 0;
+            p_link_stats->rejections = 0;
+            p_link_stats->dropped = 0;
+            p_link_stats->wait_max = 0;
+            p_link_stats->wait_total = 0;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,95 @@
+#ifndef ACL_QUEUE_H__
+#define ACL_QUEUE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rx_pool.h"
+
+/* ACL data from the host, queued per connection handle on its way to the controller. The
+   controller takes data for each link into that link's own buffers, so a link whose buffers
+   are full must not hold up the others: each link has its own FIFO, and the links are served
+   round robin, one packet each a turn, skipping those the controller has turned away.
+
+   Packets stay in their rx_pool buffers, so a FIFO holds up to RX_POOL_COUNT of them. A link
+   is bound to a handle when the controller reports the connection, and released when it is
+   closed. Data for a handle without a link is dropped, as is the data of a link that has
+   passed nothing on for too long, so that stray packets cannot hold on to the pool buffers
+   reception depends on. All functions are called from the HCI jobs only. Times are in ticks
+   of the caller's clock. */
+#define ACL_QUEUE_HANDLE_NONE 0xFFFF
+
+typedef struct
+{
+    uint16_t handle;            /* ACL_QUEUE_HANDLE_NONE if never bound */
+    uint8_t  depth;             /* Packets queued now */
+    uint8_t  depth_max;         /* Most packets queued at once */
+    uint32_t packets;           /* Passed on to the controller */
+    uint32_t rejections;        /* Times the controller turned a packet of the link away */
+    uint32_t dropped;           /* Refused by the controller as invalid, or still queued when the
+                                   connection was closed or the link stalled */
+    uint32_t wait_max;          /* Longest a packet waited in the queue */
+    uint64_t wait_total;
+} acl_queue_stats_t;
+
+typedef struct
+{
+    uint8_t *         q[RX_POOL_COUNT];
+    uint32_t          times[RX_POOL_COUNT];   /* When each packet was queued */
+    uint8_t           out;
+    bool              bound;
+    bool              blocked;                /* The head packet was turned away */
+    uint8_t           blocked_turn;           /* acl_queue_service() call it was turned away in */
+    uint32_t          progress_time;          /* When a packet was last passed on */
+    bool              stale;                  /* Expired, and nothing passed on since */
+    acl_queue_stats_t stats;
+} acl_queue_link_t;
+
+/* What became of a packet handed to the controller. */
+typedef enum
+{
+    ACL_QUEUE_PUT_TAKEN,        /* Taken by the controller */
+    ACL_QUEUE_PUT_FULL,         /* No buffer for the link now, the packet is kept and retried */
+    ACL_QUEUE_PUT_DROPPED       /* Refused for good, the packet is dropped */
+} acl_queue_put_result_t;
+
+/* Hand a packet to the controller. retry is set if it was turned away before. A packet that
+   is taken or dropped is owned by the function from then on. */
+typedef acl_queue_put_result_t (* acl_queue_put_t)(uint8_t * p_packet, bool retry);
+
+void acl_queue_init(acl_queue_link_t * p_links, uint8_t count);
+
+/* The controller has reported a connection: bind a link to its handle. A link that is bound
+   but empty is taken if none is free, as its connection may have been closed unseen. */
+void acl_queue_open(uint16_t handle);
+
+/* Queue an H4 ACL packet on the link of its handle, or hand it to free() if the handle has
+   no link. */
+void acl_queue_add(uint8_t * p_packet, uint32_t now, void (* free)(uint8_t * p_packet));
+
+/* Pass queued packets to put() until each link is empty or turned away, or max packets have
+   been passed. Returns the number passed. */
+uint8_t acl_queue_service(acl_queue_put_t put, uint32_t now, uint8_t max);
+
+/* Hand the packets of every link that has passed nothing on for longer than age, counted
+   from when its oldest packet was queued if that is later, to free(). The link stays bound,
+   but until it passes a packet on again, what the controller turns away is dropped on the
+   next call as well. */
+void acl_queue_expire(uint32_t now, uint32_t age, void (* free)(uint8_t * p_packet));
+
+/* The connection of a handle has been closed: release its link, handing the packets still
+   queued to free(). */
+void acl_queue_close(uint16_t handle, void (* free)(uint8_t * p_packet));
+
+/* The controller has been reset, which closes every connection without an event. */
+void acl_queue_close_all(void (* free)(uint8_t * p_packet));
+
+/* Packets are queued on some link. */
+bool acl_queue_pending(void);
+
+/* Copy the statistics of up to count links, and the number of packets dropped for a handle
+   without a link, and clear the counters if reset is set. Returns the number of links
+   copied. */
+uint8_t acl_queue_stats_get(acl_queue_stats_t * p_stats, uint8_t count, uint32_t * p_unbound, bool reset);
+
+#endif // ACL_QUEUE_H__
@@ -0,0 +1,18 @@
+#ifndef CRC16_H__
+#define CRC16_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* CRC-CCITT (x^16 + x^12 + x^5 + 1) as used by the Three-wire UART (H5) data integrity
+   check: bits are processed least significant first, starting from CRC16_CCITT_INIT, and the
+   result is bit reversed before it is sent most significant byte first. Table driven, one
+   lookup per byte. */
+#define CRC16_CCITT_INIT 0xFFFF
+
+uint16_t crc16_ccitt_update(uint16_t crc, uint8_t const * p_data, size_t length);
+
+/* Bit reverse the result of crc16_ccitt_update for H5. */
+uint16_t crc16_bit_reverse(uint16_t crc);
+
+#endif // CRC16_H__
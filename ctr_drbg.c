@@ -0,0 +1,92 @@
+#include <string.h>
+
+#include "ctr_drbg.h"
+#include "sdc_soc.h"
+
+
+static void m_v_increment(uint8_t * p_v)
+{
+    /* V is a big endian counter, the whole block wide. */
+    for (int i = CTR_DRBG_BLOCK_SIZE - 1; i >= 0; i--)
+    {
+        if (++p_v[i] != 0)
+        {
+            break;
+        }
+    }
+}
+
+static int32_t m_block_encrypt(ctr_drbg_t * p_drbg, uint8_t * p_block)
+{
+    m_v_increment(p_drbg->v);
+    return sdc_soc_ecb_block_encrypt(p_drbg->key, p_drbg->v, p_block);
+}
+
+/* CTR_DRBG_Update: the next two blocks, XORed with the provided data if any, are the new key
+   and V. */
+static int32_t m_update(ctr_drbg_t * p_drbg, uint8_t const * p_data)
+{
+    uint8_t temp[CTR_DRBG_SEED_SIZE];
+    int32_t err_code;
+
+    err_code = m_block_encrypt(p_drbg, &temp[0]);
+    if (err_code == 0)
+    {
+        err_code = m_block_encrypt(p_drbg, &temp[CTR_DRBG_BLOCK_SIZE]);
+    }
+    if (err_code != 0)
+    {
+        return err_code;
+    }
+
+    if (p_data != NULL)
+    {
+        for (uint8_t i = 0; i < CTR_DRBG_SEED_SIZE; i++)
+        {
+            temp[i] ^= p_data[i];
+        }
+    }
+
+    memcpy(p_drbg->key, &temp[0], CTR_DRBG_KEY_SIZE);
+    memcpy(p_drbg->v, &temp[CTR_DRBG_KEY_SIZE], CTR_DRBG_BLOCK_SIZE);
+    return 0;
+}
+
+int32_t ctr_drbg_instantiate(ctr_drbg_t * p_drbg, uint8_t const * p_seed)
+{
+    memset(p_drbg->key, 0, sizeof(p_drbg->key));
+    memset(p_drbg->v, 0, sizeof(p_drbg->v));
+    return ctr_drbg_reseed(p_drbg, p_seed);
+}
+
+int32_t ctr_drbg_reseed(ctr_drbg_t * p_drbg, uint8_t const * p_seed)
+{
+    int32_t err_code = m_update(p_drbg, p_seed);
+
+    p_drbg->reseed_counter = 1;
+    return err_code;
+}
+
+int32_t ctr_drbg_generate(ctr_drbg_t * p_drbg, uint8_t * p_buff, uint16_t length)
+{
+    uint8_t block[CTR_DRBG_BLOCK_SIZE];
+    int32_t err_code = 0;
+
+    while (err_code == 0 && length >= CTR_DRBG_BLOCK_SIZE)
+    {
+        err_code = m_block_encrypt(p_drbg, p_buff);
+        p_buff += CTR_DRBG_BLOCK_SIZE;
+        length -= CTR_DRBG_BLOCK_SIZE;
+    }
+    if (err_code == 0 && length > 0)
+    {
+        err_code = m_block_encrypt(p_drbg, block);
+        memcpy(p_buff, block, length);
+    }
+    if (err_code == 0)
+    {
+        err_code = m_update(p_drbg, NULL);
+    }
+    p_drbg->reseed_counter++;
+    return err_code;
+}
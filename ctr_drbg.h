@@ -0,0 +1,33 @@
+#ifndef CTR_DRBG_H__
+#define CTR_DRBG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* CTR_DRBG with AES-128 and no derivation function (NIST SP 800-90A, 10.2.1), without
+   personalisation string or additional input. The seed is full entropy, as many bytes as the
+   key and V together. Blocks are encrypted with sdc_soc_ecb_block_encrypt, on the ECB
+   peripheral, which the SoftDevice Controller shares with the application that way. The host
+   build has a software AES behind the same function.
+
+   A state must only be used from one context at a time. The functions return 0, or the error
+   of sdc_soc_ecb_block_encrypt, after which the state must be instantiated again. */
+#define CTR_DRBG_KEY_SIZE   16
+#define CTR_DRBG_BLOCK_SIZE 16
+#define CTR_DRBG_SEED_SIZE  (CTR_DRBG_KEY_SIZE + CTR_DRBG_BLOCK_SIZE)
+
+typedef struct
+{
+    uint8_t  key[CTR_DRBG_KEY_SIZE];
+    uint8_t  v[CTR_DRBG_BLOCK_SIZE];
+    uint32_t reseed_counter;        /* Generate requests since the last (re)seed, plus one */
+} ctr_drbg_t;
+
+int32_t ctr_drbg_instantiate(ctr_drbg_t * p_drbg, uint8_t const * p_seed);
+int32_t ctr_drbg_reseed(ctr_drbg_t * p_drbg, uint8_t const * p_seed);
+
+/* Fill p_buff with length bytes, then update the state so that they cannot be recovered from
+   it. Costs one block encryption per 16 bytes, plus two. p_buff is undefined on an error. */
+int32_t ctr_drbg_generate(ctr_drbg_t * p_drbg, uint8_t * p_buff, uint16_t length);
+
+#endif // CTR_DRBG_H__
@@ -0,0 +1,305 @@
+#include <string.h>
+
+#include "h4_parser.h"
+#include "ramfunc.h"
+
+typedef enum
+{
+    STATE_HEADER,       /* Collecting the type and header in header[] */
+    STATE_CONTENT,      /* Receiving the rest of the packet into p_packet */
+    STATE_WAIT,         /* The header is complete, waiting for a buffer */
+    STATE_RESYNC,       /* Scanning header[] for the start of a plausible packet */
+} state_t;
+
+/* Header size and length field of a packet type, offsets counted from the type byte. */
+typedef struct
+{
+    uint8_t  header_size;       /* 0 for an unknown type */
+    uint8_t  length_offset;
+    uint8_t  length_size;       /* 1 or 2 bytes, little endian */
+    uint16_t length_mask;
+} packet_type_t;
+
+static const packet_type_t m_types[] =
+{
+    [H4_PARSER_TYPE_COMMAND] = {.header_size = 4, .length_offset = 3, .length_size = 1, .length_mask = 0x00FF},
+    [H4_PARSER_TYPE_ACL]     = {.header_size = 5, .length_offset = 3, .length_size = 2, .length_mask = 0xFFFF},
+    [H4_PARSER_TYPE_SCO]     = {.header_size = 4, .length_offset = 3, .length_size = 1, .length_mask = 0x00FF},
+    [H4_PARSER_TYPE_EVENT]   = {.header_size = 3, .length_offset = 2, .length_size = 1, .length_mask = 0x00FF},
+    [H4_PARSER_TYPE_ISO]     = {.header_size = 5, .length_offset = 3, .length_size = 2, .length_mask = 0x3FFF},
+};
+
+#define M_TYPE_COUNT (sizeof(m_types) / sizeof(m_types[0]))
+
+
+static void m_evt(h4_parser_t * p_parser, h4_parser_evt_type_t type, h4_parser_resync_cause_t cause,
+                  uint32_t count)
+{
+    h4_parser_evt_t evt = {.type = type, .cause = cause, .count = count};
+
+    if (p_parser->p_config->evt != NULL)
+    {
+        p_parser->p_config->evt(p_parser->p_config->p_context, &evt);
+    }
+}
+
+/* Header size of a packet type taken by the parser, 0 for any other. */
+RAMFUNC static uint8_t m_header_size_get(h4_parser_t const * p_parser, uint8_t type)
+{
+    if (type >= M_TYPE_COUNT || (p_parser->p_config->types & H4_PARSER_TYPE_MASK(type)) == 0)
+    {
+        return 0;
+    }
+    return m_types[type].header_size;
+}
+
+/* Length of the whole packet from its complete header. */
+RAMFUNC static uint32_t m_packet_length_get(uint8_t const * p_header)
+{
+    packet_type_t const * p_type = &m_types[p_header[0]];
+    uint16_t              length = p_header[p_type->length_offset];
+
+    if (p_type->length_size == 2)
+    {
+        length |= (uint16_t)(p_header[p_type->length_offset + 1] << 8);
+    }
+    return p_type->header_size + (length & p_type->length_mask);
+}
+
+RAMFUNC static bool m_header_plausible(h4_parser_t const * p_parser, uint8_t const * p_header, uint32_t length)
+{
+    h4_parser_config_t const * p_config = p_parser->p_config;
+
+    return (length <= p_config->max_length) &&
+           (p_config->header_check == NULL || p_config->header_check(p_config->p_context, p_header));
+}
+
+RAMFUNC static void m_packet_end(h4_parser_t * p_parser)
+{
+    uint8_t * p_packet = p_parser->p_packet;
+
+    p_parser->p_packet = NULL;
+    p_parser->received = 0;
+    p_parser->state = STATE_HEADER;
+    p_parser->p_config->packet(p_parser->p_config->p_context, p_packet, p_parser->length);
+}
+
+/* Take a buffer for the packet whose header is in header[], and copy the header into it. */
+RAMFUNC static bool m_packet_begin(h4_parser_t * p_parser)
+{
+    p_parser->p_packet = p_parser->p_config->alloc(p_parser->p_config->p_context, p_parser->length);
+    if (p_parser->p_packet == NULL)
+    {
+        p_parser->state = STATE_WAIT;
+        return false;
+    }
+
+    memcpy(p_parser->p_packet, p_parser->header, p_parser->received);
+    if (p_parser->received == p_parser->length)
+    {
+        m_packet_end(p_parser);
+    }
+    else
+    {
+        p_parser->state = STATE_CONTENT;
+    }
+    return true;
+}
+
+static void m_resync_start(h4_parser_t * p_parser, h4_parser_resync_cause_t cause)
+{
+    if (p_parser->p_packet != NULL)
+    {
+        p_parser->p_config->free(p_parser->p_config->p_context, p_parser->p_packet);
+        p_parser->p_packet = NULL;
+        m_evt(p_parser, H4_PARSER_EVT_DROPPED, cause, 1);
+    }
+
+    if (p_parser->state != STATE_RESYNC)
+    {
+        m_evt(p_parser, H4_PARSER_EVT_RESYNC, cause, 0);
+    }
+    p_parser->state = STATE_RESYNC;
+}
+
+/* Scan header[] for the start of a plausible packet, dropping one byte at a time. Stays in
+   STATE_RESYNC while more bytes are needed. */
+static void m_resync_scan(h4_parser_t * p_parser)
+{
+    uint32_t discarded = 0;
+
+    while (p_parser->received > 0)
+    {
+        uint8_t  header_size = m_header_size_get(p_parser, p_parser->header[0]);
+        uint32_t length;
+
+        if (header_size != 0)
+        {
+            if (p_parser->received < header_size)
+            {
+                break;
+            }
+
+            length = m_packet_length_get(p_parser->header);
+            if (m_header_plausible(p_parser, p_parser->header, length))
+            {
+                p_parser->length = (uint16_t)length;
+                if (discarded > 0)
+                {
+                    m_evt(p_parser, H4_PARSER_EVT_DISCARDED, H4_PARSER_RESYNC_INVALID_HEADER, discarded);
+                }
+                m_evt(p_parser, H4_PARSER_EVT_RESYNCED, H4_PARSER_RESYNC_INVALID_HEADER, 0);
+                (void)m_packet_begin(p_parser);
+                return;
+            }
+        }
+
+        p_parser->received--;
+        memmove(p_parser->header, &p_parser->header[1], p_parser->received);
+        discarded++;
+    }
+
+    if (discarded > 0)
+    {
+        m_evt(p_parser, H4_PARSER_EVT_DISCARDED, H4_PARSER_RESYNC_INVALID_HEADER, discarded);
+    }
+}
+
+/* The header in header[] is complete: check it and start the packet, or resynchronise. */
+RAMFUNC static void m_header_complete(h4_parser_t * p_parser)
+{
+    uint32_t length = m_packet_length_get(p_parser->header);
+
+    if (!m_header_plausible(p_parser, p_parser->header, length))
+    {
+        m_resync_start(p_parser, H4_PARSER_RESYNC_INVALID_HEADER);
+        m_resync_scan(p_parser);
+        return;
+    }
+
+    p_parser->length = (uint16_t)length;
+    (void)m_packet_begin(p_parser);
+}
+
+void h4_parser_init(h4_parser_t * p_parser, h4_parser_config_t const * p_config)
+{
+    memset(p_parser, 0, sizeof(*p_parser));
+    p_parser->p_config = p_config;
+    p_parser->state = STATE_HEADER;
+}
+
+RAMFUNC size_t h4_parser_feed(h4_parser_t * p_parser, uint8_t const * p_data, size_t length)
+{
+    size_t consumed = 0;
+
+    if (p_parser->state == STATE_WAIT && !m_packet_begin(p_parser))
+    {
+        return 0;
+    }
+
+    while (consumed < length)
+    {
+        uint8_t const * p_in = &p_data[consumed];
+        size_t          available = length - consumed;
+        size_t          chunk;
+
+        switch (p_parser->state)
+        {
+        case STATE_HEADER:
+            if (p_parser->received == 0)
+            {
+                uint8_t header_size = m_header_size_get(p_parser, p_in[0]);
+
+                if (header_size == 0)
+                {
+                    consumed++;
+                    if (p_in[0] != 0x00 || !p_parser->p_config->idle_fill)
+                    {
+                        p_parser->header[0] = p_in[0];
+                        p_parser->received = 1;
+                        m_resync_start(p_parser, H4_PARSER_RESYNC_INVALID_TYPE);
+                        m_resync_scan(p_parser);
+                    }
+                    break;
+                }
+
+                /* Fast path: a whole packet in the chunk goes straight into its buffer. */
+                if (available >= header_size)
+                {
+                    uint32_t  packet_length = m_packet_length_get(p_in);
+                    uint8_t * p_packet;
+
+                    if (available >= packet_length && m_header_plausible(p_parser, p_in, packet_length))
+                    {
+                        p_packet = p_parser->p_config->alloc(p_parser->p_config->p_context, (uint16_t)packet_length);
+                        if (p_packet != NULL)
+                        {
+                            memcpy(p_packet, p_in, packet_length);
+                            consumed += packet_length;
+                            p_parser->p_config->packet(p_parser->p_config->p_context, p_packet,
+                                                       (uint16_t)packet_length);
+                            break;
+                        }
+                    }
+                }
+
+                p_parser->header[0] = p_in[0];
+                p_parser->received = 1;
+                consumed++;
+                break;
+            }
+
+            chunk = m_header_size_get(p_parser, p_parser->header[0]) - p_parser->received;
+            chunk = (chunk < available) ? chunk : available;
+            memcpy(&p_parser->header[p_parser->received], p_in, chunk);
+            p_parser->received += (uint16_t)chunk;
+            consumed += chunk;
+            if (p_parser->received == m_header_size_get(p_parser, p_parser->header[0]))
+            {
+                m_header_complete(p_parser);
+            }
+            break;
+
+        case STATE_CONTENT:
+            chunk = p_parser->length - p_parser->received;
+            chunk = (chunk < available) ? chunk : available;
+            memcpy(&p_parser->p_packet[p_parser->received], p_in, chunk);
+            p_parser->received += (uint16_t)chunk;
+            consumed += chunk;
+            if (p_parser->received == p_parser->length)
+            {
+                m_packet_end(p_parser);
+            }
+            break;
+
+        case STATE_RESYNC:
+            p_parser->header[p_parser->received++] = p_in[0];
+            consumed++;
+            m_resync_scan(p_parser);
+            break;
+
+        case STATE_WAIT:
+        default:
+            return consumed;
+        }
+    }
+
+    return consumed;
+}
+
+void h4_parser_resync(h4_parser_t * p_parser)
+{
+    uint16_t received = p_parser->received;
+
+    m_resync_start(p_parser, H4_PARSER_RESYNC_LOST_BYTES);
+    p_parser->received = 0;
+    if (received > 0)
+    {
+        m_evt(p_parser, H4_PARSER_EVT_DISCARDED, H4_PARSER_RESYNC_LOST_BYTES, received);
+    }
+}
+
+bool h4_parser_buffer_wait(h4_parser_t const * p_parser)
+{
+    return p_parser->state == STATE_WAIT;
+}
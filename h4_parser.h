@@ -0,0 +1,98 @@
+#ifndef H4_PARSER_H__
+#define H4_PARSER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Incremental parser of an H4 packet stream. Bytes are fed in chunks of any size, and each
+   complete packet is handed over in a buffer taken from the owner, H4 type included. A
+   table indexed by the type byte gives the header size and length field of every packet
+   type, and a packet that lies whole within a chunk is checked in place and copied into its
+   buffer in one go. Only packets split across chunks go through the header buffer.
+
+   After an unknown type, a header that fails the checks or lost bytes, the parser
+   resynchronises: it drops the packet being received, then discards bytes one at a time
+   until the start of a plausible packet is found. */
+#define H4_PARSER_TYPE_COMMAND 0x01
+#define H4_PARSER_TYPE_ACL     0x02
+#define H4_PARSER_TYPE_SCO     0x03
+#define H4_PARSER_TYPE_EVENT   0x04
+#define H4_PARSER_TYPE_ISO     0x05
+
+#define H4_PARSER_TYPE_MASK(type) (1U << (type))
+
+/* H4 type and the longest HCI header, of ACL and ISO data. */
+#define H4_PARSER_HEADER_MAX_SIZE 5
+
+typedef enum
+{
+    H4_PARSER_RESYNC_LOST_BYTES = 1,    /* h4_parser_resync(), after a line error */
+    H4_PARSER_RESYNC_INVALID_TYPE = 2,
+    H4_PARSER_RESYNC_INVALID_HEADER = 3,
+} h4_parser_resync_cause_t;
+
+typedef enum
+{
+    H4_PARSER_EVT_RESYNC,       /* Resynchronisation has started, cause is set */
+    H4_PARSER_EVT_RESYNCED,     /* A plausible packet has been found */
+    H4_PARSER_EVT_DISCARDED,    /* count bytes have been discarded */
+    H4_PARSER_EVT_DROPPED,      /* The packet being received has been dropped */
+} h4_parser_evt_type_t;
+
+typedef struct
+{
+    h4_parser_evt_type_t     type;
+    h4_parser_resync_cause_t cause;
+    uint32_t                 count;
+} h4_parser_evt_t;
+
+typedef struct
+{
+    uint32_t types;             /* H4_PARSER_TYPE_MASK() of the packet types taken */
+    uint16_t max_length;        /* Longest packet taken, H4 type included */
+    bool     idle_fill;         /* Skip 0x00 bytes between packets */
+    void *   p_context;         /* Passed to the functions below */
+
+    /* Checks of a complete header beyond its type and length, may be NULL. */
+    bool (* header_check)(void * p_context, uint8_t const * p_header);
+
+    /* Buffer for a packet of length bytes, H4 type included, or NULL if there is none. The
+       parser then stops, and asks again on the next h4_parser_feed(). */
+    uint8_t * (* alloc)(void * p_context, uint16_t length);
+
+    /* Give back a buffer from alloc() whose packet has been dropped. */
+    void (* free)(void * p_context, uint8_t * p_packet);
+
+    /* A complete packet. The buffer is handed over. */
+    void (* packet)(void * p_context, uint8_t * p_packet, uint16_t length);
+
+    /* Resynchronisation and drops, may be NULL. */
+    void (* evt)(void * p_context, h4_parser_evt_t const * p_evt);
+} h4_parser_config_t;
+
+typedef struct
+{
+    h4_parser_config_t const * p_config;
+    uint8_t                    header[H4_PARSER_HEADER_MAX_SIZE];
+    uint8_t *                  p_packet;
+    uint16_t                   length;      /* Of the packet being received, once the header is in */
+    uint16_t                   received;    /* Bytes of the header or packet so far */
+    uint8_t                    state;
+} h4_parser_t;
+
+void h4_parser_init(h4_parser_t * p_parser, h4_parser_config_t const * p_config);
+
+/* Parse a chunk of the stream. Returns the number of bytes consumed, which is less than
+   length if alloc() had no buffer. Call again with the rest once one is free, or with no
+   data if h4_parser_buffer_wait() says the parser waits for one with the whole header. */
+size_t h4_parser_feed(h4_parser_t * p_parser, uint8_t const * p_data, size_t length);
+
+/* Bytes of the stream have been lost: drop the packet being received and the header bytes
+   collected, and resynchronise. */
+void h4_parser_resync(h4_parser_t * p_parser);
+
+/* The parser has a complete header and waits for a buffer for its packet. */
+bool h4_parser_buffer_wait(h4_parser_t const * p_parser);
+
+#endif // H4_PARSER_H__
@@ -0,0 +1,77 @@
+#include <stdatomic.h>
+#include <string.h>
+
+#include "hci_trace.h"
+#include "nrf.h"
+#ifdef HCI_HOST_BUILD
+#include "host_port.h"
+#endif
+
+#if HCI_TRACE
+
+#define HCI_TRACE_MASK (HCI_TRACE_COUNT - 1)
+
+typedef struct
+{
+    atomic_uint        tag;         /* Sequence number + 1 once the record is complete, 0 while it is written */
+    hci_trace_record_t record;
+} hci_trace_slot_t;
+
+static hci_trace_slot_t m_slots[HCI_TRACE_COUNT];
+static atomic_uint      m_next;
+
+
+void hci_trace_init(void)
+{
+    for (uint32_t i = 0; i < HCI_TRACE_COUNT; i++)
+    {
+        atomic_init(&m_slots[i].tag, 0);
+    }
+    atomic_init(&m_next, 0);
+
+#ifdef HCI_HOST_BUILD
+    host_btsnoop_start();
+#endif
+}
+
+void hci_trace_record(hci_trace_dir_t dir, uint8_t const * p_h4_packet, uint16_t length)
+{
+    uint32_t           seq = atomic_fetch_add_explicit(&m_next, 1, memory_order_relaxed);
+    hci_trace_slot_t * p_slot = &m_slots[seq & HCI_TRACE_MASK];
+    uint8_t            captured = (length < HCI_TRACE_CAPTURE_SIZE) ? (uint8_t)length : HCI_TRACE_CAPTURE_SIZE;
+
+    /* Invalidate the slot before changing the record, and publish it once written. */
+    atomic_store_explicit(&p_slot->tag, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    p_slot->record.time = DWT->CYCCNT;
+    p_slot->record.length = length;
+    p_slot->record.dir = (uint8_t)dir;
+    p_slot->record.captured = captured;
+    memcpy(p_slot->record.data, p_h4_packet, captured);
+
+    atomic_store_explicit(&p_slot->tag, seq + 1, memory_order_release);
+}
+
+uint32_t hci_trace_next_get(void)
+{
+    return atomic_load_explicit(&m_next, memory_order_acquire);
+}
+
+bool hci_trace_read(uint32_t seq, hci_trace_record_t * p_record)
+{
+    hci_trace_slot_t * p_slot = &m_slots[seq & HCI_TRACE_MASK];
+    uint32_t           tag = atomic_load_explicit(&p_slot->tag, memory_order_acquire);
+
+    if (tag != seq + 1)
+    {
+        return false;
+    }
+
+    /* A writer may have taken the slot over meanwhile, then the tag has changed. */
+    memcpy(p_record, &p_slot->record, sizeof(*p_record));
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&p_slot->tag, memory_order_relaxed) == tag;
+}
+
+#endif // HCI_TRACE
@@ -0,0 +1,72 @@
+#ifndef HCI_TRACE_H__
+#define HCI_TRACE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Ring of the most recent H4 packets in both directions, with the DWT cycle count at which
+   they were received or framed for sending, their length and their first bytes, H4 type
+   included. Recording reserves a slot with one atomic increment and copies at most
+   HCI_TRACE_CAPTURE_SIZE bytes, so it can be called from any context and is cheap enough to
+   leave enabled. The oldest records are overwritten. Set HCI_TRACE to 0 to compile it out.
+
+   Each slot carries the sequence number of its record, cleared while the record is written
+   and set once it is complete, so a reader can tell a record that is being written or has
+   been overwritten from a valid one without locking out the writers. */
+#ifndef HCI_TRACE
+#define HCI_TRACE 1
+#endif
+
+#ifndef HCI_TRACE_COUNT
+#define HCI_TRACE_COUNT 32
+#endif
+
+#ifndef HCI_TRACE_CAPTURE_SIZE
+#define HCI_TRACE_CAPTURE_SIZE 16
+#endif
+
+#if (HCI_TRACE_COUNT & (HCI_TRACE_COUNT - 1)) != 0
+#error "HCI_TRACE_COUNT must be a power of two"
+#endif
+#if (HCI_TRACE_CAPTURE_SIZE < 1) || (HCI_TRACE_CAPTURE_SIZE > 255)
+#error "HCI_TRACE_CAPTURE_SIZE must be from 1 to 255"
+#endif
+
+typedef enum
+{
+    HCI_TRACE_FROM_HOST,
+    HCI_TRACE_TO_HOST
+} hci_trace_dir_t;
+
+typedef struct
+{
+    uint32_t time;                          /* DWT cycle count */
+    uint16_t length;                        /* Whole packet, H4 type included */
+    uint8_t  dir;                           /* hci_trace_dir_t */
+    uint8_t  captured;                      /* Bytes in data */
+    uint8_t  data[HCI_TRACE_CAPTURE_SIZE];
+} hci_trace_record_t;
+
+#if HCI_TRACE
+
+void hci_trace_init(void);
+
+void hci_trace_record(hci_trace_dir_t dir, uint8_t const * p_h4_packet, uint16_t length);
+
+/* Sequence number the next record will get. Records are numbered from 0, those from
+   hci_trace_next_get() - HCI_TRACE_COUNT on may still be held. */
+uint32_t hci_trace_next_get(void);
+
+/* Copy a record. Returns false if it is not held, or is still being written. */
+bool hci_trace_read(uint32_t seq, hci_trace_record_t * p_record);
+
+#else
+
+#define hci_trace_init()
+#define hci_trace_record(dir, p_h4_packet, length)
+#define hci_trace_next_get() 0
+#define hci_trace_read(seq, p_record) false
+
+#endif // HCI_TRACE
+
+#endif // HCI_TRACE_H__
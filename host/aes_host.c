@@ -0,0 +1,130 @@
+/*
+ * Host implementation of sdc_soc_ecb_block_encrypt.
+ *
+ * AES-128 encryption of one block in software (FIPS-197), with the key,
+ * cleartext and ciphertext in the same byte order as the ECB peripheral.
+ * Byte oriented and table driven for the S-box only: small and plain rather
+ * than fast or hardened against timing, as befits a stand-in.
+ */
+
+#include <string.h>
+
+#include "sdc_soc.h"
+
+#define AES_ROUNDS 10
+
+static const uint8_t m_sbox[256] =
+{
+    0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+    0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+    0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+    0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+    0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+    0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+    0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+    0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+    0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+    0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+    0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+    0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+    0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+    0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+    0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+    0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16,
+};
+
+
+static uint8_t m_xtime(uint8_t value)
+{
+    return (uint8_t)((value << 1) ^ ((value & 0x80) ? 0x1B : 0x00));
+}
+
+static void m_key_expand(uint8_t const * p_key, uint8_t * p_round_keys)
+{
+    uint8_t rcon = 0x01;
+
+    memcpy(p_round_keys, p_key, 16);
+    for (uint8_t i = 16; i < 16 * (AES_ROUNDS + 1); i += 4)
+    {
+        uint8_t word[4];
+
+        memcpy(word, &p_round_keys[i - 4], 4);
+        if ((i % 16) == 0)
+        {
+            /* RotWord, SubWord and the round constant. */
+            uint8_t first = word[0];
+
+            word[0] = m_sbox[word[1]] ^ rcon;
+            word[1] = m_sbox[word[2]];
+            word[2] = m_sbox[word[3]];
+            word[3] = m_sbox[first];
+            rcon = m_xtime(rcon);
+        }
+        for (uint8_t j = 0; j < 4; j++)
+        {
+            p_round_keys[i + j] = p_round_keys[i - 16 + j] ^ word[j];
+        }
+    }
+}
+
+/* SubBytes and ShiftRows together. The state is in column order, byte r of column c at
+   4 * c + r, and row r is rotated left by r columns. */
+static void m_sub_shift(uint8_t * p_state)
+{
+    uint8_t temp[16];
+
+    for (uint8_t c = 0; c < 4; c++)
+    {
+        for (uint8_t r = 0; r < 4; r++)
+        {
+            temp[4 * c + r] = m_sbox[p_state[4 * ((c + r) % 4) + r]];
+        }
+    }
+    memcpy(p_state, temp, 16);
+}
+
+static void m_mix_columns(uint8_t * p_state)
+{
+    for (uint8_t c = 0; c < 4; c++)
+    {
+        uint8_t * p_column = &p_state[4 * c];
+        uint8_t   all = p_column[0] ^ p_column[1] ^ p_column[2] ^ p_column[3];
+        uint8_t   first = p_column[0];
+
+        p_column[0] ^= all ^ m_xtime(p_column[0] ^ p_column[1]);
+        p_column[1] ^= all ^ m_xtime(p_column[1] ^ p_column[2]);
+        p_column[2] ^= all ^ m_xtime(p_column[2] ^ p_column[3]);
+        p_column[3] ^= all ^ m_xtime(p_column[3] ^ first);
+    }
+}
+
+static void m_round_key_add(uint8_t * p_state, uint8_t const * p_round_key)
+{
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        p_state[i] ^= p_round_key[i];
+    }
+}
+
+int32_t sdc_soc_ecb_block_encrypt(const uint8_t key[16], const uint8_t cleartext[16],
+                                  uint8_t ciphertext[16])
+{
+    uint8_t round_keys[16 * (AES_ROUNDS + 1)];
+    uint8_t state[16];
+
+    m_key_expand(key, round_keys);
+
+    memcpy(state, cleartext, 16);
+    m_round_key_add(state, &round_keys[0]);
+    for (uint8_t round = 1; round < AES_ROUNDS; round++)
+    {
+        m_sub_shift(state);
+        m_mix_columns(state);
+        m_round_key_add(state, &round_keys[16 * round]);
+    }
+    m_sub_shift(state);
+    m_round_key_add(state, &round_keys[16 * AES_ROUNDS]);
+
+    memcpy(ciphertext, state, 16);
+    return 0;
+}
@@ -0,0 +1,342 @@
+/*
+ * Cost of the H4 parser per byte and per packet, for chunk sizes from a
+ * byte at a time (a UART interrupt per byte) through the DMA buffer size of
+ * main.c to large batches, against a straightforward byte at a time parser,
+ * and a check that every packet comes out whole and in order.
+ *
+ * Usage: bench_h4_parser [megabytes]
+ *
+ * The stream mixes commands with up to 32 parameter bytes, ACL data of 27
+ * and 251 bytes and small ISO data. The check also runs it with a byte of
+ * garbage in front of every tenth packet, which must be discarded by
+ * resynchronisation without losing a packet.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "h4_parser.h"
+
+#define GARBAGE_BYTE 0xFF
+
+typedef struct
+{
+    uint8_t const * p_stream;   /* Where the next packet is expected, when checking */
+    size_t          packets;
+    size_t          bytes;
+    size_t          discarded;
+    size_t          errors;
+} sink_t;
+
+static uint8_t  m_packet_buffer[H4_PARSER_HEADER_MAX_SIZE + 0xFFFF];
+static uint32_t m_seed = 0x2545F491;
+
+static uint32_t m_rand(void)
+{
+    /* xorshift32, so that every run parses the same stream */
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+}
+
+static uint8_t * m_alloc(void * p_context, uint16_t length)
+{
+    (void)p_context;
+    (void)length;
+    return m_packet_buffer;
+}
+
+static void m_free(void * p_context, uint8_t * p_packet)
+{
+    (void)p_context;
+    (void)p_packet;
+}
+
+static void m_packet_count(void * p_context, uint8_t * p_packet, uint16_t length)
+{
+    sink_t * p_sink = p_context;
+
+    (void)p_packet;
+    p_sink->packets++;
+    p_sink->bytes += length;
+}
+
+static void m_packet_check(void * p_context, uint8_t * p_packet, uint16_t length)
+{
+    sink_t * p_sink = p_context;
+
+    if (p_sink->p_stream[0] == GARBAGE_BYTE)
+    {
+        p_sink->p_stream++;
+    }
+    if (memcmp(p_packet, p_sink->p_stream, length) != 0)
+    {
+        p_sink->errors++;
+    }
+    p_sink->p_stream += length;
+    p_sink->packets++;
+    p_sink->bytes += length;
+}
+
+static void m_evt(void * p_context, h4_parser_evt_t const * p_evt)
+{
+    sink_t * p_sink = p_context;
+
+    if (p_evt->type == H4_PARSER_EVT_DISCARDED)
+    {
+        p_sink->discarded += p_evt->count;
+    }
+    else if (p_evt->type == H4_PARSER_EVT_DROPPED)
+    {
+        p_sink->errors++;
+    }
+}
+
+/* Build a stream of packets, with garbage in front of every tenth one if asked. Returns its
+   length and sets *p_packets. */
+static size_t m_stream_build(uint8_t * p_stream, size_t size, bool garbage, size_t * p_packets)
+{
+    size_t length = 0;
+    size_t packets = 0;
+
+    for (;;)
+    {
+        uint8_t  packet[H4_PARSER_HEADER_MAX_SIZE + 251];
+        uint32_t choice = m_rand() % 8;
+        size_t   packet_length;
+
+        if (choice < 4)
+        {
+            uint8_t params = (uint8_t)(m_rand() % 33);
+
+            packet[0] = H4_PARSER_TYPE_COMMAND;
+            packet[1] = (uint8_t)m_rand();
+            packet[2] = 0x20;
+            packet[3] = params;
+            packet_length = 4 + params;
+        }
+        else if (choice < 7)
+        {
+            uint16_t data_length = (choice < 6) ? 27 : 251;
+
+            packet[0] = H4_PARSER_TYPE_ACL;
+            packet[1] = 0x01;
+            packet[2] = 0x00;
+            packet[3] = (uint8_t)data_length;
+            packet[4] = 0;
+            packet_length = 5 + data_length;
+        }
+        else
+        {
+            packet[0] = H4_PARSER_TYPE_ISO;
+            packet[1] = 0x02;
+            packet[2] = 0x00;
+            packet[3] = 60;
+            packet[4] = 0;
+            packet_length = 5 + 60;
+        }
+        for (size_t i = (packet[0] == H4_PARSER_TYPE_COMMAND) ? 4 : 5; i < packet_length; i++)
+        {
+            packet[i] = (uint8_t)m_rand();
+        }
+
+        if (length + 1 + packet_length > size)
+        {
+            break;
+        }
+        if (garbage && (packets % 10) == 9)
+        {
+            p_stream[length++] = GARBAGE_BYTE;
+        }
+        memcpy(&p_stream[length], packet, packet_length);
+        length += packet_length;
+        packets++;
+    }
+
+    *p_packets = packets;
+    return length;
+}
+
+static void m_feed(h4_parser_t * p_parser, uint8_t const * p_stream, size_t length, size_t chunk)
+{
+    for (size_t offset = 0; offset < length; offset += chunk)
+    {
+        size_t size = (length - offset < chunk) ? length - offset : chunk;
+
+        (void)h4_parser_feed(p_parser, &p_stream[offset], size);
+    }
+}
+
+/* Byte at a time parser, without a table or a fast path, for comparison. */
+static size_t m_parse_reference(uint8_t const * p_stream, size_t length, sink_t * p_sink)
+{
+    size_t   received = 0;
+    size_t   needed = 1;
+    uint8_t  header[H4_PARSER_HEADER_MAX_SIZE];
+    uint8_t *p_packet = NULL;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t byte = p_stream[i];
+
+        if (p_packet != NULL)
+        {
+            p_packet[received++] = byte;
+        }
+        else
+        {
+            header[received++] = byte;
+        }
+        if (received < needed)
+        {
+            continue;
+        }
+
+        if (p_packet != NULL)
+        {
+            m_packet_count(p_sink, p_packet, (uint16_t)received);
+            p_packet = NULL;
+            received = 0;
+            needed = 1;
+        }
+        else if (received == 1)
+        {
+            needed = (byte == H4_PARSER_TYPE_COMMAND) ? 4 : 5;
+        }
+        else
+        {
+            size_t payload = (header[0] == H4_PARSER_TYPE_COMMAND) ? header[3]
+                                                                   : (size_t)(header[3] | (header[4] << 8));
+
+            p_packet = m_alloc(NULL, (uint16_t)(received + payload));
+            memcpy(p_packet, header, received);
+            needed = received + payload;
+            if (payload == 0)
+            {
+                m_packet_count(p_sink, p_packet, (uint16_t)received);
+                p_packet = NULL;
+                received = 0;
+                needed = 1;
+            }
+        }
+    }
+
+    return p_sink->packets;
+}
+
+static double m_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void m_report(char const * p_name, size_t bytes, size_t packets, double seconds)
+{
+    printf("  %-26s %6.2f ns/byte %7.2f Mpackets/s\n", p_name, seconds * 1e9 / (double)bytes,
+           (double)packets / seconds / 1e6);
+}
+
+static h4_parser_config_t m_config(sink_t * p_sink, bool check)
+{
+    h4_parser_config_t config =
+    {
+        .types = H4_PARSER_TYPE_MASK(H4_PARSER_TYPE_COMMAND) | H4_PARSER_TYPE_MASK(H4_PARSER_TYPE_ACL) |
+                 H4_PARSER_TYPE_MASK(H4_PARSER_TYPE_ISO),
+        .max_length = 0xFFFF,
+        .p_context = p_sink,
+        .alloc = m_alloc,
+        .free = m_free,
+        .packet = check ? m_packet_check : m_packet_count,
+        .evt = m_evt,
+    };
+
+    return config;
+}
+
+/* Parse the stream with every chunk size and check the packets. */
+static int m_check(uint8_t const * p_stream, size_t length, size_t packets, size_t garbage)
+{
+    static const size_t chunks[] = {1, 3, 7, 64, 4096};
+
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+    {
+        sink_t             sink = {.p_stream = p_stream};
+        h4_parser_config_t config = m_config(&sink, true);
+        h4_parser_t        parser;
+
+        h4_parser_init(&parser, &config);
+        m_feed(&parser, p_stream, length, chunks[i]);
+        if (sink.packets != packets || sink.errors != 0 || sink.discarded != garbage)
+        {
+            printf("  %zu byte chunks: %zu of %zu packets, %zu errors, %zu of %zu bytes discarded\n",
+                   chunks[i], sink.packets, packets, sink.errors, sink.discarded, garbage);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char ** argv)
+{
+    static const size_t chunks[] = {1, 16, 64, 4096};
+    size_t    size = ((argc > 1) ? strtoul(argv[1], NULL, 10) : 16) * 1024 * 1024;
+    uint8_t * p_stream = malloc(size);
+    size_t    length;
+    size_t    packets;
+    double    start;
+
+    if (p_stream == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    length = m_stream_build(p_stream, 1024 * 1024, true, &packets);
+    if (m_check(p_stream, length, packets, packets / 10) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+
+    length = m_stream_build(p_stream, size, false, &packets);
+    if (m_check(p_stream, length, packets, 0) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    printf("mixed stream, %zu packets in %zu bytes\n", packets, length);
+
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+    {
+        sink_t             sink = {0};
+        h4_parser_config_t config = m_config(&sink, false);
+        h4_parser_t        parser;
+        char               name[32];
+
+        h4_parser_init(&parser, &config);
+        start = m_now();
+        m_feed(&parser, p_stream, length, chunks[i]);
+        (void)snprintf(name, sizeof(name), "h4_parser_feed, %zu byte%s", chunks[i], (chunks[i] > 1) ? "s" : "");
+        m_report(name, length, sink.packets, m_now() - start);
+    }
+
+    {
+        sink_t sink = {0};
+
+        start = m_now();
+        (void)m_parse_reference(p_stream, length, &sink);
+        m_report("byte at a time", length, sink.packets, m_now() - start);
+        if (sink.packets != packets)
+        {
+            printf("  reference parsed %zu packets, expected %zu\n", sink.packets, packets);
+            return EXIT_FAILURE;
+        }
+    }
+
+    free(p_stream);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,227 @@
+/*
+ * Correctness and cost of the random number pools in rand_pool.c.
+ *
+ * Usage: bench_rand_pool [kilobytes]
+ *
+ * First a producer and a consumer thread pass a counting sequence through
+ * one pool, the consumer taking requests of every length from 1 to
+ * RAND_POOL_SIZE, and check that no byte is lost, repeated or reordered.
+ * Then the cost of a request is measured on one thread, against the
+ * previous pool of 65 bytes that was emptied one byte at a time. Costs are
+ * in TSC cycles on x86, in nanoseconds elsewhere.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/prctl.h>
+
+#include "rand_pool.h"
+
+#define REPEAT 1000000
+
+/* The previous pool, for comparison. */
+#define REFERENCE_SIZE 65
+
+typedef struct
+{
+    uint8_t q[REFERENCE_SIZE];
+    uint8_t in;
+    uint8_t out;
+} reference_pool_t;
+
+static rand_pool_t      m_pool;
+static reference_pool_t m_reference;
+
+static volatile bool m_consumer_done;
+static size_t        m_sequence_length;
+
+
+static uint8_t m_reference_count(reference_pool_t * p_queue)
+{
+    return p_queue->in >= p_queue->out
+         ? p_queue->in - p_queue->out
+         : (REFERENCE_SIZE - p_queue->out) + p_queue->in;
+}
+
+static uint8_t m_reference_get(reference_pool_t * p_queue, uint8_t * p_buff, uint8_t length)
+{
+    if (length > m_reference_count(p_queue))
+    {
+        return 0;
+    }
+    for (uint8_t i = 0; i < length; i++)
+    {
+        p_buff[i] = p_queue->q[p_queue->out];
+        p_queue->out = (p_queue->out + 1) % REFERENCE_SIZE;
+    }
+    return length;
+}
+
+static uint64_t m_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* Give the other side a chance to run when the pool is full or empty. A short sleep rather
+   than a yield, which may return straight away when there is a single CPU. */
+static void m_wait(void)
+{
+    struct timespec ts = {.tv_nsec = 1000};
+
+    (void)nanosleep(&ts, NULL);
+}
+
+static void * m_producer_main(void * p_arg)
+{
+    uint8_t value = 0;
+
+    (void)p_arg;
+
+    while (!m_consumer_done)
+    {
+        if (rand_pool_put(&m_pool, value))
+        {
+            value++;
+        }
+        else
+        {
+            m_wait();
+        }
+    }
+    return NULL;
+}
+
+static bool m_concurrency_check(void)
+{
+    pthread_t producer;
+    uint8_t   buff[RAND_POOL_SIZE];
+    uint8_t   expected = 0;
+    uint8_t   length = 1;
+    size_t    received = 0;
+    size_t    requests = 0;
+    size_t    refused = 0;
+
+    rand_pool_init(&m_pool);
+    m_consumer_done = false;
+    if (pthread_create(&producer, NULL, m_producer_main, NULL) != 0)
+    {
+        perror("bench_rand_pool: producer thread");
+        return false;
+    }
+
+    while (received < m_sequence_length)
+    {
+        if (rand_pool_get(&m_pool, buff, length) == 0)
+        {
+            refused++;
+            m_wait();
+            continue;
+        }
+
+        for (uint8_t i = 0; i < length; i++)
+        {
+            if (buff[i] != expected)
+            {
+                printf("byte %zu is 0x%02X, expected 0x%02X\n", received + i, buff[i], expected);
+                m_consumer_done = true;
+                pthread_join(producer, NULL);
+                return false;
+            }
+            expected++;
+        }
+        received += length;
+        requests++;
+        length = (uint8_t)((length % RAND_POOL_SIZE) + 1);
+    }
+
+    m_consumer_done = true;
+    pthread_join(producer, NULL);
+
+    printf("Concurrent producer and consumer: %zu bytes in %zu requests, %zu refused, in order\n",
+           received, requests, refused);
+    return true;
+}
+
+static void m_cost_measure(uint8_t length)
+{
+    uint8_t  buff[RAND_POOL_SIZE];
+    uint64_t start;
+    uint64_t fill_cost;
+    uint64_t pool_cost;
+    uint64_t reference_cost;
+
+    /* Marking the pools full without writing bytes, measured on its own and subtracted. */
+    start = m_now();
+    for (uint32_t i = 0; i < REPEAT; i++)
+    {
+        unsigned int out = atomic_load_explicit(&m_pool.out, memory_order_relaxed);
+
+        atomic_store_explicit(&m_pool.in, out + RAND_POOL_SIZE, memory_order_relaxed);
+        __asm__ volatile("" ::: "memory");
+    }
+    fill_cost = m_now() - start;
+
+    start = m_now();
+    for (uint32_t i = 0; i < REPEAT; i++)
+    {
+        unsigned int out = atomic_load_explicit(&m_pool.out, memory_order_relaxed);
+
+        atomic_store_explicit(&m_pool.in, out + RAND_POOL_SIZE, memory_order_relaxed);
+        (void)rand_pool_get(&m_pool, buff, length);
+        __asm__ volatile("" ::: "memory");
+    }
+    pool_cost = m_now() - start;
+
+    start = m_now();
+    for (uint32_t i = 0; i < REPEAT; i++)
+    {
+        m_reference.in = (uint8_t)((m_reference.out + REFERENCE_SIZE - 1) % REFERENCE_SIZE);
+        (void)m_reference_get(&m_reference, buff, length);
+        __asm__ volatile("" ::: "memory");
+    }
+    reference_cost = m_now() - start;
+
+    printf("  %3u bytes: %6.1f per request, previous pool %6.1f\n", length,
+           (double)(pool_cost - fill_cost) / REPEAT,
+           (double)(reference_cost - fill_cost) / REPEAT);
+}
+
+int main(int argc, char ** argv)
+{
+    size_t kilobytes = (argc > 1) ? strtoul(argv[1], NULL, 0) : 64;
+
+    m_sequence_length = kilobytes * 1024;
+
+    /* Keep the sleeps in m_wait short. */
+    (void)prctl(PR_SET_TIMERSLACK, 1UL);
+
+    if (!m_concurrency_check())
+    {
+        return EXIT_FAILURE;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    printf("Cost of a request, in TSC cycles:\n");
+#else
+    printf("Cost of a request, in nanoseconds:\n");
+#endif
+    rand_pool_init(&m_pool);
+    m_cost_measure(1);
+    m_cost_measure(8);
+    m_cost_measure(16);
+    m_cost_measure(RAND_POOL_SIZE);
+
+    return EXIT_SUCCESS;
+}
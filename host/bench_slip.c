@@ -0,0 +1,244 @@
+/*
+ * Throughput of the H5 SLIP and CRC code against straightforward byte at a
+ * time versions, and a check that both give the same results.
+ *
+ * Usage: bench_slip [megabytes]
+ *
+ * Two payloads are used: random bytes, where about one in 128 needs
+ * escaping, and HCI-like data with no special bytes at all.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "slip.h"
+#include "crc16.h"
+
+#define PACKET_SIZE 251
+
+static uint16_t m_crc_reference(uint16_t crc, uint8_t const * p_data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= p_data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? (uint16_t)((crc >> 1) ^ 0x8408) : (uint16_t)(crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static uint8_t * m_encode_reference(uint8_t * p_out, uint8_t const * p_in, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        switch (p_in[i])
+        {
+        case SLIP_END:
+            *p_out++ = SLIP_ESC;
+            *p_out++ = SLIP_ESC_END;
+            break;
+        case SLIP_ESC:
+            *p_out++ = SLIP_ESC;
+            *p_out++ = SLIP_ESC_ESC;
+            break;
+        default:
+            *p_out++ = p_in[i];
+            break;
+        }
+    }
+    return p_out;
+}
+
+/* Decode one escaped frame without delimiters. Returns the decoded length. */
+static size_t m_decode_reference(uint8_t * p_out, uint8_t const * p_in, size_t length)
+{
+    uint8_t * p_start = p_out;
+    bool      escape = false;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (escape)
+        {
+            *p_out++ = (p_in[i] == SLIP_ESC_END) ? SLIP_END : SLIP_ESC;
+            escape = false;
+        }
+        else if (p_in[i] == SLIP_ESC)
+        {
+            escape = true;
+        }
+        else
+        {
+            *p_out++ = p_in[i];
+        }
+    }
+    return (size_t)(p_out - p_start);
+}
+
+static double m_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void m_report(char const * p_name, size_t bytes, double seconds)
+{
+    printf("  %-22s %8.1f MB/s\n", p_name, (double)bytes / seconds / 1e6);
+}
+
+/* Decode a stream of delimited frames with slip_decode, and return the number of frames. */
+static size_t m_decode_stream(uint8_t const * p_in, size_t length)
+{
+    static uint8_t frame[PACKET_SIZE];
+    slip_decoder_t decoder;
+    size_t         frames = 0;
+
+    slip_decoder_init(&decoder, frame, sizeof(frame));
+    while (length > 0)
+    {
+        bool   frame_end = false;
+        size_t used = slip_decode(&decoder, p_in, length, &frame_end);
+
+        p_in += used;
+        length -= used;
+        frames += frame_end ? 1 : 0;
+    }
+    return frames;
+}
+
+static int m_run(char const * p_name, uint8_t const * p_data, size_t packets)
+{
+    size_t    bytes = packets * PACKET_SIZE;
+    uint8_t * p_encoded = malloc(packets * (2 + SLIP_ENCODED_SIZE_MAX(PACKET_SIZE)));
+    uint8_t * p_reference = malloc(SLIP_ENCODED_SIZE_MAX(PACKET_SIZE));
+    uint8_t   decoded[PACKET_SIZE];
+    uint8_t * p_out;
+    volatile uint16_t crc_sink = 0;
+    double    start;
+    size_t    encoded_length;
+    size_t    frames;
+
+    printf("%s, %zu packets of %d bytes\n", p_name, packets, PACKET_SIZE);
+
+    /* Fault the pages in, so the first timed run does not pay for it. */
+    memset(p_encoded, 0, packets * (2 + SLIP_ENCODED_SIZE_MAX(PACKET_SIZE)));
+
+    /* Check against the reference versions first. */
+    for (size_t i = 0; i < packets; i++)
+    {
+        uint8_t const * p_packet = &p_data[i * PACKET_SIZE];
+        size_t          length = (i % PACKET_SIZE) + 1;
+        uint8_t *       p_end = slip_encode(p_encoded, p_packet, length);
+        uint8_t *       p_ref_end = m_encode_reference(p_reference, p_packet, length);
+
+        if (p_end - p_encoded != p_ref_end - p_reference ||
+            memcmp(p_encoded, p_reference, (size_t)(p_end - p_encoded)) != 0 ||
+            m_decode_reference(decoded, p_encoded, (size_t)(p_end - p_encoded)) != length ||
+            memcmp(decoded, p_packet, length) != 0 ||
+            crc16_ccitt_update(CRC16_CCITT_INIT, p_packet, length) !=
+                m_crc_reference(CRC16_CCITT_INIT, p_packet, length))
+        {
+            printf("  mismatch at packet %zu, length %zu\n", i, length);
+            return EXIT_FAILURE;
+        }
+    }
+
+    start = m_now();
+    p_out = p_encoded;
+    for (size_t i = 0; i < packets; i++)
+    {
+        *p_out++ = SLIP_END;
+        p_out = slip_encode(p_out, &p_data[i * PACKET_SIZE], PACKET_SIZE);
+        *p_out++ = SLIP_END;
+    }
+    m_report("slip_encode", bytes, m_now() - start);
+    encoded_length = (size_t)(p_out - p_encoded);
+
+    start = m_now();
+    p_out = p_encoded;
+    for (size_t i = 0; i < packets; i++)
+    {
+        *p_out++ = SLIP_END;
+        p_out = m_encode_reference(p_out, &p_data[i * PACKET_SIZE], PACKET_SIZE);
+        *p_out++ = SLIP_END;
+    }
+    m_report("encode, byte at a time", bytes, m_now() - start);
+
+    start = m_now();
+    frames = m_decode_stream(p_encoded, encoded_length);
+    m_report("slip_decode", bytes, m_now() - start);
+    if (frames != packets)
+    {
+        printf("  decoded %zu frames, expected %zu\n", frames, packets);
+        return EXIT_FAILURE;
+    }
+
+    start = m_now();
+    for (size_t i = 0; i < packets; i++)
+    {
+        crc_sink ^= crc16_ccitt_update(CRC16_CCITT_INIT, &p_data[i * PACKET_SIZE], PACKET_SIZE);
+    }
+    m_report("crc16_ccitt_update", bytes, m_now() - start);
+
+    start = m_now();
+    for (size_t i = 0; i < packets; i++)
+    {
+        crc_sink ^= m_crc_reference(CRC16_CCITT_INIT, &p_data[i * PACKET_SIZE], PACKET_SIZE);
+    }
+    m_report("crc, bit at a time", bytes, m_now() - start);
+
+    free(p_encoded);
+    free(p_reference);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t    megabytes = (argc > 1) ? strtoul(argv[1], NULL, 0) : 16;
+    size_t    packets = (megabytes * 1000000) / PACKET_SIZE;
+    uint8_t * p_data;
+    uint16_t  check;
+
+    /* Check value of the H5 CRC, see the Core specification Vol 4, Part D, 7.1. */
+    check = crc16_bit_reverse(crc16_ccitt_update(CRC16_CCITT_INIT, (uint8_t const *)"123456789", 9));
+    if (check != 0x89F6)
+    {
+        printf("CRC of \"123456789\" is 0x%04X, expected 0x89F6\n", check);
+        return EXIT_FAILURE;
+    }
+
+    if (packets < PACKET_SIZE)
+    {
+        packets = PACKET_SIZE;
+    }
+    p_data = malloc(packets * PACKET_SIZE);
+
+    srand(1);
+    for (size_t i = 0; i < packets * PACKET_SIZE; i++)
+    {
+        p_data[i] = (uint8_t)rand();
+    }
+    if (m_run("Random data", p_data, packets) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < packets * PACKET_SIZE; i++)
+    {
+        p_data[i] = (uint8_t)(i % 0x80);
+    }
+    if (m_run("Data without special bytes", p_data, packets) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+
+    free(p_data);
+    return EXIT_SUCCESS;
+}
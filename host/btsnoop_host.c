@@ -0,0 +1,158 @@
+/*
+ * btsnoop file of the HCI trace, see hci_trace.h.
+ *
+ * With HCI_HOST_BTSNOOP=<path> set, a thread empties the trace ring every
+ * few milliseconds and appends its records to a btsnoop file (datalink H4),
+ * which Wireshark and btmon read. Records hold the first
+ * HCI_TRACE_CAPTURE_SIZE bytes of each packet, so the file gives the full
+ * length of every packet but only those bytes of it. Records overwritten
+ * before they could be written out are counted as dropped packets.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "hci_trace.h"
+#include "host_port.h"
+
+#if HCI_TRACE
+
+#define BTSNOOP_DRAIN_INTERVAL_US 5000
+
+/* btsnoop: microseconds since midnight, January 1st 0 AD, and datalink type "HCI UART (H4)" */
+#define BTSNOOP_EPOCH_OFFSET_US 0x00DCDDB30F2F8000ULL
+#define BTSNOOP_DATALINK_H4     1002
+
+/* Record flags: bit 0 set for packets received by the host, bit 1 for commands and events */
+#define BTSNOOP_FLAG_RECEIVED 0x01
+#define BTSNOOP_FLAG_CONTROL  0x02
+
+static FILE *    m_file;
+static pthread_t m_thread;
+
+/* Wall clock time of trace time m_time_base, extended over counter wrap-arounds. */
+static uint64_t m_wall_base_us;
+static uint32_t m_time_base;
+
+
+static void m_uint32_put(uint32_t value)
+{
+    uint8_t bytes[4] = {(uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+
+    (void)fwrite(bytes, 1, sizeof(bytes), m_file);
+}
+
+static uint64_t m_wall_now_us(void)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (uint64_t)now.tv_sec * 1000000ULL + (uint64_t)now.tv_usec;
+}
+
+static void m_record_write(hci_trace_record_t const * p_record, uint32_t drops)
+{
+    int32_t  ticks_per_us = (int32_t)(SystemCoreClock / 1000000);
+    int32_t  delta_us = (int32_t)(p_record->time - m_time_base) / ticks_per_us;
+    uint32_t flags = 0;
+    uint64_t time_us = m_wall_base_us + (uint64_t)(int64_t)delta_us + BTSNOOP_EPOCH_OFFSET_US;
+
+    /* Records are written out well within a counter period, so the difference is exact. A
+       record may be a little older than the one before it, if its writer was preempted
+       between taking a sequence number and reading the time, so the base only moves on. */
+    if (delta_us > 0)
+    {
+        m_wall_base_us += (uint64_t)delta_us;
+        m_time_base += (uint32_t)(delta_us * ticks_per_us);
+    }
+
+    if (p_record->dir == HCI_TRACE_TO_HOST)
+    {
+        flags |= BTSNOOP_FLAG_RECEIVED;
+    }
+    if (p_record->data[0] == 0x01 || p_record->data[0] == 0x04)
+    {
+        flags |= BTSNOOP_FLAG_CONTROL;
+    }
+
+    m_uint32_put(p_record->length);
+    m_uint32_put(p_record->captured);
+    m_uint32_put(flags);
+    m_uint32_put(drops);
+    m_uint32_put((uint32_t)(time_us >> 32));
+    m_uint32_put((uint32_t)time_us);
+    (void)fwrite(p_record->data, 1, p_record->captured, m_file);
+}
+
+static void * m_thread_main(void * p_arg)
+{
+    uint32_t seq = 0;
+    uint32_t drops = 0;
+
+    (void)p_arg;
+
+    for (;;)
+    {
+        uint32_t next = hci_trace_next_get();
+
+        while (seq != next)
+        {
+            hci_trace_record_t record;
+
+            if (next - seq > HCI_TRACE_COUNT)
+            {
+                drops += next - seq - HCI_TRACE_COUNT;
+                seq = next - HCI_TRACE_COUNT;
+            }
+            if (!hci_trace_read(seq, &record))
+            {
+                /* Still being written, or overwritten since next was read: try again next
+                   time. */
+                break;
+            }
+            m_record_write(&record, drops);
+            seq++;
+        }
+        (void)fflush(m_file);
+
+        (void)usleep(BTSNOOP_DRAIN_INTERVAL_US);
+    }
+
+    return NULL;
+}
+
+void host_btsnoop_start(void)
+{
+    char const * p_path = getenv("HCI_HOST_BTSNOOP");
+
+    if (p_path == NULL || m_file != NULL)
+    {
+        return;
+    }
+
+    m_file = fopen(p_path, "wb");
+    if (m_file == NULL)
+    {
+        perror("hci_host: btsnoop");
+        return;
+    }
+
+    (void)fwrite("btsnoop", 1, 8, m_file);
+    m_uint32_put(1);
+    m_uint32_put(BTSNOOP_DATALINK_H4);
+
+    m_wall_base_us = m_wall_now_us();
+    m_time_base = DWT->CYCCNT;
+
+    if (pthread_create(&m_thread, NULL, m_thread_main, NULL) != 0)
+    {
+        perror("hci_host: btsnoop thread");
+        return;
+    }
+    fprintf(stderr, "hci_host: btsnoop trace in %s\n", p_path);
+}
+
+#endif // HCI_TRACE
@@ -0,0 +1,873 @@
+/*
+ * H4 load generator and benchmark for a controller running this sample, on
+ * a board behind a serial port or as hci_host.
+ *
+ * Usage: hci_bench [options] <device|unix:path> <scenario>...
+ *
+ *   -b <baud>     serial baud rate (1000000)
+ *   -F            no RTS/CTS flow control
+ *   -n <count>    commands sent by the cmd scenario (1000)
+ *   -o <opcode>   command sent by the cmd and mixed scenarios, without
+ *                 parameters (0x1001, Read Local Version Information)
+ *   -t <seconds>  duration of the acl, adv and mixed scenarios (5)
+ *   -c <handle>   connection handle of the acl and mixed scenarios (0)
+ *   -l <bytes>    ACL payload length (the controller's maximum)
+ *   -w <ms>       time to wait for a Command Complete or for the
+ *                 outstanding ACL packets to complete (1000)
+ *
+ * Scenarios:
+ *
+ *   cmd    command ping-pong, one command at a time, Command Complete or
+ *          Command Status latency
+ *   acl    sustained ACL upload within the controller's buffer credits,
+ *          throughput and packet to Number Of Completed Packets latency
+ *   adv    passive scanning, advertising reports received per second, and
+ *          reports lost if the advertiser numbers them as hci_host does
+ *   mixed  cmd while acl runs, for the -t duration
+ *   stray  ACL data on a handle with no connection, more packets than the
+ *          controller has receive buffers, then cmd; fails unless every
+ *          command completes, as the data must be dropped, not held
+ *   all    all of the above
+ *
+ * The controller is reset first, and its ACL buffers read with LE Read
+ * Buffer Size. Each scenario prints one JSON object per line to stdout,
+ * progress and errors go to stderr. Against a board, acl and mixed need a
+ * connection whose handle is given with -c; hci_host reports its links as
+ * connected on reset, handles 0 up, and loops their data back.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define H4_CMD 0x01
+#define H4_ACL 0x02
+#define H4_EVT 0x04
+
+#define HCI_EVT_COMMAND_COMPLETE            0x0E
+#define HCI_EVT_COMMAND_STATUS              0x0F
+#define HCI_EVT_NUMBER_OF_COMPLETED_PACKETS 0x13
+#define HCI_EVT_LE_META                     0x3E
+#define HCI_LE_SUBEVT_ADVERTISING_REPORT    0x02
+
+#define HCI_OPCODE_RESET                    0x0C03
+#define HCI_OPCODE_READ_LOCAL_VERSION       0x1001
+#define HCI_OPCODE_READ_BUFFER_SIZE         0x1005
+#define HCI_OPCODE_LE_READ_BUFFER_SIZE      0x2002
+#define HCI_OPCODE_LE_SET_SCAN_PARAMS       0x200B
+#define HCI_OPCODE_LE_SET_SCAN_ENABLE       0x200C
+
+#define RX_PACKET_MAX_SIZE (1 + 4 + 0xFFFF)
+#define TX_BUFFER_SIZE     (64 * 1024)
+#define ACL_QUEUED_MAX     (8 * 1024)   /* ACL bytes written ahead of the link */
+#define ACL_IN_FLIGHT_MAX  1024
+#define STRAY_HANDLE       0x0EFF
+#define STRAY_PACKETS      64           /* Beyond the receive buffers of the sample */
+
+typedef struct
+{
+    uint64_t * p_values;
+    size_t     count;
+    size_t     size;
+} samples_t;
+
+typedef struct
+{
+    uint32_t  sent;
+    uint32_t  completed;
+    uint32_t  errors;           /* Completed with a status other than success */
+    uint32_t  lost;             /* No completion within the wait time */
+    samples_t latency;
+} cmd_result_t;
+
+typedef struct
+{
+    uint32_t  sent;
+    uint32_t  completed;
+    uint64_t  completed_bytes;
+    uint64_t  rx_bytes;
+    uint32_t  lost;             /* Not completed within the wait time after the upload */
+    uint64_t  last_ns;
+    samples_t latency;
+} acl_result_t;
+
+static int m_fd = -1;
+
+static uint8_t m_tx_buffer[TX_BUFFER_SIZE];
+static size_t  m_tx_length;
+
+static uint8_t m_rx_packet[RX_PACKET_MAX_SIZE];
+static size_t  m_rx_length;
+static size_t  m_rx_needed;
+static bool    m_rx_header_done;
+static uint32_t m_rx_unknown;
+
+/* Command in flight: opcode, and once its Command Complete or Status is in, status and parameters. */
+static uint16_t m_cmd_opcode;
+static bool     m_cmd_done;
+static uint8_t  m_cmd_status;
+static uint8_t  m_cmd_params[255];
+
+static uint16_t m_acl_handle;
+static uint16_t m_acl_length;
+static uint16_t m_acl_buffers;
+static bool     m_acl_active;
+static uint64_t m_acl_sent_ns[ACL_IN_FLIGHT_MAX];
+static uint32_t m_acl_in_flight;
+static uint32_t m_acl_out;
+static acl_result_t * mp_acl_result;
+
+static uint32_t m_adv_reports;
+static uint32_t m_adv_events;
+static uint32_t m_adv_numbered;
+static uint32_t m_adv_lost;
+static uint32_t m_adv_seq_next;
+static bool     m_adv_seq_valid;
+
+static uint32_t m_wait_ms = 1000;
+
+
+static uint64_t m_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static uint16_t m_uint16_get(uint8_t const * p_data)
+{
+    return (uint16_t)(p_data[0] | (p_data[1] << 8));
+}
+
+static void m_samples_add(samples_t * p_samples, uint64_t value)
+{
+    if (p_samples->count == p_samples->size)
+    {
+        p_samples->size = (p_samples->size > 0) ? 2 * p_samples->size : 1024;
+        p_samples->p_values = realloc(p_samples->p_values, p_samples->size * sizeof(uint64_t));
+        if (p_samples->p_values == NULL)
+        {
+            perror("hci_bench: samples");
+            exit(EXIT_FAILURE);
+        }
+    }
+    p_samples->p_values[p_samples->count++] = value;
+}
+
+static int m_uint64_compare(void const * p_a, void const * p_b)
+{
+    uint64_t a = *(uint64_t const *)p_a;
+    uint64_t b = *(uint64_t const *)p_b;
+
+    return (a > b) - (a < b);
+}
+
+/* Nearest rank percentile of sorted samples, in microseconds. */
+static double m_percentile_us(samples_t const * p_samples, unsigned percent)
+{
+    size_t rank = (p_samples->count * percent + 99) / 100;
+
+    return (double)p_samples->p_values[(rank > 0) ? rank - 1 : 0] / 1000.0;
+}
+
+static void m_latency_print(samples_t * p_samples)
+{
+    uint64_t total = 0;
+
+    if (p_samples->count == 0)
+    {
+        printf("\"latency_us\":null");
+        return;
+    }
+
+    qsort(p_samples->p_values, p_samples->count, sizeof(uint64_t), m_uint64_compare);
+    for (size_t i = 0; i < p_samples->count; i++)
+    {
+        total += p_samples->p_values[i];
+    }
+
+    printf("\"latency_us\":{\"min\":%.1f,\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"max\":%.1f,\"mean\":%.1f}",
+           m_percentile_us(p_samples, 0),
+           m_percentile_us(p_samples, 50),
+           m_percentile_us(p_samples, 90),
+           m_percentile_us(p_samples, 99),
+           m_percentile_us(p_samples, 100),
+           (double)total / (double)p_samples->count / 1000.0);
+}
+
+static void m_cmd_result_print(cmd_result_t * p_result, double duration_s)
+{
+    printf("\"sent\":%u,\"completed\":%u,\"errors\":%u,\"lost\":%u,\"rate_per_s\":%.1f,",
+           p_result->sent, p_result->completed, p_result->errors, p_result->lost,
+           (duration_s > 0.0) ? p_result->completed / duration_s : 0.0);
+    m_latency_print(&p_result->latency);
+}
+
+static void m_acl_result_print(acl_result_t * p_result, double duration_s)
+{
+    printf("\"sent\":%u,\"completed\":%u,\"lost\":%u,\"bytes\":%llu,\"rx_bytes\":%llu,"
+           "\"rate_per_s\":%.1f,\"throughput_kbps\":%.1f,",
+           p_result->sent, p_result->completed, p_result->lost,
+           (unsigned long long)p_result->completed_bytes, (unsigned long long)p_result->rx_bytes,
+           (duration_s > 0.0) ? p_result->completed / duration_s : 0.0,
+           (duration_s > 0.0) ? (double)p_result->completed_bytes * 8.0 / duration_s / 1000.0 : 0.0);
+    m_latency_print(&p_result->latency);
+}
+
+static void m_cmd_complete(uint16_t opcode, uint8_t status, uint8_t const * p_params, uint8_t params_length)
+{
+    if (opcode != m_cmd_opcode || m_cmd_done)
+    {
+        return;
+    }
+    m_cmd_done = true;
+    m_cmd_status = status;
+    memcpy(m_cmd_params, p_params, params_length);
+}
+
+static void m_acl_completed(uint16_t handle, uint16_t count)
+{
+    uint64_t now = m_now_ns();
+
+    if (handle != m_acl_handle)
+    {
+        return;
+    }
+
+    for (; count > 0 && m_acl_in_flight > 0; count--)
+    {
+        if (mp_acl_result != NULL)
+        {
+            m_samples_add(&mp_acl_result->latency, now - m_acl_sent_ns[m_acl_out]);
+            mp_acl_result->completed++;
+            mp_acl_result->completed_bytes += m_acl_length;
+            mp_acl_result->last_ns = now;
+        }
+        m_acl_out = (m_acl_out + 1) % ACL_IN_FLIGHT_MAX;
+        m_acl_in_flight--;
+    }
+}
+
+static void m_adv_reports_handle(uint8_t const * p_reports, uint8_t length)
+{
+    uint8_t count = p_reports[0];
+    uint8_t index = 1;
+
+    m_adv_events++;
+    for (uint8_t i = 0; i < count && index + 9 <= length; i++)
+    {
+        uint8_t const * p_data = &p_reports[index + 9];
+        uint8_t         data_length = p_reports[index + 8];
+
+        m_adv_reports++;
+        if (data_length >= 12 && p_data[1] == 0xFF && m_uint16_get(&p_data[2]) == 0x0059 &&
+            memcmp(&p_data[4], "hcib", 4) == 0)
+        {
+            uint32_t seq = (uint32_t)p_data[8] | ((uint32_t)p_data[9] << 8) |
+                           ((uint32_t)p_data[10] << 16) | ((uint32_t)p_data[11] << 24);
+
+            /* Count gaps, and start over if the advertiser went back. */
+            if (m_adv_seq_valid && (int32_t)(seq - m_adv_seq_next) > 0)
+            {
+                m_adv_lost += seq - m_adv_seq_next;
+            }
+            m_adv_seq_next = seq + 1;
+            m_adv_seq_valid = true;
+            m_adv_numbered++;
+        }
+        index += 10 + data_length;
+    }
+}
+
+static void m_evt_handle(uint8_t const * p_evt)
+{
+    uint8_t length = p_evt[1];
+
+    switch (p_evt[0])
+    {
+    case HCI_EVT_COMMAND_COMPLETE:
+        if (length >= 4)
+        {
+            m_cmd_complete(m_uint16_get(&p_evt[3]), p_evt[5], &p_evt[6], (uint8_t)(length - 4));
+        }
+        break;
+    case HCI_EVT_COMMAND_STATUS:
+        if (length >= 4)
+        {
+            m_cmd_complete(m_uint16_get(&p_evt[4]), p_evt[2], NULL, 0);
+        }
+        break;
+    case HCI_EVT_NUMBER_OF_COMPLETED_PACKETS:
+        for (uint8_t i = 0; i < p_evt[2] && 1 + 4 * (i + 1) <= length; i++)
+        {
+            m_acl_completed(m_uint16_get(&p_evt[3 + 4 * i]) & 0x0FFF, m_uint16_get(&p_evt[5 + 4 * i]));
+        }
+        break;
+    case HCI_EVT_LE_META:
+        if (length >= 2 && p_evt[2] == HCI_LE_SUBEVT_ADVERTISING_REPORT)
+        {
+            m_adv_reports_handle(&p_evt[3], (uint8_t)(length - 1));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void m_rx_packet_handle(void)
+{
+    if (m_rx_packet[0] == H4_EVT)
+    {
+        m_evt_handle(&m_rx_packet[1]);
+    }
+    else if (mp_acl_result != NULL)
+    {
+        mp_acl_result->rx_bytes += m_uint16_get(&m_rx_packet[3]);
+    }
+}
+
+static void m_rx_process(uint8_t const * p_data, size_t length)
+{
+    while (length > 0)
+    {
+        size_t chunk;
+
+        if (m_rx_length == 0)
+        {
+            if (p_data[0] != H4_EVT && p_data[0] != H4_ACL)
+            {
+                m_rx_unknown++;
+                p_data++;
+                length--;
+                continue;
+            }
+            m_rx_needed = (p_data[0] == H4_EVT) ? 1 + 2 : 1 + 4;
+            m_rx_header_done = false;
+        }
+
+        chunk = m_rx_needed - m_rx_length;
+        if (chunk > length)
+        {
+            chunk = length;
+        }
+        memcpy(&m_rx_packet[m_rx_length], p_data, chunk);
+        m_rx_length += chunk;
+        p_data += chunk;
+        length -= chunk;
+
+        if (m_rx_length == m_rx_needed && !m_rx_header_done)
+        {
+            m_rx_header_done = true;
+            m_rx_needed += (m_rx_packet[0] == H4_EVT) ? m_rx_packet[2] : m_uint16_get(&m_rx_packet[3]);
+        }
+        if (m_rx_length == m_rx_needed && m_rx_header_done)
+        {
+            m_rx_packet_handle();
+            m_rx_length = 0;
+        }
+    }
+}
+
+static void m_send(uint8_t const * p_data, size_t length)
+{
+    if (m_tx_length + length > sizeof(m_tx_buffer))
+    {
+        fprintf(stderr, "hci_bench: TX buffer full\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&m_tx_buffer[m_tx_length], p_data, length);
+    m_tx_length += length;
+}
+
+static void m_acl_fill(void)
+{
+    static uint8_t packet[1 + 4 + 0xFFFF];
+
+    while (m_acl_in_flight < m_acl_buffers &&
+           m_tx_length + 5 + m_acl_length <= ACL_QUEUED_MAX)
+    {
+        packet[0] = H4_ACL;
+        packet[1] = (uint8_t)m_acl_handle;
+        packet[2] = (uint8_t)(m_acl_handle >> 8);   /* Packet boundary 00, first non-flushable */
+        packet[3] = (uint8_t)m_acl_length;
+        packet[4] = (uint8_t)(m_acl_length >> 8);
+        for (uint16_t i = 0; i < m_acl_length; i++)
+        {
+            packet[5 + i] = (uint8_t)(mp_acl_result->sent + i);
+        }
+        m_send(packet, 5 + m_acl_length);
+
+        m_acl_sent_ns[(m_acl_out + m_acl_in_flight) % ACL_IN_FLIGHT_MAX] = m_now_ns();
+        m_acl_in_flight++;
+        mp_acl_result->sent++;
+    }
+}
+
+/* Write what can be written, then wait at most timeout_ms for something to read and read it. */
+static void m_io(int timeout_ms)
+{
+    struct pollfd pfd = {.fd = m_fd};
+    uint8_t       buffer[4096];
+    ssize_t       count;
+
+    if (m_acl_active)
+    {
+        m_acl_fill();
+    }
+
+    pfd.events = POLLIN | ((m_tx_length > 0) ? POLLOUT : 0);
+    if (poll(&pfd, 1, timeout_ms) < 0)
+    {
+        if (errno == EINTR)
+        {
+            return;
+        }
+        perror("hci_bench: poll");
+        exit(EXIT_FAILURE);
+    }
+
+    if ((pfd.revents & POLLOUT) != 0)
+    {
+        count = write(m_fd, m_tx_buffer, m_tx_length);
+        if (count > 0)
+        {
+            m_tx_length -= (size_t)count;
+            memmove(m_tx_buffer, &m_tx_buffer[count], m_tx_length);
+        }
+        else if (count < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            perror("hci_bench: write");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((pfd.revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+    {
+        count = read(m_fd, buffer, sizeof(buffer));
+        if (count > 0)
+        {
+            m_rx_process(buffer, (size_t)count);
+        }
+        else if (count == 0 || (errno != EAGAIN && errno != EINTR))
+        {
+            fprintf(stderr, "hci_bench: controller connection closed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void m_cmd_send(uint16_t opcode, uint8_t const * p_params, uint8_t params_length)
+{
+    uint8_t packet[1 + 3 + 255];
+
+    packet[0] = H4_CMD;
+    packet[1] = (uint8_t)opcode;
+    packet[2] = (uint8_t)(opcode >> 8);
+    packet[3] = params_length;
+    memcpy(&packet[4], p_params, params_length);
+
+    m_cmd_opcode = opcode;
+    m_cmd_done = false;
+    m_send(packet, 4 + params_length);
+}
+
+/* Send a command and wait for its completion. Returns the latency in nanoseconds, or 0 on timeout. */
+static uint64_t m_cmd_run(uint16_t opcode, uint8_t const * p_params, uint8_t params_length)
+{
+    uint64_t start = m_now_ns();
+    uint64_t deadline = start + (uint64_t)m_wait_ms * 1000000ULL;
+    uint64_t now = start;
+
+    m_cmd_send(opcode, p_params, params_length);
+    while (!m_cmd_done && now < deadline)
+    {
+        m_io((int)((deadline - now + 999999) / 1000000));
+        now = m_now_ns();
+    }
+
+    if (!m_cmd_done)
+    {
+        /* Take a late completion for the next command's. */
+        m_cmd_opcode = 0;
+        return 0;
+    }
+    return (now > start) ? now - start : 1;
+}
+
+static void m_cmd_expect(uint16_t opcode, uint8_t const * p_params, uint8_t params_length)
+{
+    if (m_cmd_run(opcode, p_params, params_length) == 0 || m_cmd_status != 0)
+    {
+        fprintf(stderr, "hci_bench: command 0x%04X %s\n", opcode, m_cmd_done ? "failed" : "timed out");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void m_cmd_sample(uint16_t opcode, cmd_result_t * p_result)
+{
+    uint64_t latency = m_cmd_run(opcode, NULL, 0);
+
+    p_result->sent++;
+    if (latency == 0)
+    {
+        p_result->lost++;
+        return;
+    }
+    p_result->completed++;
+    if (m_cmd_status != 0)
+    {
+        p_result->errors++;
+    }
+    m_samples_add(&p_result->latency, latency);
+}
+
+static void m_acl_start(acl_result_t * p_result)
+{
+    memset(p_result, 0, sizeof(*p_result));
+    mp_acl_result = p_result;
+    m_acl_active = true;
+}
+
+/* Stop uploading and wait for the packets in flight. */
+static void m_acl_stop(void)
+{
+    uint64_t deadline;
+
+    m_acl_active = false;
+    deadline = m_now_ns() + (uint64_t)m_wait_ms * 1000000ULL;
+    while (m_acl_in_flight > 0 && m_now_ns() < deadline)
+    {
+        m_io(1);
+    }
+
+    /* Give up on the rest, their buffers are not coming back. */
+    mp_acl_result->lost = m_acl_in_flight;
+    m_acl_buffers = (m_acl_buffers > m_acl_in_flight) ? (uint16_t)(m_acl_buffers - m_acl_in_flight) : 0;
+    m_acl_in_flight = 0;
+    mp_acl_result = NULL;
+}
+
+static void m_scenario_cmd(uint16_t opcode, uint32_t count)
+{
+    cmd_result_t result = {0};
+    uint64_t     start = m_now_ns();
+    double       duration_s;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        m_cmd_sample(opcode, &result);
+    }
+    duration_s = (double)(m_now_ns() - start) / 1e9;
+
+    printf("{\"scenario\":\"cmd\",\"opcode\":\"0x%04X\",\"duration_s\":%.3f,", opcode, duration_s);
+    m_cmd_result_print(&result, duration_s);
+    printf("}\n");
+    free(result.latency.p_values);
+}
+
+static void m_scenario_acl(uint32_t seconds)
+{
+    acl_result_t result;
+    uint64_t     start = m_now_ns();
+    uint64_t     end = start + (uint64_t)seconds * 1000000000ULL;
+    double       duration_s;
+
+    m_acl_start(&result);
+    while (m_now_ns() < end)
+    {
+        m_io(1);
+    }
+    m_acl_stop();
+    duration_s = (double)(((result.last_ns > start) ? result.last_ns : end) - start) / 1e9;
+
+    printf("{\"scenario\":\"acl\",\"handle\":%u,\"length\":%u,\"buffers\":%u,\"duration_s\":%.3f,",
+           m_acl_handle, m_acl_length, m_acl_buffers + result.lost, duration_s);
+    m_acl_result_print(&result, duration_s);
+    printf("}\n");
+    free(result.latency.p_values);
+}
+
+static void m_scenario_adv(uint32_t seconds)
+{
+    /* Passive, 10 ms interval and window, public address, no filter. */
+    static const uint8_t scan_params[] = {0x00, 0x10, 0x00, 0x10, 0x00, 0x00, 0x00};
+    static const uint8_t scan_enable[] = {0x01, 0x00};
+    static const uint8_t scan_disable[] = {0x00, 0x00};
+    uint64_t start;
+    uint64_t end;
+    double   duration_s;
+
+    m_cmd_expect(HCI_OPCODE_LE_SET_SCAN_PARAMS, scan_params, sizeof(scan_params));
+    m_cmd_expect(HCI_OPCODE_LE_SET_SCAN_ENABLE, scan_enable, sizeof(scan_enable));
+
+    m_adv_reports = 0;
+    m_adv_events = 0;
+    m_adv_numbered = 0;
+    m_adv_lost = 0;
+    m_adv_seq_valid = false;
+    start = m_now_ns();
+    end = start + (uint64_t)seconds * 1000000000ULL;
+    while (m_now_ns() < end)
+    {
+        m_io(1);
+    }
+    duration_s = (double)(m_now_ns() - start) / 1e9;
+
+    printf("{\"scenario\":\"adv\",\"duration_s\":%.3f,\"events\":%u,\"reports\":%u,\"numbered\":%u,"
+           "\"lost\":%u,\"rate_per_s\":%.1f}\n",
+           duration_s, m_adv_events, m_adv_reports, m_adv_numbered, m_adv_lost, m_adv_reports / duration_s);
+
+    m_cmd_expect(HCI_OPCODE_LE_SET_SCAN_ENABLE, scan_disable, sizeof(scan_disable));
+}
+
+static void m_scenario_mixed(uint16_t opcode, uint32_t seconds)
+{
+    cmd_result_t cmd_result = {0};
+    acl_result_t acl_result;
+    uint64_t     start = m_now_ns();
+    uint64_t     end = start + (uint64_t)seconds * 1000000000ULL;
+    double       duration_s;
+
+    m_acl_start(&acl_result);
+    while (m_now_ns() < end)
+    {
+        m_cmd_sample(opcode, &cmd_result);
+    }
+    m_acl_stop();
+    duration_s = (double)(end - start) / 1e9;
+
+    printf("{\"scenario\":\"mixed\",\"duration_s\":%.3f,\"cmd\":{\"opcode\":\"0x%04X\",", duration_s, opcode);
+    m_cmd_result_print(&cmd_result, duration_s);
+    printf("},\"acl\":{\"handle\":%u,\"length\":%u,", m_acl_handle, m_acl_length);
+    m_acl_result_print(&acl_result, duration_s);
+    printf("}}\n");
+    free(cmd_result.latency.p_values);
+    free(acl_result.latency.p_values);
+}
+
+static void m_scenario_stray(uint16_t opcode, uint32_t count)
+{
+    static uint8_t packet[1 + 4 + 0xFFFF];
+    cmd_result_t   result = {0};
+    uint64_t       start = m_now_ns();
+    double         duration_s;
+
+    packet[0] = H4_ACL;
+    packet[1] = (uint8_t)STRAY_HANDLE;
+    packet[2] = (uint8_t)(STRAY_HANDLE >> 8);
+    packet[3] = (uint8_t)m_acl_length;
+    packet[4] = (uint8_t)(m_acl_length >> 8);
+    memset(&packet[5], 0x5A, m_acl_length);
+    for (uint32_t i = 0; i < STRAY_PACKETS; i++)
+    {
+        m_send(packet, 5 + m_acl_length);
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        m_cmd_sample(opcode, &result);
+    }
+    duration_s = (double)(m_now_ns() - start) / 1e9;
+
+    printf("{\"scenario\":\"stray\",\"handle\":%u,\"packets\":%u,\"opcode\":\"0x%04X\",\"duration_s\":%.3f,",
+           STRAY_HANDLE, STRAY_PACKETS, opcode, duration_s);
+    m_cmd_result_print(&result, duration_s);
+    printf("}\n");
+    free(result.latency.p_values);
+
+    if (result.lost > 0)
+    {
+        fprintf(stderr, "hci_bench: %u commands lost behind data for a handle with no connection\n", result.lost);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static speed_t m_speed_get(unsigned long baud)
+{
+    switch (baud)
+    {
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+    case 460800:  return B460800;
+    case 921600:  return B921600;
+    case 1000000: return B1000000;
+    case 2000000: return B2000000;
+    case 3000000: return B3000000;
+    case 4000000: return B4000000;
+    default:
+        fprintf(stderr, "hci_bench: unsupported baud rate %lu\n", baud);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void m_open(char const * p_device, unsigned long baud, bool flow_control)
+{
+    if (strncmp(p_device, "unix:", 5) == 0)
+    {
+        struct sockaddr_un addr = {.sun_family = AF_UNIX};
+
+        (void)strncpy(addr.sun_path, p_device + 5, sizeof(addr.sun_path) - 1);
+        m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (m_fd < 0 || connect(m_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            perror("hci_bench: connect");
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+    {
+        struct termios tio;
+
+        m_fd = open(p_device, O_RDWR | O_NOCTTY);
+        if (m_fd < 0 || tcgetattr(m_fd, &tio) != 0)
+        {
+            perror("hci_bench: open");
+            exit(EXIT_FAILURE);
+        }
+        cfmakeraw(&tio);
+        (void)cfsetspeed(&tio, m_speed_get(baud));
+        if (flow_control)
+        {
+            tio.c_cflag |= CRTSCTS;
+        }
+        else
+        {
+            tio.c_cflag &= ~CRTSCTS;
+        }
+        tio.c_cflag |= CLOCAL | CREAD;
+        if (tcsetattr(m_fd, TCSANOW, &tio) != 0)
+        {
+            perror("hci_bench: tcsetattr");
+            exit(EXIT_FAILURE);
+        }
+        (void)tcflush(m_fd, TCIOFLUSH);
+    }
+    (void)fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+}
+
+/* Reset the controller and read its ACL buffers, falling back to the shared BR/EDR ones. */
+static void m_setup(uint16_t acl_length)
+{
+    m_cmd_expect(HCI_OPCODE_RESET, NULL, 0);
+
+    m_cmd_expect(HCI_OPCODE_LE_READ_BUFFER_SIZE, NULL, 0);
+    m_acl_length = m_uint16_get(&m_cmd_params[0]);
+    m_acl_buffers = m_cmd_params[2];
+    if (m_acl_length == 0 || m_acl_buffers == 0)
+    {
+        m_cmd_expect(HCI_OPCODE_READ_BUFFER_SIZE, NULL, 0);
+        m_acl_length = m_uint16_get(&m_cmd_params[0]);
+        m_acl_buffers = m_uint16_get(&m_cmd_params[3]);
+    }
+    if (m_acl_buffers > ACL_IN_FLIGHT_MAX)
+    {
+        m_acl_buffers = ACL_IN_FLIGHT_MAX;
+    }
+    if (acl_length > 0 && acl_length < m_acl_length)
+    {
+        m_acl_length = acl_length;
+    }
+
+    fprintf(stderr, "hci_bench: %u ACL buffers of %u bytes\n", m_acl_buffers, m_acl_length);
+}
+
+static void m_usage(void)
+{
+    fprintf(stderr,
+            "Usage: hci_bench [-b baud] [-F] [-n count] [-o opcode] [-t seconds] [-c handle] [-l bytes]\n"
+            "                 [-w ms] <device|unix:path> <cmd|acl|adv|mixed|stray|all>...\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned long baud = 1000000;
+    bool          flow_control = true;
+    uint32_t      count = 1000;
+    uint16_t      opcode = HCI_OPCODE_READ_LOCAL_VERSION;
+    uint32_t      seconds = 5;
+    uint16_t      acl_length = 0;
+    int           option;
+
+    while ((option = getopt(argc, argv, "b:Fn:o:t:c:l:w:")) != -1)
+    {
+        switch (option)
+        {
+        case 'b': baud = strtoul(optarg, NULL, 0); break;
+        case 'F': flow_control = false; break;
+        case 'n': count = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'o': opcode = (uint16_t)strtoul(optarg, NULL, 0); break;
+        case 't': seconds = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'c': m_acl_handle = (uint16_t)(strtoul(optarg, NULL, 0) & 0x0FFF); break;
+        case 'l': acl_length = (uint16_t)strtoul(optarg, NULL, 0); break;
+        case 'w': m_wait_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:  m_usage(); break;
+        }
+    }
+    if (argc - optind < 2)
+    {
+        m_usage();
+    }
+
+    m_open(argv[optind], baud, flow_control);
+    m_setup(acl_length);
+
+    for (int i = optind + 1; i < argc; i++)
+    {
+        bool all = (strcmp(argv[i], "all") == 0);
+        bool known = all;
+
+        if (all || strcmp(argv[i], "cmd") == 0)
+        {
+            m_scenario_cmd(opcode, count);
+            known = true;
+        }
+        if (all || strcmp(argv[i], "acl") == 0)
+        {
+            m_scenario_acl(seconds);
+            known = true;
+        }
+        if (all || strcmp(argv[i], "adv") == 0)
+        {
+            m_scenario_adv(seconds);
+            known = true;
+        }
+        if (all || strcmp(argv[i], "mixed") == 0)
+        {
+            m_scenario_mixed(opcode, seconds);
+            known = true;
+        }
+        if (all || strcmp(argv[i], "stray") == 0)
+        {
+            m_scenario_stray(opcode, count);
+            known = true;
+        }
+        if (!known)
+        {
+            fprintf(stderr, "hci_bench: unknown scenario %s\n", argv[i]);
+            m_usage();
+        }
+        (void)fflush(stdout);
+    }
+
+    if (m_rx_unknown > 0)
+    {
+        fprintf(stderr, "hci_bench: %u bytes with an unknown packet type skipped\n", m_rx_unknown);
+    }
+
+    close(m_fd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,283 @@
+/*
+ * Host emulation of the Cortex-M core features used by the sample:
+ * NVIC priorities, PRIMASK, VECTACTIVE and the WFE/SEV event register.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nrf.h"
+#include "host_port.h"
+
+NRF_UARTE_Type host_uarte0;
+NRF_RNG_Type   host_rng;
+CoreDebug_Type host_core_debug;
+uint32_t       SystemCoreClock = 64000000;
+
+static NRF_UICR_Type  m_uicr;
+static pthread_once_t m_uicr_once = PTHREAD_ONCE_INIT;
+
+static _Thread_local SCB_Type m_scb;
+static _Thread_local DWT_Type m_dwt;
+
+static uint8_t m_irq_priority[HOST_IRQ_COUNT];
+static bool    m_irq_masked[HOST_IRQ_COUNT];
+
+static pthread_mutex_t m_irq_lock;
+static pthread_once_t  m_irq_lock_once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t m_pend_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  m_pend_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t        m_pend_mask;
+static pthread_t       m_pend_thread;
+static bool            m_pend_thread_started;
+
+static pthread_mutex_t m_event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  m_event_cond = PTHREAD_COND_INITIALIZER;
+static bool            m_event_register;
+
+/* Software interrupt vectors, defined by the application when used. */
+void SWI0_EGU0_IRQHandler(void) __attribute__((weak));
+void SWI1_EGU1_IRQHandler(void) __attribute__((weak));
+void SWI2_EGU2_IRQHandler(void) __attribute__((weak));
+void SWI3_EGU3_IRQHandler(void) __attribute__((weak));
+void SWI4_EGU4_IRQHandler(void) __attribute__((weak));
+void SWI5_IRQHandler(void) __attribute__((weak));
+
+
+static void m_irq_lock_init(void)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&m_irq_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static pthread_mutex_t * m_irq_lock_get(void)
+{
+    pthread_once(&m_irq_lock_once, m_irq_lock_init);
+    return &m_irq_lock;
+}
+
+/* HCI_HOST_UICR_CUSTOMER is a comma separated list of <n>:<value>. */
+static void m_uicr_init(void)
+{
+    char const * p_list = getenv("HCI_HOST_UICR_CUSTOMER");
+
+    memset(&m_uicr, 0xFF, sizeof(m_uicr));
+    while (p_list != NULL && *p_list != '\0')
+    {
+        char *        p_end;
+        unsigned long index = strtoul(p_list, &p_end, 0);
+
+        if (*p_end != ':')
+        {
+            break;
+        }
+        if (index < sizeof(m_uicr.CUSTOMER) / sizeof(m_uicr.CUSTOMER[0]))
+        {
+            m_uicr.CUSTOMER[index] = (uint32_t)strtoul(p_end + 1, &p_end, 0);
+        }
+        p_list = (*p_end == ',') ? p_end + 1 : NULL;
+    }
+}
+
+NRF_UICR_Type const * host_uicr_get(void)
+{
+    pthread_once(&m_uicr_once, m_uicr_init);
+    return &m_uicr;
+}
+
+SCB_Type * host_scb_get(void)
+{
+    return &m_scb;
+}
+
+DWT_Type * host_dwt_get(void)
+{
+    m_dwt.CYCCNT = (uint32_t)((host_time_ns() * (SystemCoreClock / 1000000)) / 1000);
+    return &m_dwt;
+}
+
+void NVIC_SetPriority(IRQn_Type irqn, uint32_t priority)
+{
+    if ((uint32_t)irqn < HOST_IRQ_COUNT)
+    {
+        m_irq_priority[irqn] = (uint8_t)priority;
+    }
+}
+
+uint32_t NVIC_GetPriority(IRQn_Type irqn)
+{
+    if ((int32_t)irqn < 0 || (uint32_t)irqn >= HOST_IRQ_COUNT)
+    {
+        /* Thread mode runs below every configurable priority. */
+        return 0xFF;
+    }
+    return m_irq_priority[irqn];
+}
+
+/* Masking a single line is approximated by taking the interrupt lock until it is unmasked
+   again, which holds back every interrupt using host_irq_enter(). */
+void NVIC_EnableIRQ(IRQn_Type irqn)
+{
+    if ((uint32_t)irqn < HOST_IRQ_COUNT && m_irq_masked[irqn])
+    {
+        m_irq_masked[irqn] = false;
+        pthread_mutex_unlock(m_irq_lock_get());
+    }
+}
+
+void NVIC_DisableIRQ(IRQn_Type irqn)
+{
+    if ((uint32_t)irqn < HOST_IRQ_COUNT && !m_irq_masked[irqn])
+    {
+        pthread_mutex_lock(m_irq_lock_get());
+        m_irq_masked[irqn] = true;
+    }
+}
+
+static void (* m_swi_vector_get(uint32_t irqn))(void)
+{
+    switch (irqn)
+    {
+    case SWI0_EGU0_IRQn: return SWI0_EGU0_IRQHandler;
+    case SWI1_EGU1_IRQn: return SWI1_EGU1_IRQHandler;
+    case SWI2_EGU2_IRQn: return SWI2_EGU2_IRQHandler;
+    case SWI3_EGU3_IRQn: return SWI3_EGU3_IRQHandler;
+    case SWI4_EGU4_IRQn: return SWI4_EGU4_IRQHandler;
+    case SWI5_EGU5_IRQn: return SWI5_IRQHandler;
+    default:             return NULL;
+    }
+}
+
+/* Runs pended software interrupts. They share the interrupt lock with the UARTE, which is
+   close enough to their adjacent priorities on target. */
+static void * m_pend_thread_main(void * p_arg)
+{
+    (void)p_arg;
+
+    for (;;)
+    {
+        uint32_t irqn;
+
+        pthread_mutex_lock(&m_pend_lock);
+        while (m_pend_mask == 0)
+        {
+            pthread_cond_wait(&m_pend_cond, &m_pend_lock);
+        }
+        irqn = (uint32_t)__builtin_ctz(m_pend_mask) + SWI0_EGU0_IRQn;
+        m_pend_mask &= ~(1UL << (irqn - SWI0_EGU0_IRQn));
+        pthread_mutex_unlock(&m_pend_lock);
+
+        void (* vector)(void) = m_swi_vector_get(irqn);
+        if (vector != NULL)
+        {
+            host_irq_enter((IRQn_Type)irqn);
+            vector();
+            host_irq_exit();
+        }
+    }
+
+    return NULL;
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type irqn)
+{
+    if (irqn < SWI0_EGU0_IRQn || irqn > SWI5_EGU5_IRQn)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&m_pend_lock);
+    if (!m_pend_thread_started)
+    {
+        (void)pthread_create(&m_pend_thread, NULL, m_pend_thread_main, NULL);
+        m_pend_thread_started = true;
+    }
+    m_pend_mask |= 1UL << (irqn - SWI0_EGU0_IRQn);
+    pthread_cond_signal(&m_pend_cond);
+    pthread_mutex_unlock(&m_pend_lock);
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irqn)
+{
+    if (irqn < SWI0_EGU0_IRQn || irqn > SWI5_EGU5_IRQn)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&m_pend_lock);
+    m_pend_mask &= ~(1UL << (irqn - SWI0_EGU0_IRQn));
+    pthread_mutex_unlock(&m_pend_lock);
+}
+
+void __disable_irq(void)
+{
+    pthread_mutex_lock(m_irq_lock_get());
+}
+
+void __enable_irq(void)
+{
+    pthread_mutex_unlock(m_irq_lock_get());
+}
+
+void __SEV(void)
+{
+    pthread_mutex_lock(&m_event_lock);
+    m_event_register = true;
+    pthread_cond_broadcast(&m_event_cond);
+    pthread_mutex_unlock(&m_event_lock);
+}
+
+void __WFE(void)
+{
+    pthread_mutex_lock(&m_event_lock);
+    while (!m_event_register)
+    {
+        pthread_cond_wait(&m_event_cond, &m_event_lock);
+    }
+    m_event_register = false;
+    pthread_mutex_unlock(&m_event_lock);
+}
+
+void __WFI(void)
+{
+    __WFE();
+}
+
+void host_irq_enter(IRQn_Type irqn)
+{
+    pthread_mutex_lock(m_irq_lock_get());
+    m_scb.ICSR = ((uint32_t)irqn + 16) << SCB_ICSR_VECTACTIVE_Pos;
+}
+
+void host_irq_exit(void)
+{
+    m_scb.ICSR = 0;
+    pthread_mutex_unlock(m_irq_lock_get());
+    __SEV();
+}
+
+void host_irq_preempt_enter(IRQn_Type irqn)
+{
+    m_scb.ICSR = ((uint32_t)irqn + 16) << SCB_ICSR_VECTACTIVE_Pos;
+}
+
+void host_irq_preempt_exit(void)
+{
+    m_scb.ICSR = 0;
+    __SEV();
+}
+
+uint64_t host_time_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
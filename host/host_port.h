@@ -0,0 +1,45 @@
+/*
+ * Host port internals shared by the stand-in drivers.
+ *
+ * Interrupts are emulated by threads. A handler running on such a thread
+ * holds the interrupt lock, which is also what __disable_irq() takes, so the
+ * main loop sees the same atomicity guarantees as on the target.
+ */
+
+#ifndef HOST_PORT_H__
+#define HOST_PORT_H__
+
+#include <stdint.h>
+
+#include "nrf.h"
+
+/** @brief Enter an emulated interrupt: take the interrupt lock and set VECTACTIVE. */
+void host_irq_enter(IRQn_Type irqn);
+
+/** @brief Leave an emulated interrupt and wake the main loop from WFE/WFI. */
+void host_irq_exit(void);
+
+/**
+ * @brief Enter an emulated interrupt that preempts the ones using @ref host_irq_enter.
+ *
+ * Only VECTACTIVE is set, the interrupt lock is not taken. Used for
+ * interrupts configured above the UART priority, such as the RNG.
+ */
+void host_irq_preempt_enter(IRQn_Type irqn);
+
+/** @brief Leave an interrupt entered with @ref host_irq_preempt_enter. */
+void host_irq_preempt_exit(void);
+
+/** @brief Pend the MPSL low priority interrupt, whose handler calls mpsl_low_priority_process(). */
+void host_mpsl_low_priority_pend(void);
+
+/** @brief Run pending controller work and signal the host callback, see sdc_host.c. */
+void host_sdc_low_priority_process(void);
+
+/** @brief Write the HCI trace to the btsnoop file named by HCI_HOST_BTSNOOP, if set, see btsnoop_host.c. */
+void host_btsnoop_start(void);
+
+/** @brief Monotonic time in nanoseconds. */
+uint64_t host_time_ns(void);
+
+#endif // HOST_PORT_H__
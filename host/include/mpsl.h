@@ -0,0 +1,47 @@
+/*
+ * Host stand-in for the MPSL API. Nothing is scheduled on the host; the calls
+ * only exist so the sample links unchanged.
+ */
+
+#ifndef MPSL_H__
+#define MPSL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "nrf.h"
+
+typedef void (*mpsl_assert_handler_t)(const char * const file, const uint32_t line);
+
+enum
+{
+    MPSL_CLOCK_LF_SRC_RC    = 0,
+    MPSL_CLOCK_LF_SRC_XTAL  = 1,
+    MPSL_CLOCK_LF_SRC_SYNTH = 2,
+};
+
+typedef struct
+{
+    uint8_t  source;
+    uint8_t  rc_ctiv;
+    uint8_t  rc_temp_ctiv;
+    uint16_t accuracy_ppm;
+    bool     skip_wait_lfclk_started;
+} mpsl_clock_lfclk_cfg_t;
+
+int32_t mpsl_init(mpsl_clock_lfclk_cfg_t const * p_clock_config,
+                  IRQn_Type                      low_prio_irq,
+                  mpsl_assert_handler_t          p_assert_handler);
+
+void mpsl_uninit(void);
+
+bool mpsl_is_initialized(void);
+
+void mpsl_low_priority_process(void);
+
+void MPSL_IRQ_RADIO_Handler(void);
+void MPSL_IRQ_RTC0_Handler(void);
+void MPSL_IRQ_TIMER0_Handler(void);
+void MPSL_IRQ_CLOCK_Handler(void);
+
+#endif // MPSL_H__
@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for mpsl_timeslot.h. Timeslots are not used by the sample.
+ */
+
+#ifndef MPSL_TIMESLOT_H__
+#define MPSL_TIMESLOT_H__
+
+#include "mpsl.h"
+
+#endif // MPSL_TIMESLOT_H__
@@ -0,0 +1,182 @@
+/*
+ * Host stand-in for the nRF MDK device header.
+ *
+ * Only provides what the sample and the host port need: the interrupt numbers,
+ * NVIC priority bookkeeping, the CMSIS intrinsics used in the sample and UICR.
+ */
+
+#ifndef NRF_H__
+#define NRF_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef __NO_RETURN
+#define __NO_RETURN __attribute__((__noreturn__))
+#endif
+
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE static inline
+#endif
+
+/* Interrupt numbers, matching nRF52840. */
+typedef enum
+{
+    POWER_CLOCK_IRQn  = 0,
+    RADIO_IRQn        = 1,
+    UARTE0_UART0_IRQn = 2,
+    TIMER0_IRQn       = 8,
+    RTC0_IRQn         = 11,
+    RNG_IRQn          = 13,
+    SWI0_EGU0_IRQn    = 20,
+    SWI1_EGU1_IRQn    = 21,
+    SWI2_EGU2_IRQn    = 22,
+    SWI3_EGU3_IRQn    = 23,
+    SWI4_EGU4_IRQn    = 24,
+    SWI5_EGU5_IRQn    = 25,
+} IRQn_Type;
+
+#define SWI5_IRQn SWI5_EGU5_IRQn
+
+/* Number of emulated interrupt lines. */
+#define HOST_IRQ_COUNT 48
+
+typedef struct
+{
+    uint32_t ICSR;
+} SCB_Type;
+
+#define SCB_ICSR_VECTACTIVE_Pos 0U
+#define SCB_ICSR_VECTACTIVE_Msk (0x1FFUL << SCB_ICSR_VECTACTIVE_Pos)
+
+typedef struct
+{
+    uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+typedef struct
+{
+    uint32_t CTRL;
+    uint32_t CYCCNT;
+} DWT_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+
+/** @brief Core clock the cycle counter runs at, as on nRF52840. */
+extern uint32_t SystemCoreClock;
+
+extern CoreDebug_Type host_core_debug;
+
+/** @brief DWT whose CYCCNT follows the monotonic clock, scaled to SystemCoreClock. */
+DWT_Type * host_dwt_get(void);
+
+#define CoreDebug (&host_core_debug)
+#define DWT       (host_dwt_get())
+
+/** @brief Per-thread SCB, so each emulated interrupt context reports its own VECTACTIVE. */
+SCB_Type * host_scb_get(void);
+
+#define SCB (host_scb_get())
+
+void     NVIC_SetPriority(IRQn_Type irqn, uint32_t priority);
+uint32_t NVIC_GetPriority(IRQn_Type irqn);
+void     NVIC_EnableIRQ(IRQn_Type irqn);
+void     NVIC_DisableIRQ(IRQn_Type irqn);
+
+/** @brief Pend a software interrupt. Only SWI0..SWI5 are emulated, each runs its IRQ handler. */
+void     NVIC_SetPendingIRQ(IRQn_Type irqn);
+void     NVIC_ClearPendingIRQ(IRQn_Type irqn);
+
+/** @brief Global interrupt mask, emulated by a lock shared with the interrupt threads. */
+void __disable_irq(void);
+void __enable_irq(void);
+
+/** @brief PRIMASK save and restore. The interrupt lock is recursive and not tracked per
+ *         thread, so the saved value is always 0 and restoring it releases one level. */
+static inline uint32_t __get_PRIMASK(void)
+{
+    return 0;
+}
+
+static inline void __set_PRIMASK(uint32_t primask)
+{
+    if (primask == 0)
+    {
+        __enable_irq();
+    }
+}
+
+/** @brief BASEPRI save and restore, approximated by the interrupt lock as PRIMASK is: raising
+ *         it takes one level, and restoring the saved value, always 0, releases one. */
+#define __NVIC_PRIO_BITS 3
+
+static inline uint32_t __get_BASEPRI(void)
+{
+    return 0;
+}
+
+static inline void __set_BASEPRI(uint32_t basepri)
+{
+    if (basepri == 0)
+    {
+        __enable_irq();
+    }
+}
+
+static inline void __set_BASEPRI_MAX(uint32_t basepri)
+{
+    if (basepri != 0)
+    {
+        __disable_irq();
+    }
+}
+
+/** @brief Idle hints; on the host they yield the CPU. */
+void __WFE(void);
+void __WFI(void);
+void __SEV(void);
+
+/** @brief Compiler/memory barriers. */
+#define __DMB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __DSB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __ISB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+/** @brief Count leading zeros, 32 for zero as on Cortex-M. */
+static inline uint32_t __CLZ(uint32_t value)
+{
+    return (value == 0) ? 32 : (uint32_t)__builtin_clz(value);
+}
+
+/* Peripheral instances are only used as opaque handles on the host. */
+typedef struct
+{
+    uint32_t reserved;
+} NRF_UARTE_Type;
+
+typedef struct
+{
+    uint32_t reserved;
+} NRF_RNG_Type;
+
+extern NRF_UARTE_Type host_uarte0;
+extern NRF_RNG_Type   host_rng;
+
+#define NRF_UARTE0 (&host_uarte0)
+#define NRF_RNG    (&host_rng)
+
+/* User information configuration registers, erased (all ones) but for the customer
+   registers set with HCI_HOST_UICR_CUSTOMER=<n>:<value>. */
+typedef struct
+{
+    uint32_t CUSTOMER[32];
+} NRF_UICR_Type;
+
+/** @brief UICR as read on first use from the environment. */
+NRF_UICR_Type const * host_uicr_get(void);
+
+#define NRF_UICR (host_uicr_get())
+
+#endif // NRF_H__
@@ -0,0 +1,14 @@
+/*
+ * Host stand-in for nrf_errno.h.
+ */
+
+#ifndef NRF_ERRNO_H__
+#define NRF_ERRNO_H__
+
+#define NRF_EPERM  1
+#define NRF_ENOENT 2
+#define NRF_EAGAIN 11
+#define NRF_ENOMEM 12
+#define NRF_EINVAL 22
+
+#endif // NRF_ERRNO_H__
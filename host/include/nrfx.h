@@ -0,0 +1,25 @@
+/*
+ * Host stand-in for nrfx.h.
+ */
+
+#ifndef NRFX_H__
+#define NRFX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "nrf.h"
+#include "nrfx_config.h"
+#include "nrfx_glue.h"
+
+typedef enum
+{
+    NRFX_SUCCESS             = 0x0BAD0000,
+    NRFX_ERROR_INTERNAL      = 0x0BAD0001,
+    NRFX_ERROR_NO_MEM        = 0x0BAD0002,
+    NRFX_ERROR_INVALID_STATE = 0x0BAD0005,
+    NRFX_ERROR_BUSY          = 0x0BAD000B,
+} nrfx_err_t;
+
+#endif // NRFX_H__
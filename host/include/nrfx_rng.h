@@ -0,0 +1,41 @@
+/*
+ * Host stand-in for the nrfx RNG driver.
+ */
+
+#ifndef NRFX_RNG_H__
+#define NRFX_RNG_H__
+
+#include "nrfx.h"
+
+typedef struct
+{
+    bool    error_correction;
+    uint8_t interrupt_priority;
+} nrfx_rng_config_t;
+
+#define NRFX_RNG_DEFAULT_CONFIG                                       \
+    {                                                                 \
+        .error_correction   = true,                                   \
+        .interrupt_priority = NRFX_RNG_DEFAULT_CONFIG_IRQ_PRIORITY,   \
+    }
+
+typedef enum
+{
+    NRF_RNG_EVENT_VALRDY = 0x100,
+} nrf_rng_event_t;
+
+typedef void (* nrfx_rng_evt_handler_t)(uint8_t rng_data);
+
+nrfx_err_t nrfx_rng_init(nrfx_rng_config_t const * p_config, nrfx_rng_evt_handler_t handler);
+
+void nrfx_rng_start(void);
+
+void nrfx_rng_stop(void);
+
+void nrfx_rng_uninit(void);
+
+void nrfx_rng_irq_handler(void);
+
+bool nrf_rng_event_check(NRF_RNG_Type const * p_reg, nrf_rng_event_t event);
+
+#endif // NRFX_RNG_H__
@@ -0,0 +1,150 @@
+/*
+ * Host stand-in for the nrfx UARTE driver.
+ *
+ * Mirrors the nrfx 2.x driver API. The wire is a pseudo-terminal, or a Unix
+ * socket when HCI_HOST_SOCKET is set, see host/nrfx_uarte_host.c.
+ */
+
+#ifndef NRFX_UARTE_H__
+#define NRFX_UARTE_H__
+
+#include "nrfx.h"
+
+#define NRF_UARTE_PSEL_DISCONNECTED 0xFFFFFFFF
+
+typedef enum
+{
+    NRF_UARTE_HWFC_DISABLED = 0,
+    NRF_UARTE_HWFC_ENABLED  = 1,
+} nrf_uarte_hwfc_t;
+
+typedef enum
+{
+    NRF_UARTE_PARITY_EXCLUDED = 0,
+    NRF_UARTE_PARITY_INCLUDED = 0x0E,
+} nrf_uarte_parity_t;
+
+typedef enum
+{
+    NRF_UARTE_BAUDRATE_115200  = 0x01D60000,
+    NRF_UARTE_BAUDRATE_1000000 = 0x10000000,
+} nrf_uarte_baudrate_t;
+
+typedef enum
+{
+    NRF_UARTE_ERROR_OVERRUN_MASK = 0x01,
+    NRF_UARTE_ERROR_PARITY_MASK  = 0x02,
+    NRF_UARTE_ERROR_FRAMING_MASK = 0x04,
+    NRF_UARTE_ERROR_BREAK_MASK   = 0x08,
+} nrf_uarte_error_mask_t;
+
+typedef enum
+{
+    NRF_UARTE_EVENT_RXDRDY = 0x108,
+    NRF_UARTE_EVENT_ENDRX  = 0x110,
+    NRF_UARTE_EVENT_ERROR  = 0x124,
+    NRF_UARTE_EVENT_RXTO   = 0x144,
+} nrf_uarte_event_t;
+
+typedef enum
+{
+    NRF_UARTE_INT_RXDRDY_MASK = (1UL << 2),
+    NRF_UARTE_INT_ENDRX_MASK  = (1UL << 4),
+    NRF_UARTE_INT_ERROR_MASK  = (1UL << 9),
+    NRF_UARTE_INT_RXTO_MASK   = (1UL << 17),
+} nrf_uarte_int_mask_t;
+
+typedef struct
+{
+    nrf_uarte_hwfc_t   hwfc;
+    nrf_uarte_parity_t parity;
+} nrf_uarte_config_t;
+
+typedef struct
+{
+    NRF_UARTE_Type * p_reg;
+    uint8_t          drv_inst_idx;
+} nrfx_uarte_t;
+
+typedef struct
+{
+    uint32_t             pseltxd;
+    uint32_t             pselrxd;
+    uint32_t             pselcts;
+    uint32_t             pselrts;
+    void *               p_context;
+    nrf_uarte_baudrate_t baudrate;
+    uint8_t              interrupt_priority;
+    nrf_uarte_config_t   hal_cfg;
+} nrfx_uarte_config_t;
+
+typedef enum
+{
+    NRFX_UARTE_EVT_TX_DONE,
+    NRFX_UARTE_EVT_RX_DONE,
+    NRFX_UARTE_EVT_ERROR,
+} nrfx_uarte_evt_type_t;
+
+typedef struct
+{
+    uint8_t * p_data;
+    size_t    bytes;
+} nrfx_uarte_xfer_evt_t;
+
+typedef struct
+{
+    nrfx_uarte_xfer_evt_t rxtx;
+    uint32_t              error_mask;
+} nrfx_uarte_error_evt_t;
+
+typedef struct
+{
+    nrfx_uarte_evt_type_t type;
+    union
+    {
+        nrfx_uarte_xfer_evt_t  rxtx;
+        nrfx_uarte_error_evt_t error;
+    } data;
+} nrfx_uarte_event_t;
+
+typedef void (* nrfx_uarte_event_handler_t)(nrfx_uarte_event_t const * p_event,
+                                            void *                     p_context);
+
+nrfx_err_t nrfx_uarte_init(nrfx_uarte_t const *        p_instance,
+                           nrfx_uarte_config_t const * p_config,
+                           nrfx_uarte_event_handler_t  event_handler);
+
+void nrfx_uarte_uninit(nrfx_uarte_t const * p_instance);
+
+nrfx_err_t nrfx_uarte_tx(nrfx_uarte_t const * p_instance,
+                         uint8_t const *      p_data,
+                         size_t               length);
+
+bool nrfx_uarte_tx_in_progress(nrfx_uarte_t const * p_instance);
+
+void nrfx_uarte_tx_abort(nrfx_uarte_t const * p_instance);
+
+nrfx_err_t nrfx_uarte_rx(nrfx_uarte_t const * p_instance,
+                         uint8_t *            p_data,
+                         size_t               length);
+
+bool nrfx_uarte_rx_ready(nrfx_uarte_t const * p_instance);
+
+void nrfx_uarte_rx_abort(nrfx_uarte_t const * p_instance);
+
+uint32_t nrfx_uarte_errorsrc_get(nrfx_uarte_t const * p_instance);
+
+void nrfx_uarte_0_irq_handler(void);
+
+/* HAL event and interrupt access, normally from hal/nrf_uarte.h. Only RXDRDY is emulated. */
+bool nrf_uarte_event_check(NRF_UARTE_Type const * p_reg, nrf_uarte_event_t event);
+
+void nrf_uarte_event_clear(NRF_UARTE_Type * p_reg, nrf_uarte_event_t event);
+
+void nrf_uarte_int_enable(NRF_UARTE_Type * p_reg, uint32_t mask);
+
+void nrf_uarte_int_disable(NRF_UARTE_Type * p_reg, uint32_t mask);
+
+bool nrf_uarte_int_enable_check(NRF_UARTE_Type const * p_reg, uint32_t mask);
+
+#endif // NRFX_UARTE_H__
@@ -0,0 +1,106 @@
+/*
+ * Host stand-in for the SoftDevice Controller API.
+ *
+ * Declares the subset of sdc.h used by the sample. The memory macros follow
+ * the shape of the real ones so that BLE_REQUIRED_MEMORY keeps a realistic
+ * size; the stand-in controller in host/sdc_host.c does not use the memory.
+ */
+
+#ifndef SDC_H__
+#define SDC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "nrf_errno.h"
+
+#define SDC_DEFAULT_RESOURCE_CFG_TAG 0
+
+#define SDC_DEFAULT_TX_PACKET_SIZE  27
+#define SDC_DEFAULT_RX_PACKET_SIZE  27
+#define SDC_DEFAULT_TX_PACKET_COUNT 3
+#define SDC_DEFAULT_RX_PACKET_COUNT 3
+
+#define __MEM_MINIMAL_MASTER_LINK_SIZE 868
+#define __MEM_MINIMAL_SLAVE_LINK_SIZE  900
+#define __MEM_TX_BUFFER_OVERHEAD_SIZE  15
+#define __MEM_RX_BUFFER_OVERHEAD_SIZE  14
+
+#define __MEM_ADDITIONAL_LINK_SIZE(tx_size, rx_size, tx_count, rx_count)                   \
+    ((tx_count) * ((tx_size) + __MEM_TX_BUFFER_OVERHEAD_SIZE) -                           \
+     (SDC_DEFAULT_TX_PACKET_COUNT * (SDC_DEFAULT_TX_PACKET_SIZE + __MEM_TX_BUFFER_OVERHEAD_SIZE)) + \
+     (rx_count) * ((rx_size) + __MEM_RX_BUFFER_OVERHEAD_SIZE) -                           \
+     (SDC_DEFAULT_RX_PACKET_COUNT * (SDC_DEFAULT_RX_PACKET_SIZE + __MEM_RX_BUFFER_OVERHEAD_SIZE)))
+
+#define SDC_MEM_PER_MASTER_LINK(tx_size, rx_size, tx_count, rx_count) \
+    (__MEM_MINIMAL_MASTER_LINK_SIZE + __MEM_ADDITIONAL_LINK_SIZE(tx_size, rx_size, tx_count, rx_count))
+
+#define SDC_MEM_PER_SLAVE_LINK(tx_size, rx_size, tx_count, rx_count) \
+    (__MEM_MINIMAL_SLAVE_LINK_SIZE + __MEM_ADDITIONAL_LINK_SIZE(tx_size, rx_size, tx_count, rx_count))
+
+#define SDC_MEM_MASTER_LINKS_SHARED 17
+#define SDC_MEM_SLAVE_LINKS_SHARED  11
+
+typedef void (*sdc_fault_handler_t)(const char * file, const uint32_t line);
+typedef void (*sdc_callback_t)(void);
+
+typedef uint8_t (*sdc_rand_prio_low_get_t)(uint8_t * p_buff, uint8_t length);
+typedef uint8_t (*sdc_rand_prio_high_get_t)(uint8_t * p_buff, uint8_t length);
+typedef void (*sdc_rand_poll_t)(uint8_t * p_buff, uint8_t length);
+
+typedef struct
+{
+    sdc_rand_prio_low_get_t  rand_prio_low_get;
+    sdc_rand_prio_high_get_t rand_prio_high_get;
+    sdc_rand_poll_t          rand_poll;
+} sdc_rand_source_t;
+
+enum sdc_cfg_type
+{
+    SDC_CFG_TYPE_NONE         = 0,
+    SDC_CFG_TYPE_MASTER_COUNT = 1,
+    SDC_CFG_TYPE_SLAVE_COUNT  = 2,
+    SDC_CFG_TYPE_BUFFER_CFG   = 3,
+};
+
+typedef struct
+{
+    uint8_t count;
+} sdc_cfg_role_count_t;
+
+typedef struct
+{
+    uint8_t tx_packet_size;
+    uint8_t rx_packet_size;
+    uint8_t tx_packet_count;
+    uint8_t rx_packet_count;
+} sdc_cfg_buffer_cfg_t;
+
+typedef union
+{
+    sdc_cfg_role_count_t master_count;
+    sdc_cfg_role_count_t slave_count;
+    sdc_cfg_buffer_cfg_t buffer_cfg;
+} sdc_cfg_t;
+
+int32_t sdc_init(sdc_fault_handler_t fault_handler);
+
+int32_t sdc_cfg_set(uint8_t config_tag, uint8_t config_type, sdc_cfg_t const * p_resource_cfg);
+
+int32_t sdc_enable(sdc_callback_t callback, uint8_t * p_mem);
+
+int32_t sdc_disable(void);
+
+int32_t sdc_rand_source_register(sdc_rand_source_t const * p_rand_source);
+
+int32_t sdc_support_adv(void);
+int32_t sdc_support_ext_adv(void);
+int32_t sdc_support_slave(void);
+int32_t sdc_support_scan(void);
+int32_t sdc_support_ext_scan(void);
+int32_t sdc_support_master(void);
+int32_t sdc_support_dle(void);
+int32_t sdc_support_le_2m_phy(void);
+int32_t sdc_support_le_coded_phy(void);
+
+#endif // SDC_H__
@@ -0,0 +1,34 @@
+/*
+ * Host stand-in for sdc_hci.h.
+ */
+
+#ifndef SDC_HCI_H__
+#define SDC_HCI_H__
+
+#include <stdint.h>
+
+#include "nrf_errno.h"
+
+#define HCI_CMD_HEADER_SIZE  3
+#define HCI_DATA_HEADER_SIZE 4
+#define HCI_EVT_HEADER_SIZE  2
+
+#define HCI_CMD_MAX_SIZE  255
+#define HCI_DATA_MAX_SIZE 251
+#define HCI_EVT_MAX_SIZE  255
+
+#define HCI_CMD_PACKET_MAX_SIZE  (HCI_CMD_HEADER_SIZE + HCI_CMD_MAX_SIZE)
+#define HCI_DATA_PACKET_MAX_SIZE (HCI_DATA_HEADER_SIZE + HCI_DATA_MAX_SIZE)
+#define HCI_EVT_PACKET_MAX_SIZE  (HCI_EVT_HEADER_SIZE + HCI_EVT_MAX_SIZE)
+
+#define HCI_MSG_BUFFER_MAX_SIZE HCI_CMD_PACKET_MAX_SIZE
+
+int32_t sdc_hci_cmd_put(uint8_t const * p_cmd_in);
+
+int32_t sdc_hci_evt_get(uint8_t * p_evt_out);
+
+int32_t sdc_hci_data_put(uint8_t const * p_data_in);
+
+int32_t sdc_hci_data_get(uint8_t * p_data_out);
+
+#endif // SDC_HCI_H__
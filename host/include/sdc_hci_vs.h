@@ -0,0 +1,10 @@
+/*
+ * Host stand-in for sdc_hci_vs.h.
+ */
+
+#ifndef SDC_HCI_VS_H__
+#define SDC_HCI_VS_H__
+
+#include "sdc_hci.h"
+
+#endif // SDC_HCI_VS_H__
@@ -0,0 +1,14 @@
+/*
+ * Host stand-in for sdc_soc.h.
+ */
+
+#ifndef SDC_SOC_H__
+#define SDC_SOC_H__
+
+#include "sdc.h"
+
+/* Encrypt one block with AES-128, in software on the host, see aes_host.c. Returns 0. */
+int32_t sdc_soc_ecb_block_encrypt(const uint8_t key[16], const uint8_t cleartext[16],
+                                  uint8_t ciphertext[16]);
+
+#endif // SDC_SOC_H__
@@ -0,0 +1,59 @@
+/*
+ * Host stand-in for MPSL. There is no radio, so the only work is the controller's
+ * low priority processing, which signals the host.
+ */
+
+#include "mpsl.h"
+#include "host_port.h"
+
+static bool      m_initialized;
+static IRQn_Type m_low_prio_irq;
+
+int32_t mpsl_init(mpsl_clock_lfclk_cfg_t const * p_clock_config,
+                  IRQn_Type                      low_prio_irq,
+                  mpsl_assert_handler_t          p_assert_handler)
+{
+    (void)p_clock_config;
+    (void)p_assert_handler;
+
+    m_low_prio_irq = low_prio_irq;
+    m_initialized = true;
+    return 0;
+}
+
+void mpsl_uninit(void)
+{
+    m_initialized = false;
+}
+
+bool mpsl_is_initialized(void)
+{
+    return m_initialized;
+}
+
+/* Pend the low priority interrupt given to mpsl_init, as MPSL does when it has work. */
+void host_mpsl_low_priority_pend(void)
+{
+    NVIC_SetPendingIRQ(m_low_prio_irq);
+}
+
+void mpsl_low_priority_process(void)
+{
+    host_sdc_low_priority_process();
+}
+
+void MPSL_IRQ_RADIO_Handler(void)
+{
+}
+
+void MPSL_IRQ_RTC0_Handler(void)
+{
+}
+
+void MPSL_IRQ_TIMER0_Handler(void)
+{
+}
+
+void MPSL_IRQ_CLOCK_Handler(void)
+{
+}
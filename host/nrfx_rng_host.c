@@ -0,0 +1,126 @@
+/*
+ * Host implementation of the nrfx RNG driver.
+ *
+ * Values are produced by a thread at roughly the rate of the nRF52840 RNG
+ * with bias correction enabled, and delivered as a preempting interrupt.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nrfx_rng.h"
+#include "host_port.h"
+
+/* Bytes delivered per wake-up, and the pause after each burst (~32 kB/s). */
+#define RNG_BURST_SIZE     8
+#define RNG_BURST_DELAY_US 250
+
+static nrfx_rng_evt_handler_t m_handler;
+static volatile bool          m_started;
+static uint64_t               m_state;
+
+static pthread_t       m_thread;
+static bool            m_thread_started;
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  m_cond = PTHREAD_COND_INITIALIZER;
+
+
+static uint8_t m_value_get(void)
+{
+    /* xorshift64*: good enough as a stand-in entropy source. */
+    m_state ^= m_state >> 12;
+    m_state ^= m_state << 25;
+    m_state ^= m_state >> 27;
+    return (uint8_t)((m_state * 0x2545F4914F6CDD1DULL) >> 56);
+}
+
+static void * m_thread_main(void * p_arg)
+{
+    (void)p_arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&m_lock);
+        while (!m_started)
+        {
+            pthread_cond_wait(&m_cond, &m_lock);
+        }
+        pthread_mutex_unlock(&m_lock);
+
+        host_irq_preempt_enter(RNG_IRQn);
+        for (uint8_t i = 0; i < RNG_BURST_SIZE && m_started; i++)
+        {
+            m_handler(m_value_get());
+        }
+        host_irq_preempt_exit();
+
+        (void)usleep(RNG_BURST_DELAY_US);
+    }
+
+    return NULL;
+}
+
+nrfx_err_t nrfx_rng_init(nrfx_rng_config_t const * p_config, nrfx_rng_evt_handler_t handler)
+{
+    (void)p_config;
+
+    if (handler == NULL)
+    {
+        return NRFX_ERROR_INVALID_STATE;
+    }
+
+    m_handler = handler;
+    m_state = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32) ^ 0x9E3779B97F4A7C15ULL;
+
+    if (!m_thread_started)
+    {
+        if (pthread_create(&m_thread, NULL, m_thread_main, NULL) != 0)
+        {
+            perror("hci_host: rng thread");
+            exit(EXIT_FAILURE);
+        }
+        m_thread_started = true;
+    }
+
+    return NRFX_SUCCESS;
+}
+
+void nrfx_rng_start(void)
+{
+    pthread_mutex_lock(&m_lock);
+    m_started = true;
+    pthread_cond_signal(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void nrfx_rng_stop(void)
+{
+    pthread_mutex_lock(&m_lock);
+    m_started = false;
+    pthread_mutex_unlock(&m_lock);
+}
+
+void nrfx_rng_uninit(void)
+{
+    nrfx_rng_stop();
+}
+
+void nrfx_rng_irq_handler(void)
+{
+    /* Called directly when the caller blocks the RNG interrupt: deliver one value. */
+    if (m_started)
+    {
+        m_handler(m_value_get());
+    }
+}
+
+bool nrf_rng_event_check(NRF_RNG_Type const * p_reg, nrf_rng_event_t event)
+{
+    (void)p_reg;
+    (void)event;
+
+    return m_started;
+}
@@ -0,0 +1,761 @@
+/*
+ * Host implementation of the nrfx UARTE driver.
+ *
+ * The wire is a pseudo-terminal by default. Its slave path is printed on
+ * stderr and, if HCI_HOST_PTY_LINK is set, symlinked to that path. Setting
+ * HCI_HOST_SOCKET instead listens on a Unix socket at the given path and
+ * serves one host at a time.
+ *
+ * EasyDMA is emulated by a thread that moves bytes between the wire and the
+ * buffers handed to nrfx_uarte_tx()/nrfx_uarte_rx(), then runs the
+ * application's UARTE0_UART0_IRQHandler, whose call to
+ * nrfx_uarte_0_irq_handler() delivers the driver events. Reception never reads ahead of the armed
+ * buffers, so the kernel buffer plays the role of RTS/CTS flow control.
+ * HCI_HOST_BAUDRATE=<bits/s> holds back TX_DONE for the time the transfer
+ * would take on a real line.
+ *
+ * HCI_HOST_RX_ERROR_RATE=<n> turns about one in n received bytes into a
+ * framing error. As in nrfx 2.x, the ERROR event reports the bytes received
+ * into the current buffer, including the broken one, and both RX buffers are
+ * dropped; bytes read past the error are lost.
+ *
+ * As in nrfx, RX buffers are only dropped after an abort or error when the
+ * interrupt handles the event, so a buffer armed in between is dropped too.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "nrfx_uarte.h"
+#include "host_port.h"
+
+#define RX_BUFFER_COUNT 2
+
+void UARTE0_UART0_IRQHandler(void);
+
+typedef struct
+{
+    uint8_t * p_data;
+    size_t    length;
+    size_t    done;
+} xfer_t;
+
+typedef struct
+{
+    nrfx_uarte_event_handler_t handler;
+    void *                     p_context;
+
+    uint8_t const * p_tx;
+    size_t          tx_length;
+    size_t          tx_done;
+    bool            tx_busy;
+    uint64_t        tx_start_ns;
+
+    xfer_t  rx[RX_BUFFER_COUNT];
+    uint8_t rx_count;
+    bool    rx_abort;
+    bool    rx_stopped;     /* Ended by an abort or error, buffers dropped when the event is handled */
+
+    uint32_t errorsrc;
+    bool     rxdrdy;
+    uint32_t int_mask;
+
+    bool               tx_done_pending;
+    bool               rx_done_pending;
+    nrfx_uarte_event_t rx_done_evt;
+    bool               error_pending;
+    nrfx_uarte_event_t error_evt;
+} uarte_state_t;
+
+static uarte_state_t   m_uarte;
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int       m_fd = -1;
+static int       m_listen_fd = -1;
+static int       m_pty_slave_fd = -1;
+static int       m_wake_fd[2] = {-1, -1};
+static pthread_t m_thread;
+static bool      m_thread_started;
+static uint32_t  m_baudrate;
+static uint32_t  m_rx_error_rate;
+static uint32_t  m_rx_error_seed = 0x2545F491;
+
+
+static void m_wire_accept(void)
+{
+    fprintf(stderr, "hci_host: waiting for host on socket\n");
+    do
+    {
+        m_fd = accept(m_listen_fd, NULL, NULL);
+    } while (m_fd < 0 && errno == EINTR);
+
+    if (m_fd < 0)
+    {
+        perror("hci_host: accept");
+        exit(EXIT_FAILURE);
+    }
+    (void)fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+}
+
+static void m_wire_socket_open(char const * p_path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+
+    (void)strncpy(addr.sun_path, p_path, sizeof(addr.sun_path) - 1);
+    (void)unlink(p_path);
+
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listen_fd < 0 ||
+        bind(m_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(m_listen_fd, 1) != 0)
+    {
+        perror("hci_host: socket");
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stderr, "hci_host: H4 on unix:%s\n", p_path);
+    m_wire_accept();
+}
+
+static void m_wire_pty_open(void)
+{
+    struct termios tio;
+    char const *   p_link = getenv("HCI_HOST_PTY_LINK");
+
+    m_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (m_fd < 0 || grantpt(m_fd) != 0 || unlockpt(m_fd) != 0)
+    {
+        perror("hci_host: pty");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Keep the slave open so the master never reports hang-up between host sessions. */
+    m_pty_slave_fd = open(ptsname(m_fd), O_RDWR | O_NOCTTY);
+    if (m_pty_slave_fd < 0 || tcgetattr(m_pty_slave_fd, &tio) != 0)
+    {
+        perror("hci_host: pty slave");
+        exit(EXIT_FAILURE);
+    }
+    cfmakeraw(&tio);
+    (void)tcsetattr(m_pty_slave_fd, TCSANOW, &tio);
+
+    (void)fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+
+    if (p_link != NULL)
+    {
+        (void)unlink(p_link);
+        if (symlink(ptsname(m_fd), p_link) != 0)
+        {
+            perror("hci_host: symlink");
+        }
+    }
+
+    fprintf(stderr, "hci_host: H4 on %s\n", ptsname(m_fd));
+}
+
+static void m_wire_open(void)
+{
+    char const * p_socket = getenv("HCI_HOST_SOCKET");
+    char const * p_baudrate = getenv("HCI_HOST_BAUDRATE");
+    char const * p_rx_error_rate = getenv("HCI_HOST_RX_ERROR_RATE");
+
+    if (m_fd >= 0)
+    {
+        return;
+    }
+
+    if (p_baudrate != NULL)
+    {
+        m_baudrate = (uint32_t)strtoul(p_baudrate, NULL, 10);
+    }
+
+    if (p_rx_error_rate != NULL)
+    {
+        m_rx_error_rate = (uint32_t)strtoul(p_rx_error_rate, NULL, 10);
+    }
+
+    if (p_socket != NULL)
+    {
+        m_wire_socket_open(p_socket);
+    }
+    else
+    {
+        m_wire_pty_open();
+    }
+}
+
+/* Drop the current host and wait for the next one. Only sockets can hang up. */
+static void m_wire_reconnect(void)
+{
+    if (m_listen_fd < 0)
+    {
+        return;
+    }
+
+    (void)close(m_fd);
+    m_wire_accept();
+}
+
+static void m_wake(void)
+{
+    uint8_t dummy = 0;
+
+    if (m_wake_fd[1] >= 0)
+    {
+        (void)write(m_wake_fd[1], &dummy, 1);
+    }
+}
+
+static uint64_t m_tx_duration_ns(size_t length)
+{
+    /* 8N1: ten bit times per byte. */
+    return (m_baudrate == 0) ? 0 : ((uint64_t)length * 10ULL * 1000000000ULL) / m_baudrate;
+}
+
+/* Run the UARTE interrupt vector, defined by the application. */
+static void m_irq_raise(void)
+{
+    host_irq_enter(UARTE0_UART0_IRQn);
+    UARTE0_UART0_IRQHandler();
+    host_irq_exit();
+}
+
+/* Time until the transfer written out is due. Returns false if there is none. */
+static bool m_tx_timeout_get(struct timespec * p_timeout)
+{
+    bool pending = false;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_uarte.tx_busy && m_uarte.tx_done == m_uarte.tx_length)
+    {
+        uint64_t due = m_uarte.tx_start_ns + m_tx_duration_ns(m_uarte.tx_length);
+        uint64_t now = host_time_ns();
+        uint64_t wait = (now >= due) ? 0 : due - now;
+
+        p_timeout->tv_sec = (time_t)(wait / 1000000000ULL);
+        p_timeout->tv_nsec = (long)(wait % 1000000000ULL);
+        pending = true;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return pending;
+}
+
+/* Move TX bytes onto the wire. Returns true when the transfer is complete and due. */
+static bool m_tx_process(bool writable)
+{
+    bool complete = false;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_uarte.tx_busy)
+    {
+        if (writable && m_uarte.tx_done < m_uarte.tx_length)
+        {
+            ssize_t n = write(m_fd, &m_uarte.p_tx[m_uarte.tx_done], m_uarte.tx_length - m_uarte.tx_done);
+            if (n > 0)
+            {
+                m_uarte.tx_done += (size_t)n;
+            }
+        }
+
+        if (m_uarte.tx_done == m_uarte.tx_length)
+        {
+            uint64_t due = m_uarte.tx_start_ns + m_tx_duration_ns(m_uarte.tx_length);
+            uint64_t now = host_time_ns();
+
+            if (now >= due)
+            {
+                m_uarte.tx_busy = false;
+                complete = true;
+            }
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return complete;
+}
+
+static uint32_t m_rx_error_rand(void)
+{
+    /* xorshift32, deterministic so that failures can be reproduced */
+    m_rx_error_seed ^= m_rx_error_seed << 13;
+    m_rx_error_seed ^= m_rx_error_seed >> 17;
+    m_rx_error_seed ^= m_rx_error_seed << 5;
+    return m_rx_error_seed;
+}
+
+/* Inject a framing error into n newly received bytes of the current buffer, if one is due.
+   Must be called with m_lock held. Returns true if the reception was broken off. */
+static bool m_rx_error_inject(xfer_t * p_rx, size_t n)
+{
+    if (m_rx_error_rate == 0)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (m_rx_error_rand() % m_rx_error_rate == 0)
+        {
+            size_t offset = p_rx->done - n + i;
+
+            p_rx->p_data[offset] = (uint8_t)m_rx_error_rand();
+            m_uarte.errorsrc |= NRF_UARTE_ERROR_FRAMING_MASK;
+
+            m_uarte.error_evt.type = NRFX_UARTE_EVT_ERROR;
+            m_uarte.error_evt.data.error.error_mask = m_uarte.errorsrc;
+            m_uarte.error_evt.data.error.rxtx.p_data = p_rx->p_data;
+            m_uarte.error_evt.data.error.rxtx.bytes = offset + 1;
+            m_uarte.errorsrc = 0;
+            m_uarte.error_pending = true;
+
+            m_uarte.rx_stopped = true;
+            m_uarte.rx_abort = false;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Move RX bytes into the armed buffer. Returns true and fills p_evt when a buffer ends. */
+static bool m_rx_process(bool readable, bool * p_hangup, nrfx_uarte_event_t * p_evt)
+{
+    bool ended = false;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_uarte.rx_count > 0 && !m_uarte.rx_stopped)
+    {
+        xfer_t * p_rx = &m_uarte.rx[0];
+
+        if (readable && !m_uarte.rx_abort && p_rx->done < p_rx->length)
+        {
+            ssize_t n = read(m_fd, &p_rx->p_data[p_rx->done], p_rx->length - p_rx->done);
+            if (n > 0)
+            {
+                p_rx->done += (size_t)n;
+                m_uarte.rxdrdy = true;
+                if (m_rx_error_inject(p_rx, (size_t)n))
+                {
+                    pthread_mutex_unlock(&m_lock);
+                    return false;
+                }
+            }
+            else if (n == 0 || (errno != EAGAIN && errno != EINTR))
+            {
+                *p_hangup = true;
+            }
+        }
+
+        if (p_rx->done == p_rx->length || m_uarte.rx_abort)
+        {
+            p_evt->type = NRFX_UARTE_EVT_RX_DONE;
+            p_evt->data.rxtx.p_data = p_rx->p_data;
+            p_evt->data.rxtx.bytes = p_rx->done;
+
+            if (p_rx->done < p_rx->length)
+            {
+                m_uarte.rx_stopped = true;
+                m_uarte.rx_abort = false;
+            }
+            else
+            {
+                /* As in nrfx, a buffer that filled up ends normally even when aborted. The
+                   chained buffer has been started, and an abort ends it with 0 bytes. */
+                m_uarte.rx[0] = m_uarte.rx[1];
+                m_uarte.rx_count--;
+                if (m_uarte.rx_count == 0)
+                {
+                    m_uarte.rx_abort = false;
+                }
+                else if (m_uarte.rx_abort)
+                {
+                    m_wake();
+                }
+            }
+            ended = true;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return ended;
+}
+
+static void * m_thread_main(void * p_arg)
+{
+    (void)p_arg;
+
+    for (;;)
+    {
+        struct pollfd      fds[2];
+        nrfx_uarte_event_t evt;
+        struct timespec    timeout;
+        bool               hangup = false;
+        uint8_t            drain[16];
+
+        pthread_mutex_lock(&m_lock);
+        fds[0].fd = m_wake_fd[0];
+        fds[0].events = POLLIN;
+        fds[1].fd = m_fd;
+        fds[1].events = ((m_uarte.rx_count > 0 && !m_uarte.rx_stopped) ? POLLIN : 0) |
+                        ((m_uarte.tx_busy && m_uarte.tx_done < m_uarte.tx_length) ? POLLOUT : 0);
+        pthread_mutex_unlock(&m_lock);
+
+        /* The transfer is completed after the poll only, so one falling due in between is
+           not missed. */
+        if (ppoll(fds, 2, m_tx_timeout_get(&timeout) ? &timeout : NULL, NULL) < 0 && errno != EINTR)
+        {
+            perror("hci_host: poll");
+            exit(EXIT_FAILURE);
+        }
+
+        while (read(m_wake_fd[0], drain, sizeof(drain)) > 0)
+        {
+        }
+
+        if (m_tx_process((fds[1].revents & POLLOUT) != 0))
+        {
+            pthread_mutex_lock(&m_lock);
+            m_uarte.tx_done_pending = true;
+            pthread_mutex_unlock(&m_lock);
+            m_irq_raise();
+        }
+
+        if (m_rx_process((fds[1].revents & POLLIN) != 0, &hangup, &evt))
+        {
+            pthread_mutex_lock(&m_lock);
+            m_uarte.rx_done_evt = evt;
+            m_uarte.rx_done_pending = true;
+            pthread_mutex_unlock(&m_lock);
+            m_irq_raise();
+        }
+
+        pthread_mutex_lock(&m_lock);
+        bool error_irq = m_uarte.error_pending;
+        pthread_mutex_unlock(&m_lock);
+        if (error_irq)
+        {
+            m_irq_raise();
+        }
+
+        pthread_mutex_lock(&m_lock);
+        bool rxdrdy_irq = m_uarte.rxdrdy && (m_uarte.int_mask & NRF_UARTE_INT_RXDRDY_MASK);
+        pthread_mutex_unlock(&m_lock);
+        if (rxdrdy_irq)
+        {
+            m_irq_raise();
+        }
+
+        if (hangup || (fds[1].revents & (POLLHUP | POLLERR)) != 0)
+        {
+            m_wire_reconnect();
+        }
+    }
+
+    return NULL;
+}
+
+static void m_thread_start(void)
+{
+    if (m_thread_started)
+    {
+        return;
+    }
+
+    if (pipe2(m_wake_fd, O_NONBLOCK) != 0 ||
+        pthread_create(&m_thread, NULL, m_thread_main, NULL) != 0)
+    {
+        perror("hci_host: uarte thread");
+        exit(EXIT_FAILURE);
+    }
+    m_thread_started = true;
+}
+
+nrfx_err_t nrfx_uarte_init(nrfx_uarte_t const *        p_instance,
+                           nrfx_uarte_config_t const * p_config,
+                           nrfx_uarte_event_handler_t  event_handler)
+{
+    (void)p_instance;
+
+    m_wire_open();
+
+    pthread_mutex_lock(&m_lock);
+    memset(&m_uarte, 0, sizeof(m_uarte));
+    m_uarte.handler = event_handler;
+    m_uarte.p_context = p_config->p_context;
+    pthread_mutex_unlock(&m_lock);
+
+    if (event_handler != NULL)
+    {
+        m_thread_start();
+    }
+
+    return NRFX_SUCCESS;
+}
+
+void nrfx_uarte_uninit(nrfx_uarte_t const * p_instance)
+{
+    (void)p_instance;
+
+    pthread_mutex_lock(&m_lock);
+    memset(&m_uarte, 0, sizeof(m_uarte));
+    pthread_mutex_unlock(&m_lock);
+}
+
+nrfx_err_t nrfx_uarte_tx(nrfx_uarte_t const * p_instance,
+                         uint8_t const *      p_data,
+                         size_t               length)
+{
+    nrfx_err_t err_code = NRFX_SUCCESS;
+
+    (void)p_instance;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_uarte.handler == NULL)
+    {
+        /* Blocking mode, as used by the fault handler. */
+        size_t done = 0;
+
+        while (done < length)
+        {
+            struct pollfd fds = {.fd = m_fd, .events = POLLOUT};
+            ssize_t       n;
+
+            (void)poll(&fds, 1, -1);
+            n = write(m_fd, &p_data[done], length - done);
+            if (n > 0)
+            {
+                done += (size_t)n;
+            }
+            else if (n < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                err_code = NRFX_ERROR_INTERNAL;
+                break;
+            }
+        }
+    }
+    else if (m_uarte.tx_busy)
+    {
+        err_code = NRFX_ERROR_BUSY;
+    }
+    else
+    {
+        m_uarte.p_tx = p_data;
+        m_uarte.tx_length = length;
+        m_uarte.tx_done = 0;
+        m_uarte.tx_busy = true;
+        m_uarte.tx_start_ns = host_time_ns();
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    m_wake();
+    return err_code;
+}
+
+bool nrfx_uarte_tx_in_progress(nrfx_uarte_t const * p_instance)
+{
+    bool busy;
+
+    (void)p_instance;
+
+    pthread_mutex_lock(&m_lock);
+    busy = m_uarte.tx_busy;
+    pthread_mutex_unlock(&m_lock);
+
+    return busy;
+}
+
+void nrfx_uarte_tx_abort(nrfx_uarte_t const * p_instance)
+{
+    (void)p_instance;
+
+    pthread_mutex_lock(&m_lock);
+    m_uarte.tx_busy = false;
+    pthread_mutex_unlock(&m_lock);
+}
+
+nrfx_err_t nrfx_uarte_rx(nrfx_uarte_t const * p_instance,
+                         uint8_t *            p_data,
+                         size_t               length)
+{
+    nrfx_err_t err_code = NRFX_SUCCESS;
+
+    (void)p_instance;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_uarte.rx_count == RX_BUFFER_COUNT)
+    {
+        err_code = NRFX_ERROR_BUSY;
+    }
+    else
+    {
+        /* A second call while a transfer is ongoing is the secondary buffer, as in nrfx. */
+        m_uarte.rx[m_uarte.rx_count].p_data = p_data;
+        m_uarte.rx[m_uarte.rx_count].length = length;
+        m_uarte.rx[m_uarte.rx_count].done = 0;
+        m_uarte.rx_count++;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    m_wake();
+    return err_code;
+}
+
+bool nrfx_uarte_rx_ready(nrfx_uarte_t const * p_instance)
+{
+    struct pollfd fds = {.fd = m_fd, .events = POLLIN};
+
+    (void)p_instance;
+
+    return poll(&fds, 1, 0) > 0;
+}
+
+void nrfx_uarte_rx_abort(nrfx_uarte_t const * p_instance)
+{
+    (void)p_instance;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_uarte.rx_count > 0)
+    {
+        m_uarte.rx_abort = true;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    m_wake();
+}
+
+uint32_t nrfx_uarte_errorsrc_get(nrfx_uarte_t const * p_instance)
+{
+    uint32_t errorsrc;
+
+    (void)p_instance;
+
+    pthread_mutex_lock(&m_lock);
+    errorsrc = m_uarte.errorsrc;
+    m_uarte.errorsrc = 0;
+    pthread_mutex_unlock(&m_lock);
+
+    return errorsrc;
+}
+
+void nrfx_uarte_0_irq_handler(void)
+{
+    nrfx_uarte_event_handler_t handler;
+    void *                     p_context;
+    nrfx_uarte_event_t         rx_evt;
+    nrfx_uarte_event_t         error_evt;
+    bool                       tx_done;
+    bool                       rx_done;
+    bool                       error;
+
+    pthread_mutex_lock(&m_lock);
+    handler = m_uarte.handler;
+    p_context = m_uarte.p_context;
+    tx_done = m_uarte.tx_done_pending;
+    rx_done = m_uarte.rx_done_pending;
+    rx_evt = m_uarte.rx_done_evt;
+    error = m_uarte.error_pending;
+    error_evt = m_uarte.error_evt;
+    m_uarte.tx_done_pending = false;
+    m_uarte.rx_done_pending = false;
+    m_uarte.error_pending = false;
+    if (m_uarte.rx_stopped && (error || rx_done))
+    {
+        m_uarte.rx_count = 0;
+        m_uarte.rx_stopped = false;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (handler == NULL)
+    {
+        return;
+    }
+
+    /* Same order as the nrfx driver: errors, then RX, then TX. */
+    if (error)
+    {
+        handler(&error_evt, p_context);
+    }
+    if (rx_done)
+    {
+        handler(&rx_evt, p_context);
+    }
+    if (tx_done)
+    {
+        nrfx_uarte_event_t tx_evt = {.type = NRFX_UARTE_EVT_TX_DONE};
+        handler(&tx_evt, p_context);
+    }
+}
+
+bool nrf_uarte_event_check(NRF_UARTE_Type const * p_reg, nrf_uarte_event_t event)
+{
+    bool set = false;
+
+    (void)p_reg;
+
+    pthread_mutex_lock(&m_lock);
+    if (event == NRF_UARTE_EVENT_RXDRDY)
+    {
+        set = m_uarte.rxdrdy;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return set;
+}
+
+void nrf_uarte_event_clear(NRF_UARTE_Type * p_reg, nrf_uarte_event_t event)
+{
+    (void)p_reg;
+
+    pthread_mutex_lock(&m_lock);
+    if (event == NRF_UARTE_EVENT_RXDRDY)
+    {
+        m_uarte.rxdrdy = false;
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void nrf_uarte_int_enable(NRF_UARTE_Type * p_reg, uint32_t mask)
+{
+    (void)p_reg;
+
+    pthread_mutex_lock(&m_lock);
+    m_uarte.int_mask |= mask;
+    pthread_mutex_unlock(&m_lock);
+
+    m_wake();
+}
+
+void nrf_uarte_int_disable(NRF_UARTE_Type * p_reg, uint32_t mask)
+{
+    (void)p_reg;
+
+    pthread_mutex_lock(&m_lock);
+    m_uarte.int_mask &= ~mask;
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool nrf_uarte_int_enable_check(NRF_UARTE_Type const * p_reg, uint32_t mask)
+{
+    bool enabled;
+
+    (void)p_reg;
+
+    pthread_mutex_lock(&m_lock);
+    enabled = (m_uarte.int_mask & mask) != 0;
+    pthread_mutex_unlock(&m_lock);
+
+    return enabled;
+}
@@ -0,0 +1,640 @@
+/*
+ * Host stand-in for the SoftDevice Controller.
+ *
+ * Answers HCI commands with Command Complete events and loops ACL data back
+ * to the host, returning one Number Of Completed Packets event per packet.
+ * This is enough to exercise the H4 transport in both directions. Queue
+ * depths are kept small, like the controller buffers on target, so that the
+ * transport has to cope with the controller being busy.
+ *
+ * After HCI Reset, an LE Connection Complete event reports each link of the
+ * configuration as connected, handles 0 up, masters first, so the host has
+ * handles to send data on.
+ *
+ * While scanning is enabled, a thread reports one advertiser at
+ * HCI_HOST_ADV_RATE reports per second (default 1000). Its manufacturer
+ * specific data carries "hcib" and a 32-bit sequence number, so the host can
+ * tell reports dropped because the event queue was full, as they are on
+ * target, from reports lost on the way.
+ *
+ * With HCI_HOST_SLOW_LINK=<handle>:<ms> set, the link of that handle has
+ * one buffer, which it empties <ms> after taking a packet, like a peer with
+ * a long connection interval. Data for that handle is turned away in the
+ * meantime, while other handles loop back at once.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sdc.h"
+#include "sdc_hci.h"
+#include "host_port.h"
+
+#define EVT_QUEUE_SIZE  16
+#define DATA_QUEUE_SIZE 8
+
+#define HCI_EVT_COMMAND_COMPLETE             0x0E
+#define HCI_EVT_NUMBER_OF_COMPLETED_PACKETS  0x13
+#define HCI_EVT_LE_META                      0x3E
+#define HCI_LE_SUBEVT_CONNECTION_COMPLETE    0x01
+#define HCI_LE_SUBEVT_ADVERTISING_REPORT     0x02
+
+#define HCI_STATUS_SUCCESS                   0x00
+#define HCI_STATUS_UNKNOWN_COMMAND           0x01
+
+#define HCI_OPCODE_SET_EVENT_MASK            0x0C01
+#define HCI_OPCODE_RESET                     0x0C03
+#define HCI_OPCODE_READ_LOCAL_VERSION        0x1001
+#define HCI_OPCODE_READ_LOCAL_COMMANDS       0x1002
+#define HCI_OPCODE_READ_LOCAL_FEATURES       0x1003
+#define HCI_OPCODE_READ_BD_ADDR              0x1009
+#define HCI_OPCODE_LE_SET_EVENT_MASK         0x2001
+#define HCI_OPCODE_LE_READ_BUFFER_SIZE       0x2002
+#define HCI_OPCODE_LE_READ_LOCAL_FEATURES    0x2003
+#define HCI_OPCODE_LE_SET_SCAN_PARAMS        0x200B
+#define HCI_OPCODE_LE_SET_SCAN_ENABLE        0x200C
+#define HCI_OPCODE_LE_RAND                   0x2018
+
+/* Event slots advertising reports leave free, so that command and ACL completions always fit. */
+#define ADV_EVT_RESERVE     4
+#define ADV_RATE_DEFAULT    1000
+#define ADV_DATA_SIZE       31
+
+typedef struct
+{
+    uint8_t  buffer[HCI_EVT_PACKET_MAX_SIZE];
+} evt_slot_t;
+
+typedef struct
+{
+    uint8_t  buffer[HCI_DATA_PACKET_MAX_SIZE];
+} data_slot_t;
+
+static evt_slot_t  m_evt_queue[EVT_QUEUE_SIZE];
+static uint8_t     m_evt_in;
+static uint8_t     m_evt_count;
+
+static data_slot_t m_data_queue[DATA_QUEUE_SIZE];
+static uint8_t     m_data_in;
+static uint8_t     m_data_count;
+
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static sdc_callback_t    m_callback;
+static volatile bool     m_host_signal_pending;
+static bool              m_data_refused;    /* Set under m_lock when the loop back was full */
+static sdc_rand_source_t m_rand_source;
+
+static sdc_cfg_buffer_cfg_t m_buffer_cfg = {
+    .tx_packet_size = SDC_DEFAULT_TX_PACKET_SIZE,
+    .rx_packet_size = SDC_DEFAULT_RX_PACKET_SIZE,
+    .tx_packet_count = SDC_DEFAULT_TX_PACKET_COUNT,
+    .rx_packet_count = SDC_DEFAULT_RX_PACKET_COUNT,
+};
+static uint8_t m_master_count = 1;
+static uint8_t m_slave_count = 1;
+
+static const uint8_t m_bd_addr[] = {0x56, 0xFF, 0x99, 0x00, 0xCD, 0x29};
+static const uint8_t m_adv_addr[] = {0x01, 0xB3, 0x4C, 0x00, 0xCD, 0xC9};
+
+static pthread_t     m_scan_thread;
+static bool          m_scan_thread_started;
+static volatile bool m_scan_enabled;
+static uint32_t      m_adv_seq;
+
+static uint16_t       m_slow_handle = 0xFFFF;
+static uint32_t       m_slow_interval_ms;
+static data_slot_t    m_slow_packet;
+static bool           m_slow_busy;
+static pthread_cond_t m_slow_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t      m_slow_thread;
+
+
+static int32_t m_required_memory(void)
+{
+    int32_t per_master = SDC_MEM_PER_MASTER_LINK(m_buffer_cfg.tx_packet_size, m_buffer_cfg.rx_packet_size,
+                                                 m_buffer_cfg.tx_packet_count, m_buffer_cfg.rx_packet_count);
+    int32_t per_slave = SDC_MEM_PER_SLAVE_LINK(m_buffer_cfg.tx_packet_size, m_buffer_cfg.rx_packet_size,
+                                               m_buffer_cfg.tx_packet_count, m_buffer_cfg.rx_packet_count);
+
+    return per_master * m_master_count + per_slave * m_slave_count +
+           ((m_master_count > 0) ? SDC_MEM_MASTER_LINKS_SHARED : 0) +
+           ((m_slave_count > 0) ? SDC_MEM_SLAVE_LINKS_SHARED : 0);
+}
+
+/* Reserve an event slot. Must be called with m_lock held. */
+static uint8_t * m_evt_alloc(void)
+{
+    uint8_t * p_evt;
+
+    if (m_evt_count == EVT_QUEUE_SIZE)
+    {
+        return NULL;
+    }
+
+    p_evt = m_evt_queue[(m_evt_in + m_evt_count) % EVT_QUEUE_SIZE].buffer;
+    m_evt_count++;
+    return p_evt;
+}
+
+/* As on target, the host callback is called from the MPSL low priority interrupt. */
+static void m_signal_host(void)
+{
+    m_host_signal_pending = true;
+    host_mpsl_low_priority_pend();
+}
+
+/* Room has been made in the loop back, called with m_lock held. Returns true if a packet was
+   refused meanwhile and the host is to be signalled, as the controller does with Number Of
+   Completed Packets once its buffers are free again. */
+static bool m_data_room_made(void)
+{
+    bool refused = m_data_refused;
+
+    m_data_refused = false;
+    return refused;
+}
+
+void host_sdc_low_priority_process(void)
+{
+    if (m_host_signal_pending && m_callback != NULL)
+    {
+        m_host_signal_pending = false;
+        m_callback();
+    }
+}
+
+static void m_command_complete_put(uint16_t opcode, uint8_t status, uint8_t const * p_params, uint8_t params_len)
+{
+    uint8_t * p_evt;
+
+    pthread_mutex_lock(&m_lock);
+    p_evt = m_evt_alloc();
+    if (p_evt != NULL)
+    {
+        p_evt[0] = HCI_EVT_COMMAND_COMPLETE;
+        p_evt[1] = 4 + params_len;
+        p_evt[2] = 1; /* Num_HCI_Command_Packets */
+        p_evt[3] = (uint8_t)(opcode & 0xFF);
+        p_evt[4] = (uint8_t)(opcode >> 8);
+        p_evt[5] = status;
+        if (params_len > 0)
+        {
+            memcpy(&p_evt[6], p_params, params_len);
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    m_signal_host();
+}
+
+/* Report every link of the configuration as connected. */
+static void m_connections_put(void)
+{
+    uint8_t links = (uint8_t)(m_master_count + m_slave_count);
+
+    pthread_mutex_lock(&m_lock);
+    for (uint8_t handle = 0; handle < links; handle++)
+    {
+        uint8_t * p_evt = m_evt_alloc();
+
+        if (p_evt == NULL)
+        {
+            break;
+        }
+
+        memset(p_evt, 0, 2 + 19);
+        p_evt[0] = HCI_EVT_LE_META;
+        p_evt[1] = 19;
+        p_evt[2] = HCI_LE_SUBEVT_CONNECTION_COMPLETE;
+        p_evt[3] = HCI_STATUS_SUCCESS;
+        p_evt[4] = handle;
+        p_evt[6] = (handle < m_master_count) ? 0x00 : 0x01;    /* Role */
+        p_evt[7] = 0x01;        /* Random device address */
+        memcpy(&p_evt[8], m_adv_addr, sizeof(m_adv_addr));
+        p_evt[8] = (uint8_t)(p_evt[8] + handle);
+        p_evt[14] = 24;         /* Connection interval, 30 ms */
+        p_evt[18] = 0x90;       /* Supervision timeout, 4 s */
+        p_evt[19] = 0x01;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    m_signal_host();
+}
+
+static void m_adv_report_put(void)
+{
+    uint8_t * p_evt;
+
+    pthread_mutex_lock(&m_lock);
+    p_evt = (m_evt_count < EVT_QUEUE_SIZE - ADV_EVT_RESERVE) ? m_evt_alloc() : NULL;
+    if (p_evt != NULL)
+    {
+        uint8_t * p_data = &p_evt[13];
+
+        p_evt[0] = HCI_EVT_LE_META;
+        p_evt[1] = 12 + ADV_DATA_SIZE;
+        p_evt[2] = HCI_LE_SUBEVT_ADVERTISING_REPORT;
+        p_evt[3] = 1;           /* Num_Reports */
+        p_evt[4] = 0x00;        /* ADV_IND */
+        p_evt[5] = 0x01;        /* Random device address */
+        memcpy(&p_evt[6], m_adv_addr, sizeof(m_adv_addr));
+        p_evt[12] = ADV_DATA_SIZE;
+
+        memset(p_data, 0, ADV_DATA_SIZE);
+        p_data[0] = ADV_DATA_SIZE - 1;
+        p_data[1] = 0xFF;       /* Manufacturer specific data, Nordic Semiconductor */
+        p_data[2] = 0x59;
+        p_data[3] = 0x00;
+        memcpy(&p_data[4], "hcib", 4);
+        p_data[8] = (uint8_t)m_adv_seq;
+        p_data[9] = (uint8_t)(m_adv_seq >> 8);
+        p_data[10] = (uint8_t)(m_adv_seq >> 16);
+        p_data[11] = (uint8_t)(m_adv_seq >> 24);
+
+        p_evt[13 + ADV_DATA_SIZE] = (uint8_t)-60; /* RSSI */
+    }
+    /* Dropped reports use up a sequence number as well, that is what the host looks for. */
+    m_adv_seq++;
+    pthread_mutex_unlock(&m_lock);
+
+    if (p_evt != NULL)
+    {
+        m_signal_host();
+    }
+}
+
+static void * m_scan_thread_main(void * p_arg)
+{
+    char const *    p_rate = getenv("HCI_HOST_ADV_RATE");
+    uint32_t        rate = (p_rate != NULL) ? (uint32_t)strtoul(p_rate, NULL, 10) : ADV_RATE_DEFAULT;
+    uint64_t        interval_ns = 1000000000ULL / ((rate > 0) ? rate : 1);
+    struct timespec due;
+
+    (void)p_arg;
+
+    clock_gettime(CLOCK_MONOTONIC, &due);
+    for (;;)
+    {
+        uint64_t next_ns = (uint64_t)due.tv_nsec + interval_ns;
+
+        due.tv_sec += (time_t)(next_ns / 1000000000ULL);
+        due.tv_nsec = (long)(next_ns % 1000000000ULL);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) != 0)
+        {
+        }
+
+        if (m_scan_enabled)
+        {
+            m_adv_report_put();
+        }
+    }
+
+    return NULL;
+}
+
+static void m_scan_enable(bool enable)
+{
+    m_scan_enabled = enable;
+    if (enable && !m_scan_thread_started)
+    {
+        m_scan_thread_started = (pthread_create(&m_scan_thread, NULL, m_scan_thread_main, NULL) == 0);
+    }
+}
+
+int32_t sdc_hci_cmd_put(uint8_t const * p_cmd_in)
+{
+    uint16_t opcode = (uint16_t)(p_cmd_in[0] | (p_cmd_in[1] << 8));
+    uint8_t  params[64];
+    uint8_t  params_len = 0;
+    uint8_t  status = HCI_STATUS_SUCCESS;
+
+    memset(params, 0, sizeof(params));
+
+    switch (opcode)
+    {
+    case HCI_OPCODE_SET_EVENT_MASK:
+    case HCI_OPCODE_LE_SET_EVENT_MASK:
+    case HCI_OPCODE_LE_SET_SCAN_PARAMS:
+        break;
+    case HCI_OPCODE_RESET:
+        m_scan_enable(false);
+        break;
+    case HCI_OPCODE_LE_SET_SCAN_ENABLE:
+        m_scan_enable(p_cmd_in[2] > 0 && p_cmd_in[3] != 0);
+        break;
+    case HCI_OPCODE_READ_LOCAL_VERSION:
+        params[0] = 0x0B;       /* HCI version 5.2 */
+        params[3] = 0x0B;       /* LMP version 5.2 */
+        params[4] = 0x59;       /* Nordic Semiconductor */
+        params_len = 8;
+        break;
+    case HCI_OPCODE_READ_LOCAL_COMMANDS:
+        params_len = 64;
+        break;
+    case HCI_OPCODE_READ_LOCAL_FEATURES:
+    case HCI_OPCODE_LE_READ_LOCAL_FEATURES:
+        params[4] = (opcode == HCI_OPCODE_READ_LOCAL_FEATURES) ? 0x60 : 0x00; /* LE supported, BR/EDR not */
+        params_len = 8;
+        break;
+    case HCI_OPCODE_READ_BD_ADDR:
+        memcpy(params, m_bd_addr, sizeof(m_bd_addr));
+        params_len = sizeof(m_bd_addr);
+        break;
+    case HCI_OPCODE_LE_READ_BUFFER_SIZE:
+        params[0] = m_buffer_cfg.tx_packet_size;
+        params[2] = DATA_QUEUE_SIZE;
+        params_len = 3;
+        break;
+    case HCI_OPCODE_LE_RAND:
+        if (m_rand_source.rand_prio_low_get == NULL ||
+            m_rand_source.rand_prio_low_get(params, 8) != 8)
+        {
+            m_rand_source.rand_poll(params, 8);
+        }
+        params_len = 8;
+        break;
+    default:
+        status = HCI_STATUS_UNKNOWN_COMMAND;
+        break;
+    }
+
+    m_command_complete_put(opcode, status, params, params_len);
+    if (opcode == HCI_OPCODE_RESET)
+    {
+        m_connections_put();
+    }
+    return 0;
+}
+
+int32_t sdc_hci_evt_get(uint8_t * p_evt_out)
+{
+    int32_t err_code = -NRF_EAGAIN;
+    bool    signal = false;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_evt_count > 0)
+    {
+        uint8_t const * p_evt = m_evt_queue[m_evt_in].buffer;
+
+        memcpy(p_evt_out, p_evt, HCI_EVT_HEADER_SIZE + p_evt[1]);
+        m_evt_in = (m_evt_in + 1) % EVT_QUEUE_SIZE;
+        m_evt_count--;
+        signal = m_data_room_made();
+        err_code = 0;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (signal)
+    {
+        m_signal_host();
+    }
+    return err_code;
+}
+
+/* Queue a packet to be looped back, with its completion event. Must be called with m_lock
+   held. Returns false if the queues are full. */
+static bool m_data_loop_back(uint8_t const * p_data)
+{
+    uint16_t length = (uint16_t)(p_data[2] | (p_data[3] << 8));
+    uint16_t handle = (uint16_t)((p_data[0] | (p_data[1] << 8)) & 0x0FFF);
+    uint8_t *p_evt;
+
+    /* Keep room for the completion event so every accepted packet is acknowledged. */
+    if (m_data_count == DATA_QUEUE_SIZE || m_evt_count == EVT_QUEUE_SIZE)
+    {
+        return false;
+    }
+
+    memcpy(m_data_queue[(m_data_in + m_data_count) % DATA_QUEUE_SIZE].buffer,
+           p_data,
+           HCI_DATA_HEADER_SIZE + length);
+    m_data_count++;
+
+    p_evt = m_evt_alloc();
+    p_evt[0] = HCI_EVT_NUMBER_OF_COMPLETED_PACKETS;
+    p_evt[1] = 5;
+    p_evt[2] = 1;
+    p_evt[3] = (uint8_t)(handle & 0xFF);
+    p_evt[4] = (uint8_t)(handle >> 8);
+    p_evt[5] = 1;
+    p_evt[6] = 0;
+    return true;
+}
+
+static void * m_slow_thread_main(void * p_arg)
+{
+    (void)p_arg;
+
+    for (;;)
+    {
+        bool done = false;
+
+        pthread_mutex_lock(&m_lock);
+        while (!m_slow_busy)
+        {
+            pthread_cond_wait(&m_slow_cond, &m_lock);
+        }
+        pthread_mutex_unlock(&m_lock);
+
+        (void)usleep(m_slow_interval_ms * 1000);
+        while (!done)
+        {
+            pthread_mutex_lock(&m_lock);
+            done = m_data_loop_back(m_slow_packet.buffer);
+            m_slow_busy = !done;
+            pthread_mutex_unlock(&m_lock);
+            if (!done)
+            {
+                (void)usleep(1000);
+            }
+        }
+        m_signal_host();
+    }
+
+    return NULL;
+}
+
+static void m_slow_link_start(void)
+{
+    char const * p_slow = getenv("HCI_HOST_SLOW_LINK");
+    char *       p_end;
+
+    /* Once, the controller is enabled again when Profile Select changes the profile. */
+    if (p_slow == NULL || m_slow_handle != 0xFFFF)
+    {
+        return;
+    }
+
+    m_slow_handle = (uint16_t)(strtoul(p_slow, &p_end, 0) & 0x0FFF);
+    m_slow_interval_ms = (*p_end == ':') ? (uint32_t)strtoul(p_end + 1, NULL, 10) : 100;
+    if (pthread_create(&m_slow_thread, NULL, m_slow_thread_main, NULL) != 0)
+    {
+        m_slow_handle = 0xFFFF;
+        return;
+    }
+    fprintf(stderr, "hci_host: handle 0x%03X takes one packet every %u ms\n", m_slow_handle, m_slow_interval_ms);
+}
+
+int32_t sdc_hci_data_put(uint8_t const * p_data_in)
+{
+    uint16_t length = (uint16_t)(p_data_in[2] | (p_data_in[3] << 8));
+    uint16_t handle = (uint16_t)((p_data_in[0] | (p_data_in[1] << 8)) & 0x0FFF);
+    bool     taken;
+
+    if (length > HCI_DATA_MAX_SIZE)
+    {
+        return -NRF_EINVAL;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    if (handle == m_slow_handle)
+    {
+        taken = !m_slow_busy;
+        if (taken)
+        {
+            memcpy(m_slow_packet.buffer, p_data_in, HCI_DATA_HEADER_SIZE + length);
+            m_slow_busy = true;
+            pthread_cond_signal(&m_slow_cond);
+        }
+        pthread_mutex_unlock(&m_lock);
+        return taken ? 0 : -NRF_ENOMEM;
+    }
+
+    taken = m_data_loop_back(p_data_in);
+    m_data_refused |= !taken;
+    pthread_mutex_unlock(&m_lock);
+    if (!taken)
+    {
+        return -NRF_ENOMEM;
+    }
+
+    m_signal_host();
+    return 0;
+}
+
+int32_t sdc_hci_data_get(uint8_t * p_data_out)
+{
+    int32_t err_code = -NRF_EAGAIN;
+    bool    signal = false;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_data_count > 0)
+    {
+        uint8_t const * p_data = m_data_queue[m_data_in].buffer;
+        uint16_t        length = (uint16_t)(p_data[2] | (p_data[3] << 8));
+
+        memcpy(p_data_out, p_data, HCI_DATA_HEADER_SIZE + length);
+        m_data_in = (m_data_in + 1) % DATA_QUEUE_SIZE;
+        m_data_count--;
+        signal = m_data_room_made();
+        err_code = 0;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (signal)
+    {
+        m_signal_host();
+    }
+    return err_code;
+}
+
+int32_t sdc_init(sdc_fault_handler_t fault_handler)
+{
+    (void)fault_handler;
+    return 0;
+}
+
+int32_t sdc_cfg_set(uint8_t config_tag, uint8_t config_type, sdc_cfg_t const * p_resource_cfg)
+{
+    (void)config_tag;
+
+    switch (config_type)
+    {
+    case SDC_CFG_TYPE_NONE:
+        break;
+    case SDC_CFG_TYPE_MASTER_COUNT:
+        m_master_count = p_resource_cfg->master_count.count;
+        break;
+    case SDC_CFG_TYPE_SLAVE_COUNT:
+        m_slave_count = p_resource_cfg->slave_count.count;
+        break;
+    case SDC_CFG_TYPE_BUFFER_CFG:
+        m_buffer_cfg = p_resource_cfg->buffer_cfg;
+        break;
+    default:
+        return -NRF_EINVAL;
+    }
+
+    return m_required_memory();
+}
+
+int32_t sdc_enable(sdc_callback_t callback, uint8_t * p_mem)
+{
+    (void)p_mem;
+
+    m_callback = callback;
+    m_slow_link_start();
+    return 0;
+}
+
+int32_t sdc_disable(void)
+{
+    m_callback = NULL;
+    return 0;
+}
+
+int32_t sdc_rand_source_register(sdc_rand_source_t const * p_rand_source)
+{
+    m_rand_source = *p_rand_source;
+    return 0;
+}
+
+int32_t sdc_support_adv(void)
+{
+    return 0;
+}
+
+int32_t sdc_support_ext_adv(void)
+{
+    return 0;
+}
+
+int32_t sdc_support_slave(void)
+{
+    return 0;
+}
+
+int32_t sdc_support_scan(void)
+{
+    return 0;
+}
+
+int32_t sdc_support_ext_scan(void)
+{
+    return 0;
+}
+
+int32_t sdc_support_master(void)
+{
+    return 0;
+}
+
+int32_t sdc_support_dle(void)
+{
+    return 0;
+}
+
+int32_t sdc_support_le_2m_phy(void)
+{
+    return 0;
+}
+
+int32_t sdc_support_le_coded_phy(void)
+{
+    return 0;
+}
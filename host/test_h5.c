@@ -0,0 +1,194 @@
+/*
+ * Check that transport_h5.c drops the frames it has to, with a loopback in
+ * place of the UARTE.
+ *
+ * Usage: test_h5
+ *
+ * The link is brought up without CRCs, and reliable frames are sent whose
+ * length field is one and two bytes over H5_PAYLOAD_MAX, then one of
+ * H5_PAYLOAD_MAX. Only the last may be passed on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "transport.h"
+#include "transport_h5.h"
+#include "slip.h"
+
+/* The lower transport of transport_h5.c, fed by m_h5_send. Every RX buffer is ended before
+   it is full, so transport_h5.c arms both again each time and the first is the one to fill. */
+static transport_evt_handler_t m_lower_handler;
+static uint8_t *               m_lower_rx;
+static size_t                  m_lower_rx_size;
+static bool                    m_lower_tx_busy;
+
+/* What transport_h5.c hands over to the H4 framing. */
+static uint8_t m_app_rx[2 * H5_PAYLOAD_MAX];
+static size_t  m_app_rx_bytes;
+
+uint32_t SystemCoreClock = 64000000;
+
+DWT_Type * host_dwt_get(void)
+{
+    static DWT_Type dwt;
+
+    return &dwt;
+}
+
+static void m_lower_open(transport_evt_handler_t handler, uint8_t irq_priority)
+{
+    (void)irq_priority;
+    m_lower_handler = handler;
+}
+
+static void m_lower_rx_arm(uint8_t * p_data, size_t length)
+{
+    if (m_lower_rx == NULL)
+    {
+        m_lower_rx = p_data;
+        m_lower_rx_size = length;
+    }
+}
+
+static void m_lower_rx_flush(void)
+{
+}
+
+static bool m_lower_rx_activity_get(void)
+{
+    return false;
+}
+
+static void m_lower_rx_wake_enable(void)
+{
+}
+
+static void m_lower_tx(uint8_t const * p_data, size_t length)
+{
+    (void)p_data;
+    (void)length;
+    m_lower_tx_busy = true;
+}
+
+static void m_lower_irq(void)
+{
+}
+
+static void m_lower_panic_tx(uint8_t const * p_data, size_t length)
+{
+    (void)p_data;
+    (void)length;
+}
+
+const transport_t transport_uarte =
+    {
+        .open = m_lower_open,
+        .rx_arm = m_lower_rx_arm,
+        .rx_flush = m_lower_rx_flush,
+        .rx_activity_get = m_lower_rx_activity_get,
+        .rx_wake_enable = m_lower_rx_wake_enable,
+        .tx = m_lower_tx,
+        .irq_disable = m_lower_irq,
+        .irq_enable = m_lower_irq,
+        .panic_tx = m_lower_panic_tx,
+        .poll = NULL,
+        .rx_idle_fill = false,
+};
+
+static void m_app_event_handler(transport_evt_t const * p_evt)
+{
+    if (p_evt->type == TRANSPORT_EVT_RX_DONE)
+    {
+        m_app_rx_bytes = p_evt->bytes;
+    }
+}
+
+/* Send one frame from the host, with the length field set to payload_length and length bytes
+   of payload after the header, and no CRC. */
+static void m_h5_send(bool reliable, uint8_t seq, uint8_t type, uint16_t payload_length,
+                      uint8_t const * p_payload, size_t length)
+{
+    static uint8_t encoded[2 + SLIP_ENCODED_SIZE_MAX(H5_HEADER_SIZE + 2 * H5_PAYLOAD_MAX)];
+    uint8_t        header[H5_HEADER_SIZE];
+    uint8_t *      p_out = encoded;
+    size_t         sent = 0;
+
+    header[0] = (uint8_t)(seq | (reliable ? H5_HDR_RELIABLE_MSK : 0));
+    header[1] = (uint8_t)(type | ((payload_length & 0x0F) << 4));
+    header[2] = (uint8_t)(payload_length >> 4);
+    header[3] = (uint8_t)~(header[0] + header[1] + header[2]);
+
+    *p_out++ = SLIP_END;
+    p_out = slip_encode(p_out, header, sizeof(header));
+    p_out = slip_encode(p_out, p_payload, length);
+    *p_out++ = SLIP_END;
+
+    while (sent < (size_t)(p_out - encoded))
+    {
+        transport_evt_t evt = {.type = TRANSPORT_EVT_RX_DONE};
+        size_t          chunk = (size_t)(p_out - encoded) - sent;
+
+        if (chunk > m_lower_rx_size - 1)
+        {
+            chunk = m_lower_rx_size - 1;
+        }
+        memcpy(m_lower_rx, &encoded[sent], chunk);
+        sent += chunk;
+
+        evt.p_data = m_lower_rx;
+        evt.bytes = chunk;
+        m_lower_rx = NULL;
+        m_lower_handler(&evt);
+
+        if (m_lower_tx_busy)
+        {
+            transport_evt_t tx_done = {.type = TRANSPORT_EVT_TX_DONE};
+
+            m_lower_tx_busy = false;
+            m_lower_handler(&tx_done);
+        }
+    }
+}
+
+/* Bring the link up without CRCs, and send reliable frames whose length field does not
+   fit in a packet. They have to be dropped, and the same sequence number taken for the
+   largest packet afterwards. */
+static int m_h5_run(void)
+{
+    static uint8_t const sync_response[] = {0x02, 0x7D};
+    static uint8_t const config_response[] = {0x04, 0x7B, 0x04};
+    static uint8_t       payload[H5_PAYLOAD_MAX + 2];
+
+    printf("H5 frames without CRC\n");
+
+    memset(payload, 0x5A, sizeof(payload));
+    transport_h5.open(m_app_event_handler, 0);
+    m_h5_send(false, 0, H5_TYPE_LINK_CONTROL, sizeof(sync_response), sync_response, sizeof(sync_response));
+    m_h5_send(false, 0, H5_TYPE_LINK_CONTROL, sizeof(config_response), config_response, sizeof(config_response));
+
+    for (uint16_t length = H5_PAYLOAD_MAX + 2; length >= H5_PAYLOAD_MAX; length--)
+    {
+        bool taken;
+
+        m_app_rx_bytes = 0;
+        transport_h5.rx_arm(m_app_rx, sizeof(m_app_rx));
+        m_h5_send(true, 0, H5_TYPE_ACL_DATA, length, payload, length);
+
+        taken = (m_app_rx_bytes != 0);
+        printf("  %u bytes of payload: %s\n", length, taken ? "taken" : "dropped");
+        if (taken != (length <= H5_PAYLOAD_MAX) || (taken && m_app_rx_bytes != 1u + length))
+        {
+            printf("  expected only %u bytes of payload to be taken\n", H5_PAYLOAD_MAX);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(void)
+{
+    return m_h5_run();
+}
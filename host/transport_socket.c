@@ -0,0 +1,363 @@
+/*
+ * Host transport over a Unix socket, bypassing the UARTE stand-in.
+ *
+ * Listens at HCI_HOST_SOCKET (default /tmp/hci_host.sock) and serves one
+ * host at a time. Bytes go straight between the socket and the buffers of
+ * the H4 framing, with no baud rate, line errors or idle flush, so that the
+ * framing and scheduling code can be measured on its own.
+ *
+ * A thread stands in for the transport interrupt, in the UARTE0 slot of the
+ * emulated NVIC. Each read ends the RX buffer, like a flush, unless it filled
+ * the buffer. Reception never reads ahead of the armed buffers, so the
+ * kernel buffer plays the role of flow control.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "transport.h"
+#include "host_port.h"
+
+#define RX_BUFFER_COUNT 2
+
+#define SOCKET_PATH_DEFAULT "/tmp/hci_host.sock"
+
+typedef struct
+{
+    uint8_t * p_data;
+    size_t    length;
+} rx_buffer_t;
+
+static transport_evt_handler_t m_handler;
+
+/* State shared with the thread. Taken inside the interrupt lock, never around it. */
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static rx_buffer_t m_rx[RX_BUFFER_COUNT];
+static uint8_t     m_rx_count;
+
+static uint8_t const * m_p_tx;
+static size_t          m_tx_length;
+static size_t          m_tx_done;
+
+static int       m_fd = -1;
+static int       m_listen_fd = -1;
+static int       m_wake_fd[2] = {-1, -1};
+static pthread_t m_thread;
+
+
+static void m_accept(void)
+{
+    int fd;
+
+    fprintf(stderr, "hci_host: waiting for host on socket\n");
+    do
+    {
+        fd = accept(m_listen_fd, NULL, NULL);
+    } while (fd < 0 && errno == EINTR);
+
+    if (fd < 0)
+    {
+        perror("hci_host: accept");
+        exit(EXIT_FAILURE);
+    }
+    (void)fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    pthread_mutex_lock(&m_lock);
+    m_fd = fd;
+    pthread_mutex_unlock(&m_lock);
+}
+
+static void m_listen(char const * p_path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+
+    (void)strncpy(addr.sun_path, p_path, sizeof(addr.sun_path) - 1);
+    (void)unlink(p_path);
+
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listen_fd < 0 ||
+        bind(m_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(m_listen_fd, 1) != 0)
+    {
+        perror("hci_host: socket");
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stderr, "hci_host: H4 on unix:%s (socket transport)\n", p_path);
+}
+
+/* Drop the current host. A transfer in progress is completed, its bytes are lost. */
+static void m_hangup(void)
+{
+    transport_evt_t evt = {.type = TRANSPORT_EVT_TX_DONE};
+
+    host_irq_enter(UARTE0_UART0_IRQn);
+    pthread_mutex_lock(&m_lock);
+    (void)close(m_fd);
+    m_fd = -1;
+    if (m_tx_length != 0)
+    {
+        evt.p_data = (uint8_t *)m_p_tx;
+        evt.bytes = m_tx_length;
+        m_tx_length = 0;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (evt.p_data != NULL)
+    {
+        m_handler(&evt);
+    }
+    host_irq_exit();
+}
+
+static void m_wake(void)
+{
+    uint8_t dummy = 0;
+
+    if (m_wake_fd[1] >= 0)
+    {
+        (void)write(m_wake_fd[1], &dummy, 1);
+    }
+}
+
+/* Move TX bytes onto the socket, and signal TX_DONE once all are written. */
+static void m_tx_process(void)
+{
+    transport_evt_t evt = {.type = TRANSPORT_EVT_TX_DONE};
+
+    host_irq_enter(UARTE0_UART0_IRQn);
+    pthread_mutex_lock(&m_lock);
+    if (m_tx_done < m_tx_length)
+    {
+        ssize_t n = write(m_fd, &m_p_tx[m_tx_done], m_tx_length - m_tx_done);
+        if (n > 0)
+        {
+            m_tx_done += (size_t)n;
+        }
+        if (m_tx_done == m_tx_length)
+        {
+            evt.p_data = (uint8_t *)m_p_tx;
+            evt.bytes = m_tx_length;
+            m_tx_length = 0;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (evt.p_data != NULL)
+    {
+        m_handler(&evt);
+    }
+    host_irq_exit();
+}
+
+/* Read into the first armed buffer. Returns false if the host has hung up. */
+static bool m_rx_process(void)
+{
+    transport_evt_t evt = {.type = TRANSPORT_EVT_RX_DONE};
+    bool            connected = true;
+
+    host_irq_enter(UARTE0_UART0_IRQn);
+    pthread_mutex_lock(&m_lock);
+    if (m_rx_count > 0)
+    {
+        ssize_t n = read(m_fd, m_rx[0].p_data, m_rx[0].length);
+        if (n > 0)
+        {
+            evt.p_data = m_rx[0].p_data;
+            evt.bytes = (size_t)n;
+
+            if (evt.bytes == m_rx[0].length)
+            {
+                m_rx[0] = m_rx[1];
+                m_rx_count--;
+            }
+            else
+            {
+                /* Ended before it was full, which drops the chained buffer. */
+                m_rx_count = 0;
+            }
+        }
+        else if (n == 0 || (errno != EAGAIN && errno != EINTR))
+        {
+            connected = false;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (evt.p_data != NULL)
+    {
+        m_handler(&evt);
+    }
+    host_irq_exit();
+
+    return connected;
+}
+
+static void * m_thread_main(void * p_arg)
+{
+    (void)p_arg;
+
+    for (;;)
+    {
+        struct pollfd fds[2];
+        uint8_t       drain[16];
+        bool          connected = true;
+
+        if (m_fd < 0)
+        {
+            m_accept();
+        }
+
+        pthread_mutex_lock(&m_lock);
+        fds[0].fd = m_wake_fd[0];
+        fds[0].events = POLLIN;
+        fds[1].fd = m_fd;
+        fds[1].events = ((m_rx_count > 0) ? POLLIN : 0) |
+                        ((m_tx_done < m_tx_length) ? POLLOUT : 0);
+        pthread_mutex_unlock(&m_lock);
+
+        if (poll(fds, 2, -1) < 0 && errno != EINTR)
+        {
+            perror("hci_host: poll");
+            exit(EXIT_FAILURE);
+        }
+
+        while (read(m_wake_fd[0], drain, sizeof(drain)) > 0)
+        {
+        }
+
+        if (fds[1].revents & POLLOUT)
+        {
+            m_tx_process();
+        }
+
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            /* A hang-up is only seen by reading while a buffer is armed. */
+            connected = ((fds[1].events & POLLIN) != 0) ? m_rx_process() : ((fds[1].revents & POLLIN) != 0);
+        }
+
+        if (!connected)
+        {
+            m_hangup();
+        }
+    }
+
+    return NULL;
+}
+
+static void m_open(transport_evt_handler_t handler, uint8_t irq_priority)
+{
+    char const * p_path = getenv("HCI_HOST_SOCKET");
+
+    (void)irq_priority;
+    m_handler = handler;
+
+    m_listen((p_path != NULL) ? p_path : SOCKET_PATH_DEFAULT);
+
+    if (pipe2(m_wake_fd, O_NONBLOCK) != 0 ||
+        pthread_create(&m_thread, NULL, m_thread_main, NULL) != 0)
+    {
+        perror("hci_host: socket transport thread");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void m_rx_arm(uint8_t * p_data, size_t length)
+{
+    pthread_mutex_lock(&m_lock);
+    if (m_rx_count < RX_BUFFER_COUNT)
+    {
+        m_rx[m_rx_count].p_data = p_data;
+        m_rx[m_rx_count].length = length;
+        m_rx_count++;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    m_wake();
+}
+
+/* Every read ends the RX buffer, so there is nothing to flush. */
+static void m_rx_flush(void)
+{
+}
+
+static bool m_rx_activity_get(void)
+{
+    return false;
+}
+
+/* Every read is an interrupt already. */
+static void m_rx_wake_enable(void)
+{
+}
+
+static void m_tx(uint8_t const * p_data, size_t length)
+{
+    pthread_mutex_lock(&m_lock);
+    m_p_tx = p_data;
+    m_tx_length = length;
+    m_tx_done = 0;
+    pthread_mutex_unlock(&m_lock);
+
+    m_wake();
+}
+
+static void m_irq_disable(void)
+{
+    NVIC_DisableIRQ(UARTE0_UART0_IRQn);
+}
+
+static void m_irq_enable(void)
+{
+    NVIC_EnableIRQ(UARTE0_UART0_IRQn);
+}
+
+static void m_panic_tx(uint8_t const * p_data, size_t length)
+{
+    while (m_fd >= 0 && length > 0)
+    {
+        struct pollfd fds = {.fd = m_fd, .events = POLLOUT};
+        ssize_t       n = write(m_fd, p_data, length);
+
+        if (n > 0)
+        {
+            p_data += n;
+            length -= (size_t)n;
+        }
+        else if (n < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            break;
+        }
+        else
+        {
+            (void)poll(&fds, 1, -1);
+        }
+    }
+}
+
+const transport_t transport_socket =
+    {
+        .open = m_open,
+        .rx_arm = m_rx_arm,
+        .rx_flush = m_rx_flush,
+        .rx_activity_get = m_rx_activity_get,
+        .rx_wake_enable = m_rx_wake_enable,
+        .tx = m_tx,
+        .irq_disable = m_irq_disable,
+        .irq_enable = m_irq_enable,
+        .panic_tx = m_panic_tx,
+        .poll = NULL,
+        .rx_idle_fill = false,
+};
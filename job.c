@@ -0,0 +1,123 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "job.h"
+#include "ramfunc.h"
+
+static job_t const * m_p_jobs;
+static uint8_t       m_count;
+static IRQn_Type     m_swi_irqn;
+
+static atomic_uint m_pending[JOB_LEVEL_COUNT];
+
+/* Written by the posting context while the job is not pending, read by the job's level. */
+static volatile uint32_t m_post_cycles[JOB_COUNT_MAX];
+static job_stats_t       m_stats[JOB_COUNT_MAX];
+
+
+static void m_execute(uint8_t id)
+{
+    job_stats_t * p_stats = &m_stats[id];
+    uint32_t      start = DWT->CYCCNT;
+    uint32_t      delay = start - m_post_cycles[id];
+    uint32_t      cycles;
+
+    m_p_jobs[id].handler();
+
+    cycles = DWT->CYCCNT - start;
+    p_stats->runs++;
+    p_stats->cycles += cycles;
+    if (cycles > p_stats->max_cycles)
+    {
+        p_stats->max_cycles = cycles;
+    }
+    if (delay > p_stats->max_delay_cycles)
+    {
+        p_stats->max_delay_cycles = delay;
+    }
+}
+
+/* Run the pending jobs of a level, first in the table first. The mask is read again after
+   every job, so a job posted meanwhile is chosen by its priority. */
+static void m_level_run(job_level_t level)
+{
+    uint32_t pending;
+
+    while ((pending = atomic_load_explicit(&m_pending[level], memory_order_acquire)) != 0)
+    {
+        uint8_t  id = (uint8_t)__builtin_ctz(pending);
+        uint32_t bit = 1UL << id;
+
+        /* Cleared before the run, so that a post during the run runs the job again. */
+        (void)atomic_fetch_and_explicit(&m_pending[level], ~bit, memory_order_acquire);
+        m_execute(id);
+    }
+}
+
+void job_init(job_t const * p_jobs, uint8_t count, IRQn_Type swi_irqn)
+{
+    m_p_jobs = p_jobs;
+    m_count = (count <= JOB_COUNT_MAX) ? count : JOB_COUNT_MAX;
+    m_swi_irqn = swi_irqn;
+
+    memset(m_stats, 0, sizeof(m_stats));
+    for (uint8_t i = 0; i < JOB_LEVEL_COUNT; i++)
+    {
+        atomic_init(&m_pending[i], 0);
+    }
+}
+
+RAMFUNC void job_post(uint8_t id)
+{
+    uint8_t  level;
+    uint32_t bit = 1UL << id;
+
+    if (id >= m_count)
+    {
+        return;
+    }
+    level = m_p_jobs[id].level;
+
+    /* A post that races with another one may restart the delay measurement, which only
+       makes the delay look shorter. */
+    if ((atomic_load_explicit(&m_pending[level], memory_order_relaxed) & bit) == 0)
+    {
+        m_post_cycles[id] = DWT->CYCCNT;
+    }
+    if ((atomic_fetch_or_explicit(&m_pending[level], bit, memory_order_release) & bit) == 0 &&
+        level == JOB_LEVEL_SWI)
+    {
+        NVIC_SetPendingIRQ(m_swi_irqn);
+    }
+}
+
+void job_run(void)
+{
+    m_level_run(JOB_LEVEL_THREAD);
+}
+
+bool job_pending(void)
+{
+    return atomic_load_explicit(&m_pending[JOB_LEVEL_THREAD], memory_order_relaxed) != 0;
+}
+
+void job_swi_process(void)
+{
+    m_level_run(JOB_LEVEL_SWI);
+}
+
+void job_stats_get(uint8_t id, job_stats_t * p_stats, bool reset)
+{
+    if (id >= m_count)
+    {
+        memset(p_stats, 0, sizeof(*p_stats));
+        return;
+    }
+
+    *p_stats = m_stats[id];
+    if (reset)
+    {
+        memset(&m_stats[id], 0, sizeof(m_stats[id]));
+    }
+}
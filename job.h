@@ -0,0 +1,71 @@
+#ifndef JOB_H__
+#define JOB_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "nrf.h"
+
+/* Run to completion jobs, without an RTOS or a heap. The jobs are a constant table given to
+   job_init(), and a job's index in it is both its identifier and its priority: whenever a
+   job is chosen, it is the first pending one in the table. Jobs of one level do not preempt
+   each other, so they share data without locking.
+
+   Posting sets the job's bit in the pending mask of its level with an atomic OR, so it can be
+   done from any interrupt or job. A job posted again before it has run runs once.
+
+   Thread level jobs are run by job_run() from the main loop. SWI level jobs are run from a
+   software interrupt, by job_swi_process() called from its handler, and preempt the thread
+   level. Its priority decides what else they preempt and are preempted by.
+
+   The cycles each job has taken, and the time from its post to its start, are counted with
+   the DWT cycle counter. */
+#ifndef JOB_COUNT_MAX
+#define JOB_COUNT_MAX 8
+#endif
+
+#if JOB_COUNT_MAX > 32
+#error "JOB_COUNT_MAX must be 32 at most, one bit of the pending mask each"
+#endif
+
+typedef enum
+{
+    JOB_LEVEL_THREAD,
+    JOB_LEVEL_SWI,
+    JOB_LEVEL_COUNT
+} job_level_t;
+
+typedef struct
+{
+    void    (* handler)(void);
+    uint8_t level;              /* job_level_t */
+} job_t;
+
+/* Counters wrap, readers should work with differences between two reads. */
+typedef struct
+{
+    uint32_t runs;
+    uint32_t cycles;            /* Total of all runs */
+    uint32_t max_cycles;
+    uint32_t max_delay_cycles;  /* Longest from a post to the start of the run */
+} job_stats_t;
+
+/* swi_irqn is pended for SWI level jobs, its priority is left to the caller. */
+void job_init(job_t const * p_jobs, uint8_t count, IRQn_Type swi_irqn);
+
+void job_post(uint8_t id);
+
+/* Run pending thread level jobs until none is left. */
+void job_run(void);
+
+/* A thread level job is pending. */
+bool job_pending(void);
+
+/* Run pending SWI level jobs until none is left. Called from the handler of swi_irqn. */
+void job_swi_process(void);
+
+/* Copy the counters of a job, and clear them if reset is set. Call from the job's level, so
+   that it does not run meanwhile. */
+void job_stats_get(uint8_t id, job_stats_t * p_stats, bool reset);
+
+#endif // JOB_H__
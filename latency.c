@@ -0,0 +1,62 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "nrf.h"
+
+#include "latency.h"
+
+#if LATENCY_STATS
+
+#ifdef HCI_HOST_BUILD
+#include <time.h>
+
+#define M_TICKS_PER_US 1000
+#else
+#define M_TICKS_PER_US (SystemCoreClock / 1000000)
+#endif
+
+static latency_hist_t m_hists[LATENCY_COUNT];
+
+
+uint32_t latency_now(void)
+{
+#ifdef HCI_HOST_BUILD
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec) | 1;
+#else
+    return DWT->CYCCNT | 1;
+#endif
+}
+
+void latency_record(latency_id_t id, uint32_t start)
+{
+    latency_hist_t * p_hist = &m_hists[id];
+    uint32_t         us = (latency_now() - start) / M_TICKS_PER_US;
+    uint32_t         bucket = (us < 2) ? 0 : (31 - __CLZ(us));
+
+    if (bucket >= LATENCY_BUCKET_COUNT)
+    {
+        bucket = LATENCY_BUCKET_COUNT - 1;
+    }
+
+    p_hist->count++;
+    p_hist->total_us += us;
+    p_hist->buckets[bucket]++;
+    if (us > p_hist->max_us)
+    {
+        p_hist->max_us = us;
+    }
+}
+
+void latency_read(latency_id_t id, latency_hist_t * p_hist, bool reset)
+{
+    *p_hist = m_hists[id];
+    if (reset)
+    {
+        memset(&m_hists[id], 0, sizeof(m_hists[id]));
+    }
+}
+
+#endif // LATENCY_STATS
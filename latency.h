@@ -0,0 +1,59 @@
+#ifndef LATENCY_H__
+#define LATENCY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Latency histograms of the HCI pipeline. Timestamps come from the DWT cycle counter, which
+   must be running, or from clock_gettime in the host build. Recording a sample costs a
+   subtraction, a division and a count leading zeros, so they are cheap enough to leave
+   enabled. Set LATENCY_STATS to 0 to compile them out. */
+#ifndef LATENCY_STATS
+#define LATENCY_STATS 1
+#endif
+
+/* Samples are counted in power of two buckets of microseconds: bucket 0 holds 0 and 1 us,
+   bucket n holds [2^n, 2^(n+1)) us, and the last bucket everything longer. */
+#define LATENCY_BUCKET_COUNT 16
+
+typedef enum
+{
+    LATENCY_CMD_TO_EVT,     /* Command received from the host until its Command Complete or Command Status is fetched */
+    LATENCY_EVT_TO_TX,      /* Event fetched from the controller until the transfer carrying it starts */
+    LATENCY_TX_DURATION,    /* Transfer to the host started until TX_DONE */
+    LATENCY_WAKE_TO_TX,     /* Controller signal while the transport is idle until the transfer starts */
+    LATENCY_COUNT
+} latency_id_t;
+
+/* Counters wrap, readers should work with differences between two reads. */
+typedef struct
+{
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t total_us;
+    uint32_t buckets[LATENCY_BUCKET_COUNT];
+} latency_hist_t;
+
+#if LATENCY_STATS
+
+/* Current timestamp, in ticks. Never 0, so 0 can mark a timestamp as unset. */
+uint32_t latency_now(void);
+
+/* Add the time since the timestamp start to a histogram. Samples of one histogram must not
+   be recorded from more than one interrupt priority. */
+void latency_record(latency_id_t id, uint32_t start);
+
+/* Copy a histogram, and clear it if reset is set. The caller must keep the recording
+   context from preempting this. */
+void latency_read(latency_id_t id, latency_hist_t * p_hist, bool reset);
+
+#else
+
+#define latency_now() 0
+#define latency_record(id, start) ((void)(start))
+#define latency_read(id, p_hist, reset) memset((p_hist), 0, sizeof(latency_hist_t))
+
+#endif // LATENCY_STATS
+
+#endif // LATENCY_H__
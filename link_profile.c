@@ -0,0 +1,47 @@
+#include <stddef.h>
+
+#include "link_profile.h"
+
+/* Air time on LE 2M: preamble, access address, header and CRC around the payload. */
+#define M_US_PER_BYTE       4
+#define M_PDU_OVERHEAD      11
+#define M_T_IFS_US          150
+
+#define M_SIZE_MIN          27
+#define M_SIZE_MAX          251
+
+
+bool link_profile_valid(link_profile_t const * p_profile)
+{
+    return (p_profile->tx_count >= 1) && (p_profile->rx_count >= 1) &&
+           (p_profile->tx_size >= M_SIZE_MIN) && (p_profile->tx_size <= M_SIZE_MAX) &&
+           (p_profile->rx_size >= M_SIZE_MIN) && (p_profile->rx_size <= M_SIZE_MAX);
+}
+
+/* Payload of a connection event of up to count PDUs of size bytes, in kbit/s. */
+static uint32_t m_kbps(uint8_t count, uint8_t size, uint32_t interval_us)
+{
+    uint32_t exchange_us = M_US_PER_BYTE * (M_PDU_OVERHEAD + size) + M_T_IFS_US +
+                           M_US_PER_BYTE * M_PDU_OVERHEAD + M_T_IFS_US;
+    uint32_t fit = interval_us / exchange_us;
+    uint32_t pdus = (count < fit) ? count : fit;
+
+    return (uint32_t)(((uint64_t)pdus * size * 8 * 1000) / interval_us);
+}
+
+void link_profile_size(link_profile_t const * p_profile, uint32_t interval_us, link_profile_size_t * p_size)
+{
+    if (interval_us < LINK_PROFILE_INTERVAL_MIN_US)
+    {
+        interval_us = LINK_PROFILE_INTERVAL_MIN_US;
+    }
+
+    p_size->sdc_mem = LINK_PROFILE_MEM(p_profile->master_count,
+                                       p_profile->slave_count,
+                                       p_profile->tx_size,
+                                       p_profile->rx_size,
+                                       p_profile->tx_count,
+                                       p_profile->rx_count);
+    p_size->tx_kbps = m_kbps(p_profile->tx_count, p_profile->tx_size, interval_us);
+    p_size->rx_kbps = m_kbps(p_profile->rx_count, p_profile->rx_size, interval_us);
+}
@@ -0,0 +1,53 @@
+#ifndef LINK_PROFILE_H__
+#define LINK_PROFILE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sdc.h"
+
+/* Links and buffers the controller is configured with, chosen at boot instead of at compile
+   time, so that one firmware serves products with many slow links as well as products with
+   few fast ones. link_profile_size() tells what a profile costs in controller memory and
+   what throughput its buffers allow. */
+
+/* Controller memory for a configuration, as sdc_cfg_set() returns it. */
+#define LINK_PROFILE_MEM(master_count, slave_count, tx_size, rx_size, tx_count, rx_count)  \
+    ( (SDC_MEM_PER_MASTER_LINK(tx_size, rx_size, tx_count, rx_count) * (master_count)) +   \
+      (SDC_MEM_PER_SLAVE_LINK(tx_size, rx_size, tx_count, rx_count) * (slave_count)) +     \
+      (((master_count) > 0) ? SDC_MEM_MASTER_LINKS_SHARED : 0) +                         \
+      (((slave_count) > 0) ? SDC_MEM_SLAVE_LINKS_SHARED : 0))
+
+/* Shortest connection interval, the default for the throughput estimate. */
+#define LINK_PROFILE_INTERVAL_MIN_US 7500
+
+typedef struct
+{
+    uint8_t master_count;
+    uint8_t slave_count;
+    uint8_t tx_count;       /* Buffers per link */
+    uint8_t rx_count;
+    uint8_t tx_size;        /* Link layer payload bytes per buffer */
+    uint8_t rx_size;
+} link_profile_t;
+
+typedef struct
+{
+    uint32_t sdc_mem;       /* Controller memory */
+    uint32_t tx_kbps;       /* Estimated peak throughput of one link, in kbit/s */
+    uint32_t rx_kbps;
+} link_profile_size_t;
+
+/* The counts and sizes are within what the controller takes. */
+bool link_profile_valid(link_profile_t const * p_profile);
+
+/* Size up a profile for links with the given connection interval.
+
+   A link sends at most tx_count PDUs in a connection event, as the host cannot refill the
+   buffers within one, and receives at most rx_count. The estimate is the payload of that many
+   full PDUs, or of as many as fit in the interval, whichever is less, on LE 2M without
+   encryption, with the peer answering each with an empty PDU. It is an upper bound that
+   shows where more buffers stop paying off, not a prediction. */
+void link_profile_size(link_profile_t const * p_profile, uint32_t interval_us, link_profile_size_t * p_size);
+
+#endif // LINK_PROFILE_H__
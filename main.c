@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 
-#include "nrfx_uarte.h"
+#include "nrfx.h"
 
 #include "mpsl.h"
 #include "mpsl_timeslot.h"
@@ -15,349 +15,2067 @@
 #include "rand_numbers.h"
 #include "nrfx_rng.h"
 
+#include "rx_pool.h"
+#include "latency.h"
+#include "transport.h"
+#include "ramfunc.h"
+#include "hci_trace.h"
+#include "h4_parser.h"
+#include "acl_queue.h"
+#include "job.h"
+#include "link_profile.h"
+
+/* Links and buffers of the default profile, see m_link_profiles. Roles that are compiled out
+   get no links, and without DLE the buffers have the default size, so that no memory is set
+   aside for them. */
+#ifndef MASTER_COUNT
 #define MASTER_COUNT 2
+#endif
+#ifndef SLAVE_COUNT
 #define SLAVE_COUNT 2
+#endif
+#ifndef TX_SIZE
 #define TX_SIZE 251
+#endif
+#ifndef RX_SIZE
 #define RX_SIZE 251
+#endif
+#ifndef TX_COUNT
 #define TX_COUNT 3
+#endif
+#ifndef RX_COUNT
 #define RX_COUNT 3
+#endif
+
+/* The other built-in profiles: many links with few buffers each, and few links with enough
+   buffers to fill a connection event. */
+#ifndef PROFILE_MANY_MASTER_COUNT
+#define PROFILE_MANY_MASTER_COUNT 6
+#endif
+#ifndef PROFILE_MANY_SLAVE_COUNT
+#define PROFILE_MANY_SLAVE_COUNT 2
+#endif
+#ifndef PROFILE_MANY_TX_COUNT
+#define PROFILE_MANY_TX_COUNT 2
+#endif
+#ifndef PROFILE_MANY_RX_COUNT
+#define PROFILE_MANY_RX_COUNT 2
+#endif
+#ifndef PROFILE_FAST_MASTER_COUNT
+#define PROFILE_FAST_MASTER_COUNT 1
+#endif
+#ifndef PROFILE_FAST_SLAVE_COUNT
+#define PROFILE_FAST_SLAVE_COUNT 1
+#endif
+#ifndef PROFILE_FAST_TX_COUNT
+#define PROFILE_FAST_TX_COUNT 8
+#endif
+#ifndef PROFILE_FAST_RX_COUNT
+#define PROFILE_FAST_RX_COUNT 8
+#endif
+
+/* The stored profile is the index into m_link_profiles in UICR CUSTOMER[PROFILE_UICR_CUSTOMER],
+   and profile 0 while the register is erased. */
+#ifndef PROFILE_UICR_CUSTOMER
+#define PROFILE_UICR_CUSTOMER 0
+#endif
+
+#ifdef INCLUDE_FEATURE_MASTER_ROLE
+#define M_MASTER_LINKS(count) (count)
+#else
+#define M_MASTER_LINKS(count) 0
+#endif
+#ifdef INCLUDE_FEATURE_SLAVE_ROLE
+#define M_SLAVE_LINKS(count) (count)
+#else
+#define M_SLAVE_LINKS(count) 0
+#endif
+#ifdef INCLUDE_FEATURE_DLE
+#define M_LINK_TX_SIZE TX_SIZE
+#define M_LINK_RX_SIZE RX_SIZE
+#else
+#define M_LINK_TX_SIZE SDC_DEFAULT_TX_PACKET_SIZE
+#define M_LINK_RX_SIZE SDC_DEFAULT_RX_PACKET_SIZE
+#endif
+
+/* The fast profile is about its few links, so with one role built in that role takes the
+   links of both. */
+#if defined(INCLUDE_FEATURE_MASTER_ROLE) && defined(INCLUDE_FEATURE_SLAVE_ROLE)
+#define M_FAST_MASTER_COUNT PROFILE_FAST_MASTER_COUNT
+#define M_FAST_SLAVE_COUNT PROFILE_FAST_SLAVE_COUNT
+#else
+#define M_FAST_MASTER_COUNT (PROFILE_FAST_MASTER_COUNT + PROFILE_FAST_SLAVE_COUNT)
+#define M_FAST_SLAVE_COUNT (PROFILE_FAST_MASTER_COUNT + PROFILE_FAST_SLAVE_COUNT)
+#endif
+
+#define M_MASTER_LINK_COUNT M_MASTER_LINKS(MASTER_COUNT)
+#define M_SLAVE_LINK_COUNT M_SLAVE_LINKS(SLAVE_COUNT)
+
+#if (MASTER_COUNT > 255) || (SLAVE_COUNT > 255) || (TX_COUNT < 1) || (TX_COUNT > 255) || (RX_COUNT < 1) || (RX_COUNT > 255)
+#error "MASTER_COUNT and SLAVE_COUNT must be 0 to 255, TX_COUNT and RX_COUNT 1 to 255"
+#endif
+#if (TX_SIZE < 27) || (TX_SIZE > 251) || (RX_SIZE < 27) || (RX_SIZE > 251)
+#error "TX_SIZE and RX_SIZE must be 27 to 251"
+#endif
 
 #define SOC_CONFIG_PRIO_HIGH 0
 #define SOC_CONFIG_PRIO_LOW 4
 
-#define SDC_MEM_REQUIRED_MAX(master_count, slave_count, tx_size, rx_size, tx_count, rx_count) \
-    ( (SDC_MEM_PER_MASTER_LINK(tx_size, rx_size, tx_count, rx_count) * master_count) + \
-      (SDC_MEM_PER_SLAVE_LINK(tx_size, rx_size, tx_count, rx_count) * slave_count) + \
-      ((master_count > 0) ? SDC_MEM_MASTER_LINKS_SHARED : 0) + \
-      ((slave_count > 0) ? SDC_MEM_SLAVE_LINKS_SHARED : 0))
+/* Sleep with WFE in the main loop when there is no work, instead of polling. The wake
+   sources are the controller host signal, the transport (TX_DONE, RX_DONE and the first byte
+   received while asleep) and the RNG. */
+#ifndef IDLE_SLEEP
+#define IDLE_SLEEP 1
+#endif
+
+/* Transport to the host: transport_uarte, transport_spis, or transport_socket in the host
+   build. */
+#ifndef HCI_TRANSPORT
+#define HCI_TRANSPORT transport_uarte
+#endif
+
+/*lint -emacro(506, BLE_REQUIRED_MEMORY) Constant value Boolean */
+#define BLE_REQUIRED_MEMORY LINK_PROFILE_MEM(M_MASTER_LINK_COUNT, \
+                                             M_SLAVE_LINK_COUNT,  \
+                                             M_LINK_TX_SIZE,      \
+                                             M_LINK_RX_SIZE,      \
+                                             TX_COUNT,            \
+                                             RX_COUNT)
+
+/* Pool memory of a profile: the controller's, rounded up to M_POOL_ALIGN, then the ACL
+   queue of every link, see acl_queue.h. Without links there is nothing to send data on, but
+   one queue is still set aside. */
+#define M_POOL_ALIGN 8
+#define M_POOL_ROUND(size) ((((size) + M_POOL_ALIGN - 1) / M_POOL_ALIGN) * M_POOL_ALIGN)
+#define M_ACL_LINK_COUNT(master_count, slave_count) \
+    ((((master_count) + (slave_count)) > 0) ? ((master_count) + (slave_count)) : 1)
+#define M_PROFILE_POOL_SIZE(master_count, slave_count, tx_count, rx_count)                    \
+    (M_POOL_ROUND(LINK_PROFILE_MEM(M_MASTER_LINKS(master_count), M_SLAVE_LINKS(slave_count),   \
+                                   M_LINK_TX_SIZE, M_LINK_RX_SIZE, tx_count, rx_count)) +     \
+     M_ACL_LINK_COUNT(M_MASTER_LINKS(master_count), M_SLAVE_LINKS(slave_count)) *             \
+     sizeof(acl_queue_link_t))
+
+#define M_MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+/* One pool for the controller and the ACL queues, large enough for every built-in profile.
+   A smaller pool leaves out the profiles that do not fit. */
+#ifndef PROFILE_POOL_SIZE
+#define PROFILE_POOL_SIZE                                                                           \
+    M_MAX(M_PROFILE_POOL_SIZE(MASTER_COUNT, SLAVE_COUNT, TX_COUNT, RX_COUNT),                      \
+          M_MAX(M_PROFILE_POOL_SIZE(PROFILE_MANY_MASTER_COUNT, PROFILE_MANY_SLAVE_COUNT,          \
+                                    PROFILE_MANY_TX_COUNT, PROFILE_MANY_RX_COUNT),               \
+                M_PROFILE_POOL_SIZE(M_FAST_MASTER_COUNT, M_FAST_SLAVE_COUNT,                      \
+                                    PROFILE_FAST_TX_COUNT, PROFILE_FAST_RX_COUNT)))
+#endif
+
+/* Memory of one more TX or RX buffer on every link */
+#define M_SDC_MEM_PER_TX_BUFFER                                                         \
+    (SDC_MEM_PER_SLAVE_LINK(M_LINK_TX_SIZE, M_LINK_RX_SIZE, TX_COUNT + 1, RX_COUNT) -   \
+     SDC_MEM_PER_SLAVE_LINK(M_LINK_TX_SIZE, M_LINK_RX_SIZE, TX_COUNT, RX_COUNT))
+#define M_SDC_MEM_PER_RX_BUFFER                                                         \
+    (SDC_MEM_PER_SLAVE_LINK(M_LINK_TX_SIZE, M_LINK_RX_SIZE, TX_COUNT, RX_COUNT + 1) -   \
+     SDC_MEM_PER_SLAVE_LINK(M_LINK_TX_SIZE, M_LINK_RX_SIZE, TX_COUNT, RX_COUNT))
+
+/* Sizes for the RAM report, as absolute symbols that ram_report.cmake reads from the
+   executable. They take no memory. */
+#define M_RAM_REPORT_SYMBOL(name, value) \
+    __asm__ (".globl ram_report_" #name "\n.set ram_report_" #name ", %c0" : : "i" (value))
+
+/* Stop with the vendor specific assert event if expression is false. Unlike NRFX_ASSERT,
+   this is never compiled out. For failures nothing can be done about: where the host can be
+   told and carry on, return an HCI status instead. */
+#define M_FAULT_CHECK(expression)                      \
+    do                                                 \
+    {                                                  \
+        if (!(expression))                             \
+        {                                              \
+            m_fault_handler(__FILE__, __LINE__);       \
+        }                                              \
+    } while (0)
+
+/* HCI message packet element definition */
+typedef uint8_t hci_element_t;
+
+#define M_DEFAULT_DEVICE_ADDRESS    {0x56, 0xFF, 0x99, 0x00, 0xCD, 0x29} // The default public address
+
+/* The UART header is 1 byte */
+#define H4_UART_HEADER_SIZE 1
+#define M_H4_RX_BUFFER_SIZE (H4_UART_HEADER_SIZE + HCI_MSG_BUFFER_MAX_SIZE)
+#define M_H4_TX_BUFFER_SIZE (H4_UART_HEADER_SIZE + HCI_MSG_BUFFER_MAX_SIZE)
+
+/* Events and ACL data to the host are batched into one transport transfer. The batch buffer size
+   bounds the added latency (about 10 us per byte at 1 Mbaud), the packet count bounds how long
+   the controller queues are drained before the transfer starts. Set both to one packet to
+   send each packet on its own. */
+#ifndef H4_TX_BATCH_MAX_PACKETS
+#define H4_TX_BATCH_MAX_PACKETS 8
+#endif
+#ifndef H4_TX_BATCH_BUFFER_SIZE
+#define H4_TX_BATCH_BUFFER_SIZE (4 * M_H4_TX_BUFFER_SIZE)
+#endif
+
+/* Number of TX batch buffers. While one is sent by the transport, the main loop fills the others,
+   and the TX_DONE interrupt starts the next filled one straight away. */
+#ifndef H4_TX_BUFFER_COUNT
+#define H4_TX_BUFFER_COUNT 2
+#endif
+
+/* Host to controller data is received continuously into a ring of DMA buffers. The transport
+   chains to the next buffer by itself, so there is one interrupt per buffer instead of three
+   per packet. Data that ends mid-buffer is flushed once the line has been idle for
+   H4_RX_IDLE_TIMEOUT_US, by stopping reception (RXTO). */
+#ifndef H4_RX_DMA_BUFFER_SIZE
+#define H4_RX_DMA_BUFFER_SIZE 64
+#endif
+#ifndef H4_RX_IDLE_TIMEOUT_US
+#define H4_RX_IDLE_TIMEOUT_US 50
+#endif
+#define H4_RX_DMA_BUFFER_COUNT 2
+#define M_H4_RX_IDLE_TIMEOUT_CYCLES ((SystemCoreClock / 1000000) * H4_RX_IDLE_TIMEOUT_US)
+
+/* The work of the main loop is split into jobs, see job.h and m_jobs. With HCI_JOB_SWI set
+   they run from SWI4 at a priority below the transport interrupt instead of from the main
+   loop, which then only sleeps and polls. The RX job passes at most H4_RX_JOB_BATCH packets
+   to the controller a run before events waiting for the host get their turn. */
+#ifndef HCI_JOB_SWI
+#define HCI_JOB_SWI 0
+#endif
+#ifndef H4_RX_JOB_BATCH
+#define H4_RX_JOB_BATCH 4
+#endif
+
+/* ACL data of a link that has passed nothing on to the controller for this long is dropped,
+   so that a connection closed without the event being seen cannot hold the receive buffers
+   for good. Longer than the longest supervision timeout, 32 s, within which the controller
+   closes a connection that has stopped. */
+#ifndef ACL_QUEUE_STALE_MS
+#define ACL_QUEUE_STALE_MS 35000
+#endif
+
+/* Weights of events and ACL data to the host. Each turn a queue may send about
+   H4_SCHED_QUANTUM * weight bytes before the other one gets the link. */
+#ifndef H4_SCHED_QUANTUM
+#define H4_SCHED_QUANTUM 256
+#endif
+#ifndef H4_SCHED_EVT_WEIGHT
+#define H4_SCHED_EVT_WEIGHT 1
+#endif
+#ifndef H4_SCHED_ACL_WEIGHT
+#define H4_SCHED_ACL_WEIGHT 1
+#endif
+
+/* HCI events sent ahead of the scheduler */
+#define HCI_EVT_COMMAND_COMPLETE 0x0E
+#define HCI_EVT_COMMAND_STATUS 0x0F
+#define HCI_EVT_NUMBER_OF_COMPLETED_PACKETS 0x13
+
+/* Events that start a link, for which ACL data is then taken, and that end one, whose
+   queued ACL data is then dropped */
+#define HCI_EVT_LE_META 0x3E
+#define HCI_LE_SUBEVT_CONNECTION_COMPLETE 0x01
+#define HCI_LE_SUBEVT_ENHANCED_CONNECTION_COMPLETE 0x0A
+#define HCI_EVT_DISCONNECTION_COMPLETE 0x05
+#define HCI_OPCODE_RESET 0x0C03
+
+/* Vendor specific commands handled by this application instead of the controller. The OCFs
+   are above those used by the SoftDevice Controller. */
+#define HCI_VS_OPCODE_LATENCY_READ 0xFE00
+#define HCI_VS_OPCODE_STATISTICS_READ 0xFE01
+#define HCI_VS_OPCODE_RAND_STATISTICS_READ 0xFE02
+#define HCI_VS_OPCODE_TRACE_READ 0xFE03
+#define HCI_VS_OPCODE_ACL_STATISTICS_READ 0xFE04
+#define HCI_VS_OPCODE_JOB_STATISTICS_READ 0xFE05
+#define HCI_VS_OPCODE_PROFILE_SELECT 0xFE06
+#define HCI_VS_OPCODE_PROFILE_READ 0xFE07
+
+/* Commands answered locally when possible, see m_local_commands and m_local_cache. */
+#define HCI_OPCODE_READ_LOCAL_VERSION 0x1001
+#define HCI_OPCODE_READ_LOCAL_COMMANDS 0x1002
+#define HCI_OPCODE_READ_LOCAL_FEATURES 0x1003
+#define HCI_OPCODE_READ_BD_ADDR 0x1009
+#define HCI_OPCODE_LE_READ_BUFFER_SIZE 0x2002
+#define HCI_OPCODE_LE_READ_LOCAL_FEATURES 0x2003
+#define HCI_OPCODE_LE_RAND 0x2018
+#define HCI_OGF_VENDOR_SPECIFIC 0x3F
+
+/* Answer LE Rand from the random number pools and repeated read-only information commands
+   from the controller's first answer, instead of passing them to the controller. */
+#ifndef HCI_LOCAL_FAST_PATH
+#define HCI_LOCAL_FAST_PATH 1
+#endif
+
+/* Layout version of the Statistics Read return parameters */
+#define HCI_VS_STATISTICS_VERSION 5
+
+/* Vendor specific event reporting that the H4 stream from the host was resynchronised.
+   A Hardware Error event is not used, as hosts answer it with a reset. */
+#define HCI_EVT_VENDOR_SPECIFIC 0xFF
+#define HCI_VS_SUBEVENT_H4_RESYNC 0xAB
+
+/* Return parameters of a Command Complete event, after Num_HCI_Command_Packets and the opcode */
+#define HCI_CMD_COMPLETE_RETURN_MAX_SIZE (255 - 3)
+
+#define HCI_STATUS_SUCCESS 0x00
+#define HCI_STATUS_UNKNOWN_COMMAND 0x01
+#define HCI_STATUS_HARDWARE_FAILURE 0x03
+#define HCI_STATUS_MEMORY_CAPACITY_EXCEEDED 0x07
+#define HCI_STATUS_COMMAND_DISALLOWED 0x0C
+#define HCI_STATUS_INVALID_PARAMETERS 0x12
+
+/* The H4 packet types. */
+typedef enum
+{
+    H4_UART_HCI_COMMAND_PACKET = 0x01,
+    H4_UART_HCI_ACL_DATA_PACKET = 0x02,
+    H4_UART_HCI_SYNCHRONOUS_DATA_PACKET = 0x03,
+    H4_UART_HCI_EVENT_PACKET = 0x04
+} h4_uart_pkt_type_t;
+
+/* RX DMA buffer ring. Buffers are armed, received and parsed in ring order. */
+typedef enum
+{
+    RX_DMA_FREE,
+    RX_DMA_ARMED,
+    RX_DMA_HELD,
+} rx_dma_state_t;
+
+typedef struct
+{
+    uint8_t          data[H4_RX_DMA_BUFFER_SIZE];
+    rx_dma_state_t   state;
+    uint16_t         length;
+    uint16_t         offset;        /* Bytes parsed so far */
+    uint32_t         error_mask;    /* Reception ended by a UART error after the last byte */
+} h4_rx_dma_buffer_t;
+
+static h4_rx_dma_buffer_t m_h4_rx_dma_buffers[H4_RX_DMA_BUFFER_COUNT];
+static uint8_t m_rx_arm_idx;                /* Next buffer to hand to the driver */
+static uint8_t m_rx_parse_idx;              /* Next buffer to parse */
+static volatile bool m_rx_flushing = false;
+static volatile bool m_rx_idle_pending = false;     /* Data received since the last idle flush */
+
+/* Jobs, highest priority first: events and data to the host, packets from the host to the
+   controller, the idle flush of reception, and the transport's timers. */
+typedef enum
+{
+    M_JOB_TX,
+    M_JOB_RX,
+    M_JOB_RX_IDLE,
+    M_JOB_TRANSPORT_POLL,
+    M_JOB_COUNT
+} m_job_id_t;
+
+#if HCI_JOB_SWI
+#define M_JOB_LEVEL JOB_LEVEL_SWI
+#else
+#define M_JOB_LEVEL JOB_LEVEL_THREAD
+#endif
+
+static volatile bool m_transport_poll_pending = false;  /* The transport has timers running */
+static volatile bool m_acl_stall_pending = false;       /* Reception waits on queued ACL data */
+
+/* Time the controller signalled the host while the transport was idle, for LATENCY_WAKE_TO_TX.
+   Compare IDLE_SLEEP 0 and 1 to see what sleeping costs. */
+static volatile uint32_t m_host_signal_time;    /* 0 when not measuring */
+
+/* Last command received from the host, for LATENCY_CMD_TO_EVT. Written by the transport
+   interrupt, read by the main loop with it disabled. */
+static uint16_t m_cmd_opcode;
+static uint32_t m_cmd_rx_time;                  /* 0 when not measuring */
+
+/* TX buffer ring. A buffer is owned by the main loop while not ready, and by the transport
+   interrupt while ready. */
+typedef struct
+{
+    uint8_t          data[H4_TX_BATCH_BUFFER_SIZE];
+    uint32_t         length;
+    uint32_t         evt_times[H4_TX_BATCH_MAX_PACKETS];    /* When each event was fetched */
+    uint8_t          evt_count;
+    volatile bool    ready;
+} h4_tx_buffer_t;
+
+static h4_tx_buffer_t m_h4_tx_buffers[H4_TX_BUFFER_COUNT];
+static uint8_t m_tx_fill_idx;               /* Next buffer to fill, main loop only */
+static uint8_t m_tx_send_idx;               /* Next buffer to send, transport interrupt only */
+static volatile bool m_tx_in_flight = false;
+static uint32_t m_tx_start_time;
+
+/* Scheduler queues towards the host, with counters for tuning the weights. */
+typedef enum
+{
+    SCHED_QUEUE_EVT,
+    SCHED_QUEUE_ACL,
+    SCHED_QUEUE_COUNT
+} sched_queue_id_t;
+
+typedef struct
+{
+    int32_t  quantum;
+    int32_t  deficit;
+    uint32_t packets;
+    uint32_t bytes;
+    uint32_t priority_packets;    /* Sent ahead of the scheduler, events only */
+    uint32_t empty_polls;
+} sched_queue_t;
+
+static sched_queue_t m_sched_queues[SCHED_QUEUE_COUNT] =
+    {
+        [SCHED_QUEUE_EVT] = {.quantum = H4_SCHED_QUANTUM * H4_SCHED_EVT_WEIGHT,
+                             .deficit = H4_SCHED_QUANTUM * H4_SCHED_EVT_WEIGHT},
+        [SCHED_QUEUE_ACL] = {.quantum = H4_SCHED_QUANTUM * H4_SCHED_ACL_WEIGHT},
+    };
+static sched_queue_id_t m_sched_current = SCHED_QUEUE_EVT;
+
+static uint8_t  m_evt_lookahead[M_H4_TX_BUFFER_SIZE];
+static uint32_t m_evt_lookahead_length;
+static uint32_t m_evt_lookahead_time;
+static uint32_t m_evt_taken_time;       /* Fetch time of the event last returned for sending */
+
+/* Command Complete of a locally handled command, sent ahead of the controller events. Only
+   one is held, a further local command waits until it has been sent. */
+static uint8_t  m_local_evt[M_H4_TX_BUFFER_SIZE];
+static uint32_t m_local_evt_length;
+static uint32_t m_local_evt_time;
+
+#define M_ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+
+#if HCI_LOCAL_FAST_PATH
+/* Return parameters of read-only information commands, status included, kept from the
+   controller's first successful Command Complete. They do not change at run time, except for
+   the address, which vendor specific commands may set, so the cache is emptied whenever one is
+   passed to the controller. */
+typedef struct
+{
+    uint16_t  opcode;
+    uint8_t   size;             /* Return parameters expected */
+    uint8_t   length;           /* Return parameters held, 0 until the controller has answered */
+    uint8_t * p_params;
+} local_cache_entry_t;
+
+static uint8_t m_cache_local_version[9];
+static uint8_t m_cache_local_commands[65];
+static uint8_t m_cache_local_features[9];
+static uint8_t m_cache_bd_addr[7];
+static uint8_t m_cache_le_buffer_size[4];
+static uint8_t m_cache_le_local_features[9];
+
+#define M_LOCAL_CACHE_ENTRY(op, buffer) {.opcode = (op), .size = sizeof(buffer), .p_params = (buffer)}
+
+static local_cache_entry_t m_local_cache[] =
+    {
+        M_LOCAL_CACHE_ENTRY(HCI_OPCODE_READ_LOCAL_VERSION, m_cache_local_version),
+        M_LOCAL_CACHE_ENTRY(HCI_OPCODE_READ_LOCAL_COMMANDS, m_cache_local_commands),
+        M_LOCAL_CACHE_ENTRY(HCI_OPCODE_READ_LOCAL_FEATURES, m_cache_local_features),
+        M_LOCAL_CACHE_ENTRY(HCI_OPCODE_READ_BD_ADDR, m_cache_bd_addr),
+        M_LOCAL_CACHE_ENTRY(HCI_OPCODE_LE_READ_BUFFER_SIZE, m_cache_le_buffer_size),
+        M_LOCAL_CACHE_ENTRY(HCI_OPCODE_LE_READ_LOCAL_FEATURES, m_cache_le_local_features),
+    };
+#endif
+
+/* Host to controller flow control counters. */
+typedef struct
+{
+    uint32_t acl_blocked;       /* Times an ACL packet was rejected and held */
+    uint32_t acl_retries;       /* Further rejections of a held packet */
+    uint32_t cmd_dropped;       /* Commands rejected by the controller */
+} backpressure_stats_t;
+
+static backpressure_stats_t m_backpressure_stats;
+
+/* Transport counters, read with the Statistics Read vendor command. Packets to the host are
+   counted by the scheduler queues. Updated by the transport interrupt. */
+typedef enum
+{
+    UART_ERROR_OVERRUN,
+    UART_ERROR_PARITY,
+    UART_ERROR_FRAMING,
+    UART_ERROR_BREAK,
+    UART_ERROR_COUNT
+} uart_error_cause_t;
+
+typedef struct
+{
+    uint32_t rx_cmd_packets;
+    uint32_t rx_cmd_bytes;
+    uint32_t rx_acl_packets;
+    uint32_t rx_acl_bytes;
+    uint32_t rx_dropped;                        /* Broken off by a UART error or a resync */
+    uint32_t rx_resyncs;
+    uint32_t rx_discarded_bytes;                /* Skipped while resynchronising */
+    uint32_t uart_errors[UART_ERROR_COUNT];
+    uint64_t tx_busy_cycles;
+    uint64_t tx_idle_cycles;                    /* Gaps longer than the DWT counter period are undercounted */
+    uint32_t handler_calls;                     /* Of m_transport_event_handler */
+    uint32_t handler_cycles;
+    uint32_t handler_max_cycles;
+    uint32_t rx_unsupported_packets;            /* SCO and ISO data, which the controller does not take */
+    uint32_t driver_errors;                     /* Transfers the transport's driver refused */
+} transport_stats_t;
+
+static transport_stats_t m_transport_stats;
+
+/* Resynchronisation of the H4 stream from the host. After a UART error, an unknown packet
+   type or an implausible header, bytes are discarded one at a time until the start of a
+   plausible packet is found. A vendor specific event then reports what was lost. */
+typedef struct
+{
+    uint8_t  cause;         /* Of the first resync since the last report */
+    uint8_t  error_mask;    /* UART errors since the last report */
+    uint16_t count;         /* Resyncs since the last report */
+    uint32_t discarded;     /* Bytes discarded since the last report */
+} rx_resync_report_t;
+
+static rx_resync_report_t m_rx_resync_report;       /* Written by the transport interrupt */
+static volatile bool m_rx_resync_report_pending = false;
+static uint32_t m_tx_state_cycles;              /* When the transport last started or finished sending */
+
+/* Profiles to configure the controller with, the stored one or the one selected with the
+   Profile Select vendor command before the controller is enabled. */
+#define M_PROFILE(masters, slaves, tx_buffers, rx_buffers)                                \
+    {.master_count = M_MASTER_LINKS(masters), .slave_count = M_SLAVE_LINKS(slaves),       \
+     .tx_count = (tx_buffers), .rx_count = (rx_buffers),                                  \
+     .tx_size = M_LINK_TX_SIZE, .rx_size = M_LINK_RX_SIZE}
+
+static const link_profile_t m_link_profiles[] =
+    {
+        M_PROFILE(MASTER_COUNT, SLAVE_COUNT, TX_COUNT, RX_COUNT),
+        M_PROFILE(PROFILE_MANY_MASTER_COUNT, PROFILE_MANY_SLAVE_COUNT, PROFILE_MANY_TX_COUNT, PROFILE_MANY_RX_COUNT),
+        M_PROFILE(M_FAST_MASTER_COUNT, M_FAST_SLAVE_COUNT, PROFILE_FAST_TX_COUNT, PROFILE_FAST_RX_COUNT),
+    };
+
+#define M_PROFILE_CUSTOM 0xFF
+
+/* The controller's memory and the ACL queues are carved from m_profile_pool when the
+   controller is enabled at boot, and again when Profile Select changes the profile before
+   the host has sent the controller anything. */
+static uint8_t m_profile_pool[PROFILE_POOL_SIZE] __attribute__((aligned(M_POOL_ALIGN)));
+static link_profile_t m_profile;
+static uint8_t m_profile_index;         /* In m_link_profiles, or M_PROFILE_CUSTOM */
+static bool m_controller_enabled = false;
+static bool m_profile_fixed = false;    /* A packet from the host has reached the controller */
+
+/* Transport to the host, see transport.h */
+static transport_t const * const m_p_transport = &HCI_TRANSPORT;
+
+/* MPSL clock config */
+static mpsl_clock_lfclk_cfg_t clock_config =
+    {
+        .source = MPSL_CLOCK_LF_SRC_XTAL,
+        .rc_ctiv = 0,
+        .rc_temp_ctiv = 0,
+        .accuracy_ppm = 250,
+        .skip_wait_lfclk_started = false,
+};
+
+/* Fault handler */
+__NO_RETURN void m_fault_handler(const char *file, const uint32_t line)
+{
+    static uint8_t assert_event[100];
+
+    assert_event[0] = H4_UART_HCI_EVENT_PACKET;
+    assert_event[1] = 0xFF; /* Vendor specific */
+    /* size */
+    assert_event[3] = 0xAA; /* Vendor specific ASSERT */
+
+    (void)snprintf((char *)&assert_event[4], sizeof(assert_event) - 4, "Line: %04d, File: %s", line, file);
+    int size = strlen((const char *)&assert_event[4]);
+
+    assert_event[2] = size + 1; /* Length of HCI packet */
+
+    m_p_transport->panic_tx(assert_event, size + 4);
+
+    while (1)
+        ;
+}
+
+
+/* Get length */
+static uint16_t * m_p_to_acl_data_length_get(uint8_t const * p_h4_buf)
+{
+    return (uint16_t*)&p_h4_buf[H4_UART_HEADER_SIZE + 2];
+}
+
+static uint8_t * m_p_to_event_length_get(uint8_t const * p_h4_buf)
+{
+    return (uint8_t*)&p_h4_buf[H4_UART_HEADER_SIZE + 1];
+}
+
+static uint8_t * m_uint32_encode(uint8_t * p_buf, uint32_t value)
+{
+    p_buf[0] = (uint8_t)value;
+    p_buf[1] = (uint8_t)(value >> 8);
+    p_buf[2] = (uint8_t)(value >> 16);
+    p_buf[3] = (uint8_t)(value >> 24);
+    return &p_buf[4];
+}
+
+static uint32_t m_data_to_host_get(uint8_t * p_h4_buf)
+{
+    const uint8_t acl_packet_header_size = 2;
+    const uint8_t acl_packet_len_size = 2;
+    uint32_t packet_length = 0;
+
+    if (m_controller_enabled && sdc_hci_data_get(&p_h4_buf[H4_UART_HEADER_SIZE]) == 0)
+    {
+        p_h4_buf[0] = (uint8_t)H4_UART_HCI_ACL_DATA_PACKET;
+        packet_length = H4_UART_HEADER_SIZE + acl_packet_header_size + acl_packet_len_size + *m_p_to_acl_data_length_get(p_h4_buf);
+    }
+
+    return packet_length;
+}
+
+static uint32_t m_evt_to_host_get(uint8_t * p_h4_buf)
+{
+    const uint8_t evt_packet_header_size = 1;
+    const uint8_t evt_packet_len_size = 1;
+    uint32_t packet_length = 0;
+
+    if (m_controller_enabled && sdc_hci_evt_get(&p_h4_buf[H4_UART_HEADER_SIZE]) == 0)
+    {
+        p_h4_buf[0] = (uint8_t)H4_UART_HCI_EVENT_PACKET;
+        packet_length = H4_UART_HEADER_SIZE + evt_packet_header_size + evt_packet_len_size + *m_p_to_event_length_get(p_h4_buf);
+    }
+
+    return packet_length;
+
+}
+
+/* Opcode of a Command Complete or Command Status event, 0 for other events. */
+static uint16_t m_evt_cmd_opcode_get(uint8_t const * p_h4_buf)
+{
+    uint8_t const * p_params = &p_h4_buf[H4_UART_HEADER_SIZE + 2];
+
+    switch (p_h4_buf[H4_UART_HEADER_SIZE])
+    {
+    case HCI_EVT_COMMAND_COMPLETE:
+        return (uint16_t)(p_params[1] | (p_params[2] << 8));
+    case HCI_EVT_COMMAND_STATUS:
+        return (uint16_t)(p_params[2] | (p_params[3] << 8));
+    default:
+        return 0;
+    }
+}
+
+/* Drop the queued ACL data of a link that has been disconnected. */
+static void m_acl_evt_check(uint8_t const * p_h4_buf);
+
+static void m_cmd_to_evt_latency_record(uint8_t const * p_h4_buf)
+{
+    uint16_t opcode = m_evt_cmd_opcode_get(p_h4_buf);
+
+    if (opcode == 0)
+    {
+        return;
+    }
+
+    m_p_transport->irq_disable();
+    if (m_cmd_rx_time != 0 && m_cmd_opcode == opcode)
+    {
+        latency_record(LATENCY_CMD_TO_EVT, m_cmd_rx_time);
+        m_cmd_rx_time = 0;
+    }
+    m_p_transport->irq_enable();
+}
+
+#if HCI_LOCAL_FAST_PATH
+static local_cache_entry_t * m_local_cache_find(uint16_t opcode)
+{
+    for (uint8_t i = 0; i < M_ARRAY_SIZE(m_local_cache); i++)
+    {
+        if (m_local_cache[i].opcode == opcode)
+        {
+            return &m_local_cache[i];
+        }
+    }
+    return NULL;
+}
+
+/* Keep the return parameters of a successful Command Complete for a cached command. */
+static void m_local_cache_store(uint8_t const * p_h4_buf)
+{
+    uint8_t const *       p_params = &p_h4_buf[H4_UART_HEADER_SIZE + 2];
+    local_cache_entry_t * p_entry;
+    uint8_t               length;
+
+    if (p_h4_buf[H4_UART_HEADER_SIZE] != HCI_EVT_COMMAND_COMPLETE)
+    {
+        return;
+    }
+
+    /* Parameters: Num_HCI_Command_Packets, opcode, then the return parameters. */
+    p_entry = m_local_cache_find(m_evt_cmd_opcode_get(p_h4_buf));
+    length = (uint8_t)(p_h4_buf[H4_UART_HEADER_SIZE + 1] - 3);
+    if (p_entry != NULL && p_entry->length == 0 && length == p_entry->size &&
+        p_params[3] == HCI_STATUS_SUCCESS)
+    {
+        memcpy(p_entry->p_params, &p_params[3], length);
+        p_entry->length = length;
+    }
+}
+
+static void m_local_cache_clear(void)
+{
+    for (uint8_t i = 0; i < M_ARRAY_SIZE(m_local_cache); i++)
+    {
+        m_local_cache[i].length = 0;
+    }
+}
+#endif
+
+static bool m_evt_is_priority(uint8_t const * p_h4_buf)
+{
+    uint8_t evt_code = p_h4_buf[H4_UART_HEADER_SIZE];
+
+    return (evt_code == HCI_EVT_COMMAND_COMPLETE) ||
+           (evt_code == HCI_EVT_COMMAND_STATUS) ||
+           (evt_code == HCI_EVT_NUMBER_OF_COMPLETED_PACKETS);
+}
+
+/* Move the event in the lookahead buffer to the TX buffer. */
+static uint32_t m_evt_lookahead_take(uint8_t * p_h4_buf)
+{
+    uint32_t length = m_evt_lookahead_length;
+
+    memcpy(p_h4_buf, m_evt_lookahead, length);
+    m_evt_taken_time = m_evt_lookahead_time;
+    m_evt_lookahead_length = 0;
+    return length;
+}
+
+static uint32_t m_sched_queue_get(sched_queue_id_t id, uint8_t * p_h4_buf)
+{
+    if (id == SCHED_QUEUE_EVT)
+    {
+        return (m_evt_lookahead_length != 0) ? m_evt_lookahead_take(p_h4_buf) : 0;
+    }
+    return m_data_to_host_get(p_h4_buf);
+}
+
+static void m_sched_next_queue(void)
+{
+    m_sched_current = (m_sched_current == SCHED_QUEUE_EVT) ? SCHED_QUEUE_ACL : SCHED_QUEUE_EVT;
+    m_sched_queues[m_sched_current].deficit += m_sched_queues[m_sched_current].quantum;
+}
+
+/* Build the vendor specific event reporting resyncs of the stream from the host:
+   subevent, cause of the first resync, UART errors, resync count, bytes discarded. */
+static uint32_t m_rx_resync_event_get(uint8_t * p_h4_buf)
+{
+    rx_resync_report_t report;
+
+    m_p_transport->irq_disable();
+    report = m_rx_resync_report;
+    memset(&m_rx_resync_report, 0, sizeof(m_rx_resync_report));
+    m_rx_resync_report_pending = false;
+    m_p_transport->irq_enable();
+
+    p_h4_buf[0] = H4_UART_HCI_EVENT_PACKET;
+    p_h4_buf[1] = HCI_EVT_VENDOR_SPECIFIC;
+    p_h4_buf[2] = 9;
+    p_h4_buf[3] = HCI_VS_SUBEVENT_H4_RESYNC;
+    p_h4_buf[4] = report.cause;
+    p_h4_buf[5] = report.error_mask;
+    p_h4_buf[6] = (uint8_t)report.count;
+    p_h4_buf[7] = (uint8_t)(report.count >> 8);
+    (void)m_uint32_encode(&p_h4_buf[8], report.discarded);
+    return 12;
+}
+
+/* Pick the next packet to the host. Events and ACL data share the link by deficit round
+   robin: a queue keeps its turn while it has deficit left, and each packet is charged its
+   length. An empty queue gives its turn away at once and loses its deficit, so no slot is
+   wasted. Both queues get a turn, so neither can starve the other, which matters when the
+   time between connection events only allows one packet to be fetched.
+
+   The event at the head of the controller queue is fetched ahead into m_evt_lookahead. If it
+   is a Command Complete, Command Status or Number Of Completed Packets event it is sent
+   straight away and not charged, so flow control credits go back to the host without
+   waiting behind ACL data. The Command Complete of a local command goes first of all. */
+static uint32_t m_evt_or_data_to_host_get(uint8_t * p_h4_buf)
+{
+    if (m_local_evt_length != 0)
+    {
+        sched_queue_t * p_queue = &m_sched_queues[SCHED_QUEUE_EVT];
+        uint32_t        length = m_local_evt_length;
+
+        memcpy(p_h4_buf, m_local_evt, length);
+        m_evt_taken_time = m_local_evt_time;
+        m_local_evt_length = 0;
+        /* The next command may be waiting for m_local_evt. */
+        job_post(M_JOB_RX);
+
+        p_queue->priority_packets++;
+        p_queue->packets++;
+        p_queue->bytes += length;
+        return length;
+    }
+
+    if (m_rx_resync_report_pending)
+    {
+        sched_queue_t * p_queue = &m_sched_queues[SCHED_QUEUE_EVT];
+        uint32_t        length = m_rx_resync_event_get(p_h4_buf);
+
+        m_evt_taken_time = latency_now();
+
+        p_queue->priority_packets++;
+        p_queue->packets++;
+        p_queue->bytes += length;
+        return length;
+    }
+
+    if (m_evt_lookahead_length == 0)
+    {
+        m_evt_lookahead_length = m_evt_to_host_get(m_evt_lookahead);
+        if (m_evt_lookahead_length != 0)
+        {
+            m_evt_lookahead_time = latency_now();
+            m_cmd_to_evt_latency_record(m_evt_lookahead);
+            m_acl_evt_check(m_evt_lookahead);
+#if HCI_LOCAL_FAST_PATH
+            m_local_cache_store(m_evt_lookahead);
+#endif
+        }
+    }
+
+    if (m_evt_lookahead_length != 0 && m_evt_is_priority(m_evt_lookahead))
+    {
+        sched_queue_t * p_queue = &m_sched_queues[SCHED_QUEUE_EVT];
+        uint32_t        length = m_evt_lookahead_take(p_h4_buf);
+
+        p_queue->priority_packets++;
+        p_queue->packets++;
+        p_queue->bytes += length;
+        return length;
+    }
+
+    for (uint8_t i = 0; i < SCHED_QUEUE_COUNT; i++)
+    {
+        sched_queue_t * p_queue = &m_sched_queues[m_sched_current];
+        uint32_t        length = m_sched_queue_get(m_sched_current, p_h4_buf);
+
+        if (length != 0)
+        {
+            p_queue->packets++;
+            p_queue->bytes += length;
+            p_queue->deficit -= (int32_t)length;
+            if (p_queue->deficit <= 0)
+            {
+                m_sched_next_queue();
+            }
+            return length;
+        }
+
+        p_queue->empty_polls++;
+        p_queue->deficit = 0;
+        m_sched_next_queue();
+    }
+
+    return 0;
+}
+
+/* Frame as many packets as possible back-to-back in the TX buffer. The batch is closed when
+   a maximum size packet might not fit any more, when both controller queues are empty, or
+   after H4_TX_BATCH_MAX_PACKETS packets. */
+static uint32_t m_tx_batch_fill(h4_tx_buffer_t * p_buffer)
+{
+    uint32_t batch_length = 0;
+    uint32_t packet_count = 0;
+
+    p_buffer->evt_count = 0;
+
+    while ((packet_count < H4_TX_BATCH_MAX_PACKETS) &&
+           (batch_length + M_H4_TX_BUFFER_SIZE <= H4_TX_BATCH_BUFFER_SIZE))
+    {
+        uint8_t * p_packet = &p_buffer->data[batch_length];
+        uint32_t  packet_length = m_evt_or_data_to_host_get(p_packet);
+
+        if (packet_length == 0)
+        {
+            break;
+        }
+
+        if (p_packet[0] == H4_UART_HCI_EVENT_PACKET)
+        {
+            p_buffer->evt_times[p_buffer->evt_count++] = m_evt_taken_time;
+        }
+        hci_trace_record(HCI_TRACE_TO_HOST, p_packet, (uint16_t)packet_length);
+
+        batch_length += packet_length;
+        packet_count++;
+    }
+
+    return batch_length;
+}
+
+/* Start sending the next ready buffer, unless a transfer is ongoing. Called from the transport
+   interrupt, or from the main loop with the transport interrupt disabled. */
+RAMFUNC static void m_tx_start_next(void)
+{
+    h4_tx_buffer_t * p_buffer = &m_h4_tx_buffers[m_tx_send_idx];
+
+    if (!m_tx_in_flight && p_buffer->ready)
+    {
+        m_tx_in_flight = true;
+
+        if (m_host_signal_time != 0)
+        {
+            latency_record(LATENCY_WAKE_TO_TX, m_host_signal_time);
+            m_host_signal_time = 0;
+        }
+        for (uint8_t i = 0; i < p_buffer->evt_count; i++)
+        {
+            latency_record(LATENCY_EVT_TO_TX, p_buffer->evt_times[i]);
+        }
+        m_tx_start_time = latency_now();
+
+        uint32_t now = DWT->CYCCNT;
+        m_transport_stats.tx_idle_cycles += now - m_tx_state_cycles;
+        m_tx_state_cycles = now;
+
+        m_p_transport->tx(p_buffer->data, p_buffer->length);
+    }
+}
+
+RAMFUNC static void m_on_tx_done(void)
+{
+    uint32_t now = DWT->CYCCNT;
+
+    latency_record(LATENCY_TX_DURATION, m_tx_start_time);
+    m_transport_stats.tx_busy_cycles += now - m_tx_state_cycles;
+    m_tx_state_cycles = now;
+
+    m_h4_tx_buffers[m_tx_send_idx].ready = false;
+    m_tx_send_idx = (m_tx_send_idx + 1) % H4_TX_BUFFER_COUNT;
+    m_tx_in_flight = false;
+
+    m_tx_start_next();
+}
+
+static void m_try_send_evt_or_data_to_host(void)
+{
+    /* Fill every free buffer while the transport is busy with the previous ones. */
+    while (!m_h4_tx_buffers[m_tx_fill_idx].ready)
+    {
+        h4_tx_buffer_t * p_buffer = &m_h4_tx_buffers[m_tx_fill_idx];
+
+        p_buffer->length = m_tx_batch_fill(p_buffer);
+        if (p_buffer->length == 0)
+        {
+            break;
+        }
+
+        m_tx_fill_idx = (m_tx_fill_idx + 1) % H4_TX_BUFFER_COUNT;
+
+        m_p_transport->irq_disable();
+        p_buffer->ready = true;
+        m_tx_start_next();
+        m_p_transport->irq_enable();
+    }
+}
+
+
+/* Parser of the stream from the host, see h4_parser.h. SCO and ISO data are framed so that
+   they do not throw the stream out of step, but the controller takes neither, so they are
+   counted and dropped. Packets go into pool buffers of their size. */
+static h4_parser_t        m_rx_parser;
+static h4_parser_config_t m_rx_parser_config;
+
+RAMFUNC static uint8_t * m_rx_packet_alloc(void * p_context, uint16_t length)
+{
+    uint8_t * p_packet = rx_pool_alloc(length);
+
+    (void)p_context;
+    if (p_packet == NULL)
+    {
+        /* Let the receive job see whether stalled ACL data holds the buffers. */
+        job_post(M_JOB_RX);
+    }
+    return p_packet;
+}
+
+static void m_rx_packet_drop(void * p_context, uint8_t * p_packet)
+{
+    (void)p_context;
+    rx_pool_free(p_packet);
+}
+
+RAMFUNC static void m_rx_packet_end(void * p_context, uint8_t * p_packet, uint16_t length)
+{
+    (void)p_context;
+
+    hci_trace_record(HCI_TRACE_FROM_HOST, p_packet, length);
+
+    switch (p_packet[0])
+    {
+    case H4_UART_HCI_COMMAND_PACKET:
+        m_cmd_opcode = (uint16_t)(p_packet[1] | (p_packet[2] << 8));
+        m_cmd_rx_time = latency_now();
+        m_transport_stats.rx_cmd_packets++;
+        m_transport_stats.rx_cmd_bytes += length;
+        rx_pool_enqueue(RX_POOL_QUEUE_CMD, p_packet);
+        job_post(M_JOB_RX);
+        break;
+    case H4_UART_HCI_ACL_DATA_PACKET:
+        m_transport_stats.rx_acl_packets++;
+        m_transport_stats.rx_acl_bytes += length;
+        rx_pool_enqueue(RX_POOL_QUEUE_ACL, p_packet);
+        job_post(M_JOB_RX);
+        break;
+    default:
+        m_transport_stats.rx_unsupported_packets++;
+        rx_pool_free(p_packet);
+        break;
+    }
+}
+
+/* Check a header for values no valid packet has: a command group that does not exist, a
+   handle above 0x0EFF, ACL data with broadcast flags or longer than the controller takes.
+   The controller would reject such ACL data for good, and it would then be held forever.
+   Packets too long for any pool buffer are caught by the parser. */
+RAMFUNC static bool m_rx_header_check(void * p_context, uint8_t const * p_header)
+{
+    uint16_t handle_flags = (uint16_t)(p_header[1] | (p_header[2] << 8));
+    uint8_t  ogf = p_header[2] >> 2;
+
+    (void)p_context;
+
+    switch (p_header[0])
+    {
+    case H4_UART_HCI_COMMAND_PACKET:
+        /* Link Control to Testing, LE Controller, and vendor specific. 0x07 is not assigned. */
+        return (ogf >= 0x01 && ogf <= 0x06) || (ogf == 0x08) || (ogf == HCI_OGF_VENDOR_SPECIFIC);
+    case H4_UART_HCI_ACL_DATA_PACKET:
+        return ((handle_flags & 0x0FFF) <= 0x0EFF) && ((handle_flags & 0xC000) == 0) &&
+               (*m_p_to_acl_data_length_get(p_header) <= HCI_DATA_MAX_SIZE);
+    default:
+        return (handle_flags & 0x0FFF) <= 0x0EFF;
+    }
+}
+
+/* Resyncs are reported to the host with a vendor specific event, see m_rx_resync_event_get.
+   The causes are numbered as in the event. */
+static void m_rx_parser_evt(void * p_context, h4_parser_evt_t const * p_evt)
+{
+    (void)p_context;
+
+    switch (p_evt->type)
+    {
+    case H4_PARSER_EVT_RESYNC:
+        if (m_rx_resync_report.count == 0)
+        {
+            m_rx_resync_report.cause = (uint8_t)p_evt->cause;
+        }
+        m_rx_resync_report.count++;
+        m_transport_stats.rx_resyncs++;
+        break;
+    case H4_PARSER_EVT_RESYNCED:
+        m_rx_resync_report_pending = true;
+        job_post(M_JOB_TX);
+        break;
+    case H4_PARSER_EVT_DISCARDED:
+        m_rx_resync_report.discarded += p_evt->count;
+        m_transport_stats.rx_discarded_bytes += p_evt->count;
+        break;
+    case H4_PARSER_EVT_DROPPED:
+        m_transport_stats.rx_dropped++;
+        break;
+    }
+}
+
+static void m_rx_parser_init(void)
+{
+    m_rx_parser_config.types = H4_PARSER_TYPE_MASK(H4_PARSER_TYPE_COMMAND) | H4_PARSER_TYPE_MASK(H4_PARSER_TYPE_ACL) |
+                               H4_PARSER_TYPE_MASK(H4_PARSER_TYPE_SCO) | H4_PARSER_TYPE_MASK(H4_PARSER_TYPE_ISO);
+    m_rx_parser_config.max_length = RX_POOL_LARGE_SIZE;
+    m_rx_parser_config.idle_fill = m_p_transport->rx_idle_fill;
+    m_rx_parser_config.header_check = m_rx_header_check;
+    m_rx_parser_config.alloc = m_rx_packet_alloc;
+    m_rx_parser_config.free = m_rx_packet_drop;
+    m_rx_parser_config.packet = m_rx_packet_end;
+    m_rx_parser_config.evt = m_rx_parser_evt;
+    h4_parser_init(&m_rx_parser, &m_rx_parser_config);
+}
+
+RAMFUNC static bool m_rx_armed(void)
+{
+    for (uint8_t i = 0; i < H4_RX_DMA_BUFFER_COUNT; i++)
+    {
+        if (m_h4_rx_dma_buffers[i].state == RX_DMA_ARMED)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Hand free DMA buffers to the driver, in ring order. The second one is chained to the first
+   with the ENDRX->STARTRX short. */
+RAMFUNC static void m_rx_arm(void)
+{
+    if (m_rx_flushing && !m_rx_armed())
+    {
+        /* Every buffer has ended, so there is nothing left for the abort to end. */
+        m_rx_flushing = false;
+    }
+
+    while (!m_rx_flushing && m_h4_rx_dma_buffers[m_rx_arm_idx].state == RX_DMA_FREE)
+    {
+        h4_rx_dma_buffer_t * p_buffer = &m_h4_rx_dma_buffers[m_rx_arm_idx];
+
+        p_buffer->state = RX_DMA_ARMED;
+        m_rx_arm_idx = (m_rx_arm_idx + 1) % H4_RX_DMA_BUFFER_COUNT;
+        m_p_transport->rx_arm(p_buffer->data, H4_RX_DMA_BUFFER_SIZE);
+    }
+}
+
+/* Parse received DMA buffers in order, freeing each one that has been fully consumed, then
+   re-arm. A buffer is held while no pool buffer is free, and once both are held the transport
+   stops receiving and flow control holds off the host. Called from the transport interrupt, or
+   with it disabled. */
+RAMFUNC static void m_rx_resume(void)
+{
+    /* A header at the very end of a DMA buffer leaves the parser waiting for a pool buffer
+       with no DMA buffer held. */
+    if (m_h4_rx_dma_buffers[m_rx_parse_idx].state != RX_DMA_HELD && h4_parser_buffer_wait(&m_rx_parser))
+    {
+        (void)h4_parser_feed(&m_rx_parser, NULL, 0);
+    }
+
+    while (m_h4_rx_dma_buffers[m_rx_parse_idx].state == RX_DMA_HELD)
+    {
+        h4_rx_dma_buffer_t * p_buffer = &m_h4_rx_dma_buffers[m_rx_parse_idx];
+
+        p_buffer->offset += h4_parser_feed(&m_rx_parser, &p_buffer->data[p_buffer->offset],
+                                           p_buffer->length - p_buffer->offset);
+        if (p_buffer->offset < p_buffer->length)
+        {
+            break;
+        }
+
+        if (p_buffer->error_mask != 0)
+        {
+            /* Bytes after the last one were lost, so the packet being received is broken. */
+            m_rx_resync_report.error_mask |= (uint8_t)p_buffer->error_mask;
+            h4_parser_resync(&m_rx_parser);
+            p_buffer->error_mask = 0;
+        }
+
+        p_buffer->state = RX_DMA_FREE;
+        m_rx_parse_idx = (m_rx_parse_idx + 1) % H4_RX_DMA_BUFFER_COUNT;
+    }
+
+    m_rx_arm();
+}
+
+/* A DMA buffer has ended. A UART error also ends it, with error_mask set. */
+RAMFUNC static void m_on_rx_done(uint8_t const * p_data, size_t bytes, uint32_t error_mask)
+{
+    uint8_t              index = (p_data == m_h4_rx_dma_buffers[0].data) ? 0 : 1;
+    h4_rx_dma_buffer_t * p_buffer = &m_h4_rx_dma_buffers[index];
+
+    if (p_buffer->state != RX_DMA_ARMED)
+    {
+        /* An error while no buffer was armed refers to a buffer that has already ended. */
+        return;
+    }
+
+    p_buffer->state = RX_DMA_HELD;
+    p_buffer->length = bytes;
+    p_buffer->offset = 0;
+    p_buffer->error_mask = error_mask;
+
+    if (bytes < H4_RX_DMA_BUFFER_SIZE || error_mask != 0)
+    {
+        /* Reception was stopped to flush a partly filled buffer, or by an error. The transport
+           has dropped the chained buffer, so it is armed again next. */
+        uint8_t next = (index + 1) % H4_RX_DMA_BUFFER_COUNT;
+
+        if (m_h4_rx_dma_buffers[next].state == RX_DMA_ARMED)
+        {
+            m_h4_rx_dma_buffers[next].state = RX_DMA_FREE;
+        }
+        m_rx_arm_idx = next;
+        m_rx_flushing = false;
+    }
+
+    m_rx_resume();
+}
+
+/* Flush a partly filled DMA buffer once the line has been idle. There is no event for that,
+   so the transport is polled and reception is stopped after H4_RX_IDLE_TIMEOUT_US without
+   data. */
+static void m_rx_idle_check(void)
+{
+    static uint32_t last_activity;
+
+    if (m_p_transport->rx_activity_get())
+    {
+        last_activity = DWT->CYCCNT;
+        m_rx_idle_pending = true;
+    }
+    else if (m_rx_idle_pending && (DWT->CYCCNT - last_activity) >= M_H4_RX_IDLE_TIMEOUT_CYCLES)
+    {
+        m_rx_idle_pending = false;
+
+        m_p_transport->irq_disable();
+        if (!m_rx_flushing && m_rx_armed())
+        {
+            m_rx_flushing = true;
+            m_p_transport->rx_flush();
+        }
+        m_p_transport->irq_enable();
+    }
+}
+
+/* Start a Command Complete event in m_local_evt. Returns where the return parameters go,
+   m_local_evt_complete sets the length once they are written. */
+static uint8_t * m_local_command_complete_begin(uint16_t opcode)
+{
+    m_local_evt[0] = H4_UART_HCI_EVENT_PACKET;
+    m_local_evt[1] = HCI_EVT_COMMAND_COMPLETE;
+    m_local_evt[3] = 1; /* Num_HCI_Command_Packets */
+    m_local_evt[4] = (uint8_t)opcode;
+    m_local_evt[5] = (uint8_t)(opcode >> 8);
+    return &m_local_evt[6];
+}
+
+static void m_local_command_complete_end(uint8_t const * p_end)
+{
+    m_local_evt_length = (uint32_t)(p_end - m_local_evt);
+    m_local_evt[2] = (uint8_t)(m_local_evt_length - 3);
+    m_local_evt_time = latency_now();
+    m_cmd_to_evt_latency_record(m_local_evt);
+    job_post(M_JOB_TX);
+}
+
+/* Read a latency histogram. Parameters: histogram (latency_id_t), flags (bit 0 clears it).
+   Return parameters: status, histogram, count, max us, total us, bucket count, buckets. */
+static uint8_t * m_vs_latency_read(uint8_t const * p_params, uint8_t length, uint8_t * p_out)
+{
+#if LATENCY_STATS
+    latency_hist_t hist;
+
+    if (length < 2 || p_params[0] >= LATENCY_COUNT)
+    {
+        *p_out++ = HCI_STATUS_INVALID_PARAMETERS;
+        return p_out;
+    }
+
+    m_p_transport->irq_disable();
+    latency_read((latency_id_t)p_params[0], &hist, (p_params[1] & 0x01) != 0);
+    m_p_transport->irq_enable();
+
+    *p_out++ = HCI_STATUS_SUCCESS;
+    *p_out++ = p_params[0];
+    p_out = m_uint32_encode(p_out, hist.count);
+    p_out = m_uint32_encode(p_out, hist.max_us);
+    p_out = m_uint32_encode(p_out, hist.total_us);
+    *p_out++ = LATENCY_BUCKET_COUNT;
+    for (uint8_t i = 0; i < LATENCY_BUCKET_COUNT; i++)
+    {
+        p_out = m_uint32_encode(p_out, hist.buckets[i]);
+    }
+#else
+    (void)p_params;
+    (void)length;
+    *p_out++ = HCI_STATUS_UNKNOWN_COMMAND;
+#endif
+    return p_out;
+}
+
+static uint32_t m_cycles_to_us(uint64_t cycles)
+{
+    return (uint32_t)(cycles / (SystemCoreClock / 1000000));
+}
+
+/* Read the transport counters. Parameters: flags (bit 0 clears them). Return parameters:
+   status, layout version, then 32-bit counters:
+   RX command packets, RX command bytes, RX ACL packets, RX ACL bytes,
+   TX event packets, TX event bytes, TX ACL packets, TX ACL bytes,
+   RX packets dropped, UART overrun, parity, framing and break errors,
+   RX buffer high-water, TX busy us, TX idle us,
+   ACL blocked by the controller, ACL retries, commands dropped by the controller,
+   RX resyncs, RX bytes discarded,
+   transport event handler calls, total and maximum handler cycles,
+   SCO and ISO packets dropped, transport driver errors. */
+static uint8_t * m_vs_statistics_read(uint8_t const * p_params, uint8_t length, uint8_t * p_out)
+{
+    transport_stats_t    transport;
+    backpressure_stats_t backpressure = m_backpressure_stats;
+    sched_queue_t        evt = m_sched_queues[SCHED_QUEUE_EVT];
+    sched_queue_t        acl = m_sched_queues[SCHED_QUEUE_ACL];
+    bool                 reset = (length >= 1) && ((p_params[0] & 0x01) != 0);
+    uint8_t              high_water;
+
+    m_p_transport->irq_disable();
+    transport = m_transport_stats;
+    high_water = rx_pool_high_water_get(reset);
+    if (reset)
+    {
+        memset(&m_transport_stats, 0, sizeof(m_transport_stats));
+    }
+    m_p_transport->irq_enable();
+
+    if (reset)
+    {
+        memset(&m_backpressure_stats, 0, sizeof(m_backpressure_stats));
+        for (uint8_t i = 0; i < SCHED_QUEUE_COUNT; i++)
+        {
+            m_sched_queues[i].packets = 0;
+            m_sched_queues[i].bytes = 0;
+            m_sched_queues[i].priority_packets = 0;
+            m_sched_queues[i].empty_polls = 0;
+        }
+    }
 
-/*lint -emacro(506, BLE_REQUIRED_MEMORY) Constant value Boolean */
-#define BLE_REQUIRED_MEMORY SDC_MEM_REQUIRED_MAX(MASTER_COUNT, \
-                                                 SLAVE_COUNT,  \
-                                                 TX_SIZE,      \
-                                                 RX_SIZE,      \
-                                                 TX_COUNT,     \
-                                                 RX_COUNT)
+    *p_out++ = HCI_STATUS_SUCCESS;
+    *p_out++ = HCI_VS_STATISTICS_VERSION;
+    p_out = m_uint32_encode(p_out, transport.rx_cmd_packets);
+    p_out = m_uint32_encode(p_out, transport.rx_cmd_bytes);
+    p_out = m_uint32_encode(p_out, transport.rx_acl_packets);
+    p_out = m_uint32_encode(p_out, transport.rx_acl_bytes);
+    p_out = m_uint32_encode(p_out, evt.packets);
+    p_out = m_uint32_encode(p_out, evt.bytes);
+    p_out = m_uint32_encode(p_out, acl.packets);
+    p_out = m_uint32_encode(p_out, acl.bytes);
+    p_out = m_uint32_encode(p_out, transport.rx_dropped);
+    for (uint8_t i = 0; i < UART_ERROR_COUNT; i++)
+    {
+        p_out = m_uint32_encode(p_out, transport.uart_errors[i]);
+    }
+    p_out = m_uint32_encode(p_out, high_water);
+    p_out = m_uint32_encode(p_out, m_cycles_to_us(transport.tx_busy_cycles));
+    p_out = m_uint32_encode(p_out, m_cycles_to_us(transport.tx_idle_cycles));
+    p_out = m_uint32_encode(p_out, backpressure.acl_blocked);
+    p_out = m_uint32_encode(p_out, backpressure.acl_retries);
+    p_out = m_uint32_encode(p_out, backpressure.cmd_dropped);
+    p_out = m_uint32_encode(p_out, transport.rx_resyncs);
+    p_out = m_uint32_encode(p_out, transport.rx_discarded_bytes);
+    p_out = m_uint32_encode(p_out, transport.handler_calls);
+    p_out = m_uint32_encode(p_out, transport.handler_cycles);
+    p_out = m_uint32_encode(p_out, transport.handler_max_cycles);
+    p_out = m_uint32_encode(p_out, transport.rx_unsupported_packets);
+    p_out = m_uint32_encode(p_out, transport.driver_errors);
+    return p_out;
+}
 
-/* HCI message packet element definition */
-typedef uint8_t hci_element_t;
+/* Read the random number pool levels and counters. Parameters: flags (bit 0 clears the
+   counters). Return parameters: status, RNG running, then for the PRIO_HIGH and the PRIO_LOW
+   pool its fill level and target as bytes and bytes taken, requests refused and RNG restarts
+   as 32-bit counters, then RNG values and RNG stops. */
+static uint8_t * m_vs_rand_statistics_read(uint8_t const * p_params, uint8_t length, uint8_t * p_out)
+{
+    rand_stats_t stats;
 
-#define M_DEFAULT_DEVICE_ADDRESS    {0x56, 0xFF, 0x99, 0x00, 0xCD, 0x29} // The default public address
+    rand_stats_get(&stats, (length >= 1) && ((p_params[0] & 0x01) != 0));
 
-/* The UART header is 1 byte */
-#define H4_UART_HEADER_SIZE 1
-#define M_H4_RX_BUFFER_SIZE (H4_UART_HEADER_SIZE + HCI_MSG_BUFFER_MAX_SIZE)
-#define M_H4_TX_BUFFER_SIZE (H4_UART_HEADER_SIZE + HCI_MSG_BUFFER_MAX_SIZE)
+    *p_out++ = HCI_STATUS_SUCCESS;
+    *p_out++ = stats.rng_running ? 1 : 0;
+    for (uint8_t i = 0; i < RAND_PRIO_COUNT; i++)
+    {
+        *p_out++ = stats.pools[i].count;
+        *p_out++ = stats.pools[i].target;
+        p_out = m_uint32_encode(p_out, stats.pools[i].bytes);
+        p_out = m_uint32_encode(p_out, stats.pools[i].misses);
+        p_out = m_uint32_encode(p_out, stats.pools[i].refills);
+    }
+    p_out = m_uint32_encode(p_out, stats.rng_values);
+    p_out = m_uint32_encode(p_out, stats.rng_stops);
+    return p_out;
+}
 
-/* Receive states */
-typedef enum
+#if HCI_LOCAL_FAST_PATH
+/* LE Rand from the PRIO_LOW pool, or from the controller if the pool is short. */
+static uint8_t * m_le_rand(uint8_t const * p_params, uint8_t length, uint8_t * p_out)
 {
-    STATE_RECV_H4_HEADER = 0,
-    STATE_RECV_ACL_DATA_HEADER = 1,
-    STATE_RECV_CMD_HEADER = 2,
-    STATE_RECV_PACKET_CONTENT,
-} recv_state_t;
+    (void)p_params;
+    (void)length;
 
-static recv_state_t m_recv_state;
+    if (rand_vector_get(&p_out[1], 8) == 0)
+    {
+        return NULL;
+    }
+    p_out[0] = HCI_STATUS_SUCCESS;
+    return &p_out[9];
+}
+#endif
 
-/* The H4 packet types. */
-typedef enum
+/* Read HCI trace records, oldest first. Parameters: sequence number of the first record
+   wanted. Return parameters: status, trace clock in Hz, sequence number of the first record
+   returned (later than the one asked for if that has been overwritten), of the record after
+   the last one returned, to ask for next, and the record count, then the records: DWT cycle
+   count (32 bits), packet length (16 bits), direction (0 from the host, 1 to the host),
+   captured length, and the first bytes of the packet. Records go in as long as they fit. */
+static uint8_t * m_vs_trace_read(uint8_t const * p_params, uint8_t length, uint8_t * p_out)
 {
-    H4_UART_HCI_COMMAND_PACKET = 0x01,
-    H4_UART_HCI_ACL_DATA_PACKET = 0x02,
-    H4_UART_HCI_SYNCHRONOUS_DATA_PACKET = 0x03,
-    H4_UART_HCI_EVENT_PACKET = 0x04
-} h4_uart_pkt_type_t;
+#if HCI_TRACE
+    uint8_t const * p_end = p_out + HCI_CMD_COMPLETE_RETURN_MAX_SIZE;
+    uint32_t        next = hci_trace_next_get();
+    uint32_t        seq;
+    uint8_t *       p_seq;
+    uint8_t *       p_count;
+    uint8_t         count = 0;
+
+    if (length < 4)
+    {
+        *p_out++ = HCI_STATUS_INVALID_PARAMETERS;
+        return p_out;
+    }
+
+    seq = (uint32_t)(p_params[0] | (p_params[1] << 8) | (p_params[2] << 16) | ((uint32_t)p_params[3] << 24));
+    if (next - seq > HCI_TRACE_COUNT)
+    {
+        seq = next - HCI_TRACE_COUNT;
+    }
 
-/* Buffers for sending and receiving */
-static uint8_t m_h4_rx_buffer[M_H4_RX_BUFFER_SIZE];
-static uint8_t m_h4_tx_buffer[M_H4_TX_BUFFER_SIZE];
+    *p_out++ = HCI_STATUS_SUCCESS;
+    p_out = m_uint32_encode(p_out, SystemCoreClock);
+    p_seq = p_out;
+    p_out += 8;
+    p_count = p_out++;
 
-static volatile bool m_tx_buffer_available = true;
+    /* The vendor command and its Command Complete are traced as well, so the reader catches
+       up by one chunk at a time. */
+    for (; seq != next; seq++)
+    {
+        hci_trace_record_t record;
 
-static uint8_t m_sdc_dynamic_mem[BLE_REQUIRED_MEMORY];
+        if (!hci_trace_read(seq, &record))
+        {
+            if (count == 0 && next - seq >= HCI_TRACE_COUNT)
+            {
+                /* Overwritten while being read. */
+                continue;
+            }
+            break;
+        }
+        if (p_out + 8 + record.captured > p_end)
+        {
+            break;
+        }
+        if (count == 0)
+        {
+            (void)m_uint32_encode(p_seq, seq);
+        }
 
-/* Make UART instance and define config */
-static nrfx_uarte_t uarte_instance = {.p_reg = NRF_UARTE0};
+        p_out = m_uint32_encode(p_out, record.time);
+        *p_out++ = (uint8_t)record.length;
+        *p_out++ = (uint8_t)(record.length >> 8);
+        *p_out++ = record.dir;
+        *p_out++ = record.captured;
+        memcpy(p_out, record.data, record.captured);
+        p_out += record.captured;
+        count++;
+    }
 
-static nrfx_uarte_config_t uarte_config =
+    if (count == 0)
     {
-        .pselrts = 5,
-        .pseltxd = 6,
-        .pselcts = 7,
-        .pselrxd = 8,
-        .p_context = NULL,
-        .baudrate = NRF_UARTE_BAUDRATE_1000000,
-        .interrupt_priority = 2,
-        .hal_cfg = {
-            .hwfc = NRF_UARTE_HWFC_ENABLED,
-            .parity = NRF_UARTE_PARITY_EXCLUDED,
-#if defined(UARTE_CONFIG_STOP_Msk)
-            .stop = NRF_UARTE_STOP_ONE,
+        (void)m_uint32_encode(p_seq, seq);
+    }
+    (void)m_uint32_encode(p_seq + 4, seq);
+    *p_count = count;
+#else
+    (void)p_params;
+    (void)length;
+    *p_out++ = HCI_STATUS_UNKNOWN_COMMAND;
 #endif
-        },
-};
+    return p_out;
+}
 
-/* MPSL clock config */
-static mpsl_clock_lfclk_cfg_t clock_config =
+/* Read the per link ACL queue statistics. Parameters: flags (bit 0 clears the counters).
+   Return parameters: status and link count, then for each link its handle (16 bits, 0xFFFF
+   if never bound), packets queued now and most packets queued at once as bytes, then
+   packets passed to the controller, rejections by the controller, packets refused as invalid
+   or dropped on disconnection or stall, and total and maximum wait in microseconds as 32-bit values, and
+   last the packets dropped for a handle with no connection as a 32-bit value. Links beyond
+   what fits in a Command Complete are left out. */
+static uint8_t * m_vs_acl_statistics_read(uint8_t const * p_params, uint8_t length, uint8_t * p_out)
+{
+    acl_queue_stats_t stats[(HCI_CMD_COMPLETE_RETURN_MAX_SIZE - 6) / 24];
+    uint32_t          unbound;
+    uint8_t           count;
+
+    count = acl_queue_stats_get(stats, M_ARRAY_SIZE(stats), &unbound,
+                                (length >= 1) && ((p_params[0] & 0x01) != 0));
+
+    *p_out++ = HCI_STATUS_SUCCESS;
+    *p_out++ = count;
+    for (uint8_t i = 0; i < count; i++)
     {
-        .source = MPSL_CLOCK_LF_SRC_XTAL,
-        .rc_ctiv = 0,
-        .rc_temp_ctiv = 0,
-        .accuracy_ppm = 250,
-        .skip_wait_lfclk_started = false,
-};
+        *p_out++ = (uint8_t)stats[i].handle;
+        *p_out++ = (uint8_t)(stats[i].handle >> 8);
+        *p_out++ = stats[i].depth;
+        *p_out++ = stats[i].depth_max;
+        p_out = m_uint32_encode(p_out, stats[i].packets);
+        p_out = m_uint32_encode(p_out, stats[i].rejections);
+        p_out = m_uint32_encode(p_out, stats[i].dropped);
+        p_out = m_uint32_encode(p_out, m_cycles_to_us(stats[i].wait_total));
+        p_out = m_uint32_encode(p_out, m_cycles_to_us(stats[i].wait_max));
+    }
+    p_out = m_uint32_encode(p_out, unbound);
+    return p_out;
+}
 
-/* Fault handler */
-__NO_RETURN void m_fault_handler(const char *file, const uint32_t line)
+/* Read the job statistics. Parameters: flags (bit 0 clears the counters). Return parameters:
+   status and job count, then for each job in priority order its runs, and its total and
+   longest run and longest delay from post to start in microseconds, as 32-bit values. */
+static uint8_t * m_vs_job_statistics_read(uint8_t const * p_params, uint8_t length, uint8_t * p_out)
 {
-    nrfx_uarte_config_t *p_uarte_config;
-    static uint8_t assert_event[100];
+    bool reset = (length >= 1) && ((p_params[0] & 0x01) != 0);
 
-    assert_event[0] = H4_UART_HCI_EVENT_PACKET;
-    assert_event[1] = 0xFF; /* Vendor specific */
-    /* size */
-    assert_event[3] = 0xAA; /* Vendor specific ASSERT */
+    *p_out++ = HCI_STATUS_SUCCESS;
+    *p_out++ = M_JOB_COUNT;
+    for (uint8_t i = 0; i < M_JOB_COUNT; i++)
+    {
+        job_stats_t stats;
 
-    (void)snprintf((char *)&assert_event[4], sizeof(assert_event) - 4, "Line: %04d, File: %s", line, file);
-    int size = strlen((const char *)&assert_event[4]);
+        job_stats_get(i, &stats, reset);
+        p_out = m_uint32_encode(p_out, stats.runs);
+        p_out = m_uint32_encode(p_out, m_cycles_to_us(stats.cycles));
+        p_out = m_uint32_encode(p_out, m_cycles_to_us(stats.max_cycles));
+        p_out = m_uint32_encode(p_out, m_cycles_to_us(stats.max_delay_cycles));
+    }
+    return p_out;
+}
 
-    assert_event[2] = size + 1; /* Length of HCI packet */
+/* Called from the MPSL low priority interrupt, see below. */
+static void host_event_interrupt(void);
 
-    /* Re-initialize UART to be used in blocking mode. */
-    nrfx_uarte_uninit(&uarte_instance);
+/* Configure the controller with a profile and enable it, with its memory and the ACL queues
+   carved from m_profile_pool. Returns an HCI status, and leaves the controller disabled if
+   the profile is not valid, does not fit in the pool or the controller fails to enable. */
+static uint8_t m_controller_enable(link_profile_t const * p_profile, uint8_t index)
+{
+    sdc_cfg_t resource_cfg;
+    int32_t   bytes_needed;
+    size_t    acl_offset;
+    uint16_t  acl_count = M_ACL_LINK_COUNT(p_profile->master_count, p_profile->slave_count);
+    int32_t   retcode;
 
-    p_uarte_config = &uarte_config;
-    (void)nrfx_uarte_init(&uarte_instance, p_uarte_config, NULL);
+    if (!link_profile_valid(p_profile) || acl_count > UINT8_MAX)
+    {
+        return HCI_STATUS_INVALID_PARAMETERS;
+    }
 
-    (void)nrfx_uarte_tx(&uarte_instance, (const uint8_t *)assert_event, size + 4);
+    resource_cfg.buffer_cfg.tx_packet_count = p_profile->tx_count;
+    resource_cfg.buffer_cfg.rx_packet_count = p_profile->rx_count;
+    resource_cfg.buffer_cfg.tx_packet_size  = p_profile->tx_size;
+    resource_cfg.buffer_cfg.rx_packet_size  = p_profile->rx_size;
+    bytes_needed = sdc_cfg_set(SDC_DEFAULT_RESOURCE_CFG_TAG,
+                               SDC_CFG_TYPE_BUFFER_CFG,
+                               &resource_cfg);
 
-    while (1)
-        ;
-}
+    /* Roles that are compiled out are set to no links too, the controller default is one. */
+    if (bytes_needed >= 0)
+    {
+        resource_cfg.master_count.count = p_profile->master_count;
+        bytes_needed = sdc_cfg_set(SDC_DEFAULT_RESOURCE_CFG_TAG,
+                                   SDC_CFG_TYPE_MASTER_COUNT,
+                                   &resource_cfg);
+    }
+    if (bytes_needed >= 0)
+    {
+        resource_cfg.slave_count.count = p_profile->slave_count;
+        bytes_needed = sdc_cfg_set(SDC_DEFAULT_RESOURCE_CFG_TAG,
+                                   SDC_CFG_TYPE_SLAVE_COUNT,
+                                   &resource_cfg);
+    }
+    if (bytes_needed < 0)
+    {
+        return HCI_STATUS_INVALID_PARAMETERS;
+    }
 
+    /* The last call returns the memory needed by the whole configuration. */
+    acl_offset = M_POOL_ROUND((size_t)bytes_needed);
+    if (acl_offset + acl_count * sizeof(acl_queue_link_t) > sizeof(m_profile_pool))
+    {
+        return HCI_STATUS_MEMORY_CAPACITY_EXCEEDED;
+    }
 
-/* Get length */
-static uint16_t * m_p_to_acl_data_length_get(uint8_t const * p_h4_buf)
-{
-    return (uint16_t*)&p_h4_buf[H4_UART_HEADER_SIZE + 2];
-}
+    retcode = sdc_enable(host_event_interrupt, m_profile_pool);
+    if (retcode < 0)
+    {
+        return HCI_STATUS_HARDWARE_FAILURE;
+    }
 
-static uint8_t * m_p_to_event_length_get(uint8_t const * p_h4_buf)
-{
-    return (uint8_t*)&p_h4_buf[H4_UART_HEADER_SIZE + 1];
+    acl_queue_init((acl_queue_link_t *)&m_profile_pool[acl_offset], (uint8_t)acl_count);
+    m_profile = *p_profile;
+    m_profile_index = index;
+    m_controller_enabled = true;
+    return HCI_STATUS_SUCCESS;
 }
 
-static uint8_t * m_p_to_cmd_length_get(uint8_t const * p_h4_buf)
+/* Enable the controller at boot with the stored profile, or with profile 0 if the stored
+   one does not fit. */
+static void m_controller_enable_stored(void)
 {
-    return (uint8_t*)&p_h4_buf[H4_UART_HEADER_SIZE + 2];
+    uint32_t stored = NRF_UICR->CUSTOMER[PROFILE_UICR_CUSTOMER];
+
+    if (stored >= M_ARRAY_SIZE(m_link_profiles) ||
+        m_controller_enable(&m_link_profiles[stored], (uint8_t)stored) != HCI_STATUS_SUCCESS)
+    {
+        M_FAULT_CHECK(m_controller_enable(&m_link_profiles[0], 0) == HCI_STATUS_SUCCESS);
+    }
 }
 
-static uint32_t m_data_to_host_get(void)
+/* Enable the controller again with another profile, or with the one it had if that is not
+   possible, and return the status of the former. Only if the controller cannot be enabled
+   again at all does it stop, as it would be of no use to the host. The RNG interrupt is
+   held off meanwhile, as the DRBG encrypts with the controller's ECB. */
+static uint8_t m_controller_reenable(link_profile_t const * p_profile, uint8_t index)
 {
-    const uint8_t acl_packet_header_size = 2;
-    const uint8_t acl_packet_len_size = 2;
-    uint32_t packet_length = 0;
+    link_profile_t previous = m_profile;
+    uint8_t        previous_index = m_profile_index;
+    uint8_t        status;
 
-    if (sdc_hci_data_get(&m_h4_tx_buffer[H4_UART_HEADER_SIZE]) == 0)
+    NVIC_DisableIRQ(RNG_IRQn);
+    (void)sdc_disable();
+    m_controller_enabled = false;
+
+    status = m_controller_enable(p_profile, index);
+    if (status != HCI_STATUS_SUCCESS)
     {
-        m_h4_tx_buffer[0] = (uint8_t)H4_UART_HCI_ACL_DATA_PACKET;
-        packet_length = H4_UART_HEADER_SIZE + acl_packet_header_size + acl_packet_len_size + *m_p_to_acl_data_length_get(m_h4_tx_buffer);
+        M_FAULT_CHECK(m_controller_enable(&previous, previous_index) == HCI_STATUS_SUCCESS);
     }
+    NVIC_EnableIRQ(RNG_IRQn);
 
-    return packet_length;
+    return status;
 }
 
-static uint32_t m_evt_to_host_get(void)
+/* Select the profile the controller is enabled with, which is only possible before the host
+   has sent it anything, so as the first command after power on. Parameters: an index into
+   m_link_profiles, or 0xFF followed by master and slave link count, TX and RX buffer count
+   and TX and RX buffer size for a profile of its own. Return parameters: status. */
+static uint8_t * m_vs_profile_select(uint8_t const * p_params, uint8_t length, uint8_t * p_out)
 {
-    const uint8_t evt_packet_header_size = 1;
-    const uint8_t evt_packet_len_size = 1;
-    uint32_t packet_length = 0;
+    uint8_t status = HCI_STATUS_INVALID_PARAMETERS;
 
-    if (sdc_hci_evt_get(&m_h4_tx_buffer[H4_UART_HEADER_SIZE]) == 0)
+    if (m_profile_fixed)
     {
-        m_h4_tx_buffer[0] = (uint8_t)H4_UART_HCI_EVENT_PACKET;
-        packet_length = H4_UART_HEADER_SIZE + evt_packet_header_size + evt_packet_len_size + *m_p_to_event_length_get(m_h4_tx_buffer);
+        status = HCI_STATUS_COMMAND_DISALLOWED;
+    }
+    else if (length >= 1 && p_params[0] < M_ARRAY_SIZE(m_link_profiles))
+    {
+        status = m_controller_reenable(&m_link_profiles[p_params[0]], p_params[0]);
+    }
+    else if (length >= 7 && p_params[0] == M_PROFILE_CUSTOM)
+    {
+        link_profile_t profile =
+            {
+                .master_count = M_MASTER_LINKS(p_params[1]),
+                .slave_count = M_SLAVE_LINKS(p_params[2]),
+                .tx_count = p_params[3],
+                .rx_count = p_params[4],
+                .tx_size = p_params[5],
+                .rx_size = p_params[6],
+            };
+
+        status = m_controller_reenable(&profile, M_PROFILE_CUSTOM);
     }
 
-    return packet_length;
-
+    *p_out++ = status;
+    return p_out;
 }
 
-static void m_try_send_evt_or_data_to_host(void)
+static uint8_t * m_profile_encode(uint8_t * p_out, link_profile_t const * p_profile, uint32_t interval_us)
 {
-  /* Alternate priority between data & event. This needs to be done because there may be
-  a case where the Tx channel will work but the Rx channel will stall. This can happen in
-  a situation where the time between connection events is only that big where only one
-  dh_job() can run which will always be occupied to send a num_complete_event and the
-  data pkt get will starve. */
-    static bool last_packet_to_host_was_evt = false;
+    link_profile_size_t size;
+    uint32_t            pool_size;
+
+    link_profile_size(p_profile, interval_us, &size);
+    pool_size = M_POOL_ROUND(size.sdc_mem) +
+                M_ACL_LINK_COUNT(p_profile->master_count, p_profile->slave_count) * sizeof(acl_queue_link_t);
+
+    *p_out++ = p_profile->master_count;
+    *p_out++ = p_profile->slave_count;
+    *p_out++ = p_profile->tx_count;
+    *p_out++ = p_profile->rx_count;
+    *p_out++ = p_profile->tx_size;
+    *p_out++ = p_profile->rx_size;
+    p_out = m_uint32_encode(p_out, size.sdc_mem);
+    p_out = m_uint32_encode(p_out, pool_size);
+    p_out = m_uint32_encode(p_out, size.tx_kbps);
+    p_out = m_uint32_encode(p_out, size.rx_kbps);
+    return p_out;
+}
 
-    uint32_t length_to_host;
+/* Size up the profiles, to weigh throughput against memory. Parameters: connection interval
+   in units of 1.25 ms (16 bits, the shortest if 0 or left out). Return parameters: status,
+   the profile the controller is enabled with (0xFF for one of its own), the pool size
+   (32 bits) and the profile count, then for each built-in profile, and last for the enabled
+   one, master and slave link count, TX and RX buffer count and TX and RX buffer size as
+   bytes, followed by the controller memory, the pool memory and the estimated TX and RX
+   throughput of one link in kbit/s as 32-bit values. */
+static uint8_t * m_vs_profile_read(uint8_t const * p_params, uint8_t length, uint8_t * p_out)
+{
+    uint32_t interval_us = (length >= 2) ? (uint32_t)(p_params[0] | (p_params[1] << 8)) * 1250 : 0;
 
-    if (last_packet_to_host_was_evt)
+    *p_out++ = HCI_STATUS_SUCCESS;
+    *p_out++ = m_profile_index;
+    p_out = m_uint32_encode(p_out, sizeof(m_profile_pool));
+    *p_out++ = M_ARRAY_SIZE(m_link_profiles);
+    for (uint8_t i = 0; i < M_ARRAY_SIZE(m_link_profiles); i++)
     {
-        length_to_host = m_data_to_host_get();
-        last_packet_to_host_was_evt = false;
+        p_out = m_profile_encode(p_out, &m_link_profiles[i], interval_us);
     }
-    else
+    p_out = m_profile_encode(p_out, &m_profile, interval_us);
+    return p_out;
+}
+
+/* Commands handled by this application. A handler writes the return parameters and returns
+   their end, or returns NULL to pass the command to the controller after all. */
+typedef uint8_t * (*local_command_handler_t)(uint8_t const * p_params, uint8_t length, uint8_t * p_out);
+
+typedef struct
+{
+    uint16_t                opcode;
+    local_command_handler_t handler;
+} local_command_t;
+
+static const local_command_t m_local_commands[] =
+    {
+        {HCI_VS_OPCODE_LATENCY_READ, m_vs_latency_read},
+        {HCI_VS_OPCODE_STATISTICS_READ, m_vs_statistics_read},
+        {HCI_VS_OPCODE_RAND_STATISTICS_READ, m_vs_rand_statistics_read},
+        {HCI_VS_OPCODE_TRACE_READ, m_vs_trace_read},
+        {HCI_VS_OPCODE_ACL_STATISTICS_READ, m_vs_acl_statistics_read},
+        {HCI_VS_OPCODE_JOB_STATISTICS_READ, m_vs_job_statistics_read},
+        {HCI_VS_OPCODE_PROFILE_SELECT, m_vs_profile_select},
+        {HCI_VS_OPCODE_PROFILE_READ, m_vs_profile_read},
+#if HCI_LOCAL_FAST_PATH
+        {HCI_OPCODE_LE_RAND, m_le_rand},
+#endif
+    };
+
+/* Answer a command without passing it to the controller, from m_local_commands or from the
+   cache. Returns false if it has to go to the controller. */
+static bool m_local_command_handle(uint8_t const * p_cmd)
+{
+    uint16_t        opcode = (uint16_t)(p_cmd[0] | (p_cmd[1] << 8));
+    uint8_t const * p_params = &p_cmd[3];
+    uint8_t *       p_out = NULL;
+
+    for (uint8_t i = 0; i < M_ARRAY_SIZE(m_local_commands); i++)
     {
-        length_to_host = m_evt_to_host_get();
-        last_packet_to_host_was_evt = true;
+        if (m_local_commands[i].opcode == opcode)
+        {
+            p_out = m_local_command_complete_begin(opcode);
+            p_out = m_local_commands[i].handler(p_params, p_cmd[2], p_out);
+            break;
+        }
     }
 
-    if (length_to_host != 0)
+#if HCI_LOCAL_FAST_PATH
+    if (p_out == NULL)
     {
-        m_tx_buffer_available = false;
-        nrfx_uarte_tx(&uarte_instance, m_h4_tx_buffer, length_to_host);
+        local_cache_entry_t const * p_entry = m_local_cache_find(opcode);
+
+        if (p_entry != NULL && p_entry->length != 0)
+        {
+            p_out = m_local_command_complete_begin(opcode);
+            memcpy(p_out, p_entry->p_params, p_entry->length);
+            p_out += p_entry->length;
+        }
+        else if ((opcode >> 10) == HCI_OGF_VENDOR_SPECIFIC)
+        {
+            m_local_cache_clear();
+        }
     }
-}
+#endif
 
+    if (p_out == NULL)
+    {
+        return false;
+    }
 
-static void m_state_recv_h4_header_enter(void)
-{
-    nrfx_uarte_rx(&uarte_instance, &m_h4_rx_buffer[0], 1);
+    m_local_command_complete_end(p_out);
+    return true;
 }
 
-
-/* Receive data or command from host to controller */
-static void m_start_recv_h4_header_from_host(void)
+static void m_rx_packet_free(uint8_t * p_packet)
 {
-    nrfx_uarte_rx(&uarte_instance, &m_h4_rx_buffer[0], 1);
+    m_p_transport->irq_disable();
+    rx_pool_free(p_packet);
+    m_rx_resume();
+    m_p_transport->irq_enable();
 }
 
-static void m_on_packet_received_from_host(void)
+/* Look at an event from the controller for what it means to the ACL queues: a new connection
+   binds a link, a closed connection or a reset releases links, and completed packets free
+   controller buffers that held data may be waiting for. The host only sends data for a
+   connection once it has seen the event, which comes through here first. */
+static void m_acl_evt_check(uint8_t const * p_h4_buf)
 {
-    switch (m_h4_rx_buffer[0])
+    uint8_t const * p_params = &p_h4_buf[H4_UART_HEADER_SIZE + 2];
+
+    switch (p_h4_buf[H4_UART_HEADER_SIZE])
     {
-    case H4_UART_HCI_ACL_DATA_PACKET:
-        sdc_hci_data_put(&m_h4_rx_buffer[H4_UART_HEADER_SIZE]);
+    case HCI_EVT_LE_META:
+        /* Parameters: subevent, status, handle, ... */
+        if ((p_params[0] == HCI_LE_SUBEVT_CONNECTION_COMPLETE ||
+             p_params[0] == HCI_LE_SUBEVT_ENHANCED_CONNECTION_COMPLETE) &&
+            p_params[1] == HCI_STATUS_SUCCESS)
+        {
+            acl_queue_open((uint16_t)((p_params[2] | (p_params[3] << 8)) & 0x0FFF));
+        }
         break;
-    case H4_UART_HCI_COMMAND_PACKET:
-        sdc_hci_cmd_put(&m_h4_rx_buffer[H4_UART_HEADER_SIZE]);
+    case HCI_EVT_COMMAND_COMPLETE:
+        /* Parameters: command packets, opcode, status, ... */
+        if ((uint16_t)(p_params[1] | (p_params[2] << 8)) == HCI_OPCODE_RESET)
+        {
+            acl_queue_close_all(m_rx_packet_free);
+        }
+        break;
+    case HCI_EVT_DISCONNECTION_COMPLETE:
+        /* Parameters: status, handle, reason. */
+        if (p_params[0] == HCI_STATUS_SUCCESS)
+        {
+            acl_queue_close((uint16_t)((p_params[1] | (p_params[2] << 8)) & 0x0FFF), m_rx_packet_free);
+        }
+        break;
+    case HCI_EVT_NUMBER_OF_COMPLETED_PACKETS:
+        job_post(M_JOB_RX);
         break;
     default:
-        NRFX_ASSERT(false);
         break;
     }
 }
 
-static void m_continue_recv_packet_from_host(nrfx_uarte_xfer_evt_t const *p_transfer_evt)
+/* Only a lack of buffers is worth retrying: anything else the controller refuses, such as
+   data longer than its buffers, it would refuse again. */
+static acl_queue_put_result_t m_acl_put(uint8_t * p_packet, bool retry)
 {
-    recv_state_t next_state = STATE_RECV_H4_HEADER;
-    switch (m_recv_state)
+    int32_t err_code = sdc_hci_data_put(&p_packet[H4_UART_HEADER_SIZE]);
+
+    if (err_code == -NRF_ENOMEM)
     {
-    case STATE_RECV_H4_HEADER:
-        NRFX_ASSERT(p_transfer_evt->bytes == 1);
-        switch (m_h4_rx_buffer[0])
-        {
-        case H4_UART_HCI_ACL_DATA_PACKET:
-            next_state = STATE_RECV_ACL_DATA_HEADER;
-            break;
-        case H4_UART_HCI_COMMAND_PACKET:
-            next_state = STATE_RECV_CMD_HEADER;
-            break;
-        default:
-            NRFX_ASSERT(false);
-            break;
-        }
-        break;
-    case STATE_RECV_ACL_DATA_HEADER:
-        if (*m_p_to_acl_data_length_get(m_h4_rx_buffer) > 0)
+        if (retry)
         {
-            next_state = STATE_RECV_PACKET_CONTENT;
+            m_backpressure_stats.acl_retries++;
         }
         else
         {
-            m_on_packet_received_from_host();
-            next_state = STATE_RECV_H4_HEADER;
+            m_backpressure_stats.acl_blocked++;
         }
-        break;
-    case STATE_RECV_CMD_HEADER:
-        if (*m_p_to_cmd_length_get(m_h4_rx_buffer) > 0)
+        return ACL_QUEUE_PUT_FULL;
+    }
+
+    m_rx_packet_free(p_packet);
+    return (err_code == 0) ? ACL_QUEUE_PUT_TAKEN : ACL_QUEUE_PUT_DROPPED;
+}
+
+/* Pass received packets on to the controller, and recycle their buffers.
+
+   Commands are not held: the host may only send as many as the controller has announced
+   with Num_HCI_Command_Packets, so a rejected command is malformed and is dropped.
+
+   ACL data is sorted by connection handle into the queue of its link, and the links are
+   served round robin. Data the controller rejects, as the buffers of its link are full,
+   stays at the head of the link's queue and is retried on the next pass, normally woken by
+   the controller signalling Number Of Completed Packets, while the other links carry on.
+   Data it refuses for any other reason is dropped. The queued packets keep their pool
+   buffers, so reception stops once the pool runs out and hardware flow control holds off
+   the host instead of data being lost. Data for a handle the controller has not reported a
+   connection for is dropped at once, and that of a link that has stalled for
+   ACL_QUEUE_STALE_MS, so reception always starts again. While it is stopped with data
+   queued, the main loop keeps running this job to see to the latter.
+
+   A run passes at most H4_RX_JOB_BATCH packets on and posts itself again if there may be
+   more, so that the TX job does not wait for a whole burst. */
+static void m_try_put_packets_to_controller(void)
+{
+    uint8_t * p_packet;
+    uint8_t   budget = H4_RX_JOB_BATCH;
+    uint8_t   passed;
+
+    while (budget > 0 && (p_packet = rx_pool_peek(RX_POOL_QUEUE_CMD)) != NULL)
+    {
+        if (m_local_evt_length != 0)
         {
-            next_state = STATE_RECV_PACKET_CONTENT;
+            /* The previous local Command Complete has not been sent yet. */
+            break;
         }
-        else
+
+        if (!m_local_command_handle(&p_packet[H4_UART_HEADER_SIZE]))
         {
-            m_on_packet_received_from_host();
-            next_state = STATE_RECV_H4_HEADER;
+            m_profile_fixed = true;
+            if (sdc_hci_cmd_put(&p_packet[H4_UART_HEADER_SIZE]) != 0)
+            {
+                m_backpressure_stats.cmd_dropped++;
+            }
         }
-        break;
-    case STATE_RECV_PACKET_CONTENT:
-        m_on_packet_received_from_host();
-        next_state = STATE_RECV_H4_HEADER;
-        break;
-    default:
-        NRFX_ASSERT(false);
-        break;
+        rx_pool_dequeue(RX_POOL_QUEUE_CMD);
+        m_rx_packet_free(p_packet);
+        budget--;
     }
 
-    switch (next_state)
+    if (rx_pool_peek(RX_POOL_QUEUE_ACL) != NULL)
     {
-    case STATE_RECV_H4_HEADER:
-        m_start_recv_h4_header_from_host();
-        break;
-    case STATE_RECV_ACL_DATA_HEADER:
-        nrfx_uarte_rx(&uarte_instance, &m_h4_rx_buffer[H4_UART_HEADER_SIZE], 4);
-        break;
-    case STATE_RECV_CMD_HEADER:
-        nrfx_uarte_rx(&uarte_instance, &m_h4_rx_buffer[H4_UART_HEADER_SIZE], 3);
-        break;
-    case STATE_RECV_PACKET_CONTENT:
-        switch (m_h4_rx_buffer[0])
+        m_profile_fixed = true;
+    }
+
+    while ((p_packet = rx_pool_peek(RX_POOL_QUEUE_ACL)) != NULL)
+    {
+        rx_pool_dequeue(RX_POOL_QUEUE_ACL);
+        acl_queue_add(p_packet, DWT->CYCCNT, m_rx_packet_free);
+    }
+    acl_queue_expire(DWT->CYCCNT, (SystemCoreClock / 1000) * ACL_QUEUE_STALE_MS, m_rx_packet_free);
+    passed = acl_queue_service(m_acl_put, DWT->CYCCNT, budget);
+    budget -= passed;
+
+    if (budget == 0)
+    {
+        job_post(M_JOB_RX);
+    }
+
+    m_p_transport->irq_disable();
+    m_acl_stall_pending = acl_queue_pending() && h4_parser_buffer_wait(&m_rx_parser);
+    m_p_transport->irq_enable();
+}
+
+
+static void m_on_uart_error(transport_evt_t const * p_evt)
+{
+    static const uint32_t cause_masks[UART_ERROR_COUNT] =
         {
-        case H4_UART_HCI_ACL_DATA_PACKET:
-            nrfx_uarte_rx(&uarte_instance,
-                          &m_h4_rx_buffer[H4_UART_HEADER_SIZE + 4],
-                          *m_p_to_acl_data_length_get(m_h4_rx_buffer));
-            break;
-        case H4_UART_HCI_COMMAND_PACKET:
-            nrfx_uarte_rx(&uarte_instance,
-                          &m_h4_rx_buffer[H4_UART_HEADER_SIZE + 3],
-                          *m_p_to_cmd_length_get(m_h4_rx_buffer));
-            break;
-        default:
-            NRFX_ASSERT(false);
-            break;
+            [UART_ERROR_OVERRUN] = TRANSPORT_ERROR_OVERRUN,
+            [UART_ERROR_PARITY] = TRANSPORT_ERROR_PARITY,
+            [UART_ERROR_FRAMING] = TRANSPORT_ERROR_FRAMING,
+            [UART_ERROR_BREAK] = TRANSPORT_ERROR_BREAK,
+        };
+
+    for (uint8_t i = 0; i < UART_ERROR_COUNT; i++)
+    {
+        if (p_evt->error_mask & cause_masks[i])
+        {
+            m_transport_stats.uart_errors[i]++;
         }
-        break;
     }
 
-    m_recv_state = next_state;
+    /* The transport has stopped reception. Parse what came before the error, then resync. */
+    m_on_rx_done(p_evt->p_data, p_evt->bytes, p_evt->error_mask);
 }
 
-
-void nrfx_uarte_event_handler(nrfx_uarte_event_t const *p_event,
-                              void *p_context)
+/* Timed in cycles, to compare build profiles and RAMFUNC placement. */
+RAMFUNC static void m_transport_event_handler(transport_evt_t const * p_evt)
 {
-    switch (p_event->type)
+    uint32_t start = DWT->CYCCNT;
+    uint32_t cycles;
+
+    switch (p_evt->type)
     {
-    case NRFX_UARTE_EVT_TX_DONE:
-        m_tx_buffer_available = true;
+    case TRANSPORT_EVT_TX_DONE:
+        m_on_tx_done();
+        job_post(M_JOB_TX);
+        break;
+    case TRANSPORT_EVT_RX_DONE:
+        m_on_rx_done(p_evt->p_data, p_evt->bytes, 0);
+        job_post(M_JOB_RX_IDLE);
+        break;
+    case TRANSPORT_EVT_RX_ERROR:
+        m_on_uart_error(p_evt);
+        job_post(M_JOB_RX_IDLE);
         break;
-    case NRFX_UARTE_EVT_RX_DONE:
-        m_continue_recv_packet_from_host(&p_event->data.rxtx);
+    case TRANSPORT_EVT_RX_WAKE:
+        job_post(M_JOB_RX_IDLE);
         break;
-    case NRFX_UARTE_EVT_ERROR:
-        //m_fault_handler();
+    case TRANSPORT_EVT_DRIVER_ERROR:
+        m_transport_stats.driver_errors++;
         break;
     }
+    job_post(M_JOB_TRANSPORT_POLL);
+
+    cycles = DWT->CYCCNT - start;
+    m_transport_stats.handler_calls++;
+    m_transport_stats.handler_cycles += cycles;
+    if (cycles > m_transport_stats.handler_max_cycles)
+    {
+        m_transport_stats.handler_max_cycles = cycles;
+    }
+}
+
+static void m_transport_poll(void)
+{
+    m_transport_poll_pending = (m_p_transport->poll != NULL) && m_p_transport->poll();
 }
 
-static void sample_job(void)
+static const job_t m_jobs[M_JOB_COUNT] =
+    {
+        [M_JOB_TX] = {.handler = m_try_send_evt_or_data_to_host, .level = M_JOB_LEVEL},
+        [M_JOB_RX] = {.handler = m_try_put_packets_to_controller, .level = M_JOB_LEVEL},
+        [M_JOB_RX_IDLE] = {.handler = m_rx_idle_check, .level = M_JOB_LEVEL},
+        [M_JOB_TRANSPORT_POLL] = {.handler = m_transport_poll, .level = M_JOB_LEVEL},
+    };
+
+/* Wait for the next wake source. While received data may still be waiting for the idle
+   flush, or the transport has timers running, the loop does not sleep but posts the jobs
+   that poll them. */
+static void m_idle_wait(void)
 {
-    if (m_tx_buffer_available)
+#if IDLE_SLEEP
+    if (!m_rx_idle_pending && !m_transport_poll_pending && !m_acl_stall_pending)
+    {
+        /* Wake on the first byte from the host. */
+        m_p_transport->rx_wake_enable();
+
+        /* An interrupt between the check and WFE sets the event register, so WFE returns.
+           Any interrupt ends the wait, and the loop looks again. */
+        if (!job_pending())
+        {
+            __WFE();
+        }
+        return;
+    }
+#endif
+
+    job_post(M_JOB_RX_IDLE);
+    if (m_p_transport->poll != NULL)
     {
-        m_try_send_evt_or_data_to_host();
+        job_post(M_JOB_TRANSPORT_POLL);
+    }
+    if (m_acl_stall_pending)
+    {
+        /* Queued data that has stalled is dropped by the job to let reception go on. */
+        job_post(M_JOB_RX);
     }
 }
 
+/* Called from the MPSL low priority interrupt when the controller has events or data for
+   the host. */
 static void host_event_interrupt(void)
 {
-    /* Do nothing */
+    if (!m_tx_in_flight && m_host_signal_time == 0)
+    {
+        m_host_signal_time = latency_now();
+    }
+    job_post(M_JOB_TX);
+    /* Number Of Completed Packets frees controller buffers for held ACL data. */
+    job_post(M_JOB_RX);
 }
 
+/* Never called, see M_RAM_REPORT_SYMBOL. */
+__attribute__((used)) static void m_ram_report(void)
+{
+    M_RAM_REPORT_SYMBOL(profile_pool, PROFILE_POOL_SIZE);
+    M_RAM_REPORT_SYMBOL(profile_default, M_PROFILE_POOL_SIZE(MASTER_COUNT, SLAVE_COUNT, TX_COUNT, RX_COUNT));
+    M_RAM_REPORT_SYMBOL(profile_many, M_PROFILE_POOL_SIZE(PROFILE_MANY_MASTER_COUNT, PROFILE_MANY_SLAVE_COUNT,
+                                                          PROFILE_MANY_TX_COUNT, PROFILE_MANY_RX_COUNT));
+    M_RAM_REPORT_SYMBOL(profile_fast, M_PROFILE_POOL_SIZE(M_FAST_MASTER_COUNT, M_FAST_SLAVE_COUNT,
+                                                          PROFILE_FAST_TX_COUNT, PROFILE_FAST_RX_COUNT));
+    M_RAM_REPORT_SYMBOL(sdc_mem, BLE_REQUIRED_MEMORY);
+    M_RAM_REPORT_SYMBOL(master_links, M_MASTER_LINK_COUNT);
+    M_RAM_REPORT_SYMBOL(slave_links, M_SLAVE_LINK_COUNT);
+    M_RAM_REPORT_SYMBOL(master_link, SDC_MEM_PER_MASTER_LINK(M_LINK_TX_SIZE, M_LINK_RX_SIZE, TX_COUNT, RX_COUNT));
+    M_RAM_REPORT_SYMBOL(slave_link, SDC_MEM_PER_SLAVE_LINK(M_LINK_TX_SIZE, M_LINK_RX_SIZE, TX_COUNT, RX_COUNT));
+    M_RAM_REPORT_SYMBOL(master_shared, (M_MASTER_LINK_COUNT > 0) ? SDC_MEM_MASTER_LINKS_SHARED : 0);
+    M_RAM_REPORT_SYMBOL(slave_shared, (M_SLAVE_LINK_COUNT > 0) ? SDC_MEM_SLAVE_LINKS_SHARED : 0);
+    M_RAM_REPORT_SYMBOL(tx_count, TX_COUNT);
+    M_RAM_REPORT_SYMBOL(tx_size, M_LINK_TX_SIZE);
+    M_RAM_REPORT_SYMBOL(tx_buffer, M_SDC_MEM_PER_TX_BUFFER);
+    M_RAM_REPORT_SYMBOL(rx_count, RX_COUNT);
+    M_RAM_REPORT_SYMBOL(rx_size, M_LINK_RX_SIZE);
+    M_RAM_REPORT_SYMBOL(rx_buffer, M_SDC_MEM_PER_RX_BUFFER);
+}
 
 int main()
 {
@@ -410,8 +2128,22 @@ int main()
     NRFX_ASSERT(retcode == 0);
 #endif
 
+    /* The cycle counter times the RX idle flush and the latency histograms. */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    m_tx_state_cycles = DWT->CYCCNT;
+
+    hci_trace_init();
     rand_init();
 
+    /* Before the controller is enabled and can ask for random numbers, as taking them from
+       the PRIO_LOW pool masks interrupts by the priorities of SWI5 and the RNG. After
+       rand_init(), which sets the RNG to its driver default. */
+    NVIC_SetPriority(RADIO_IRQn,   SOC_CONFIG_PRIO_HIGH);
+    NVIC_SetPriority(RTC0_IRQn,    SOC_CONFIG_PRIO_HIGH);
+    NVIC_SetPriority(SWI5_IRQn,    SOC_CONFIG_PRIO_LOW);
+    NVIC_SetPriority(RNG_IRQn,     SOC_CONFIG_PRIO_LOW);
+
     sdc_rand_source_t rand_functions = {
         .rand_prio_low_get = rand_prio_low_vector_get,
         .rand_prio_high_get = rand_prio_high_vector_get,
@@ -420,67 +2152,33 @@ int main()
 
     retcode = sdc_rand_source_register(&rand_functions);
     NRFX_ASSERT(retcode == 0);
+    (void)retcode;      /* NRFX_ASSERT may be compiled out */
 
-    int32_t bytes_needed = sdc_cfg_set(SDC_DEFAULT_RESOURCE_CFG_TAG,
-                                       SDC_CFG_TYPE_NONE,
-                                       NULL);
+    /* Right after the RNG has started, long before the DRBG has collected its first seed. */
+    m_controller_enable_stored();
 
-    sdc_cfg_t resource_cfg;
-
-    resource_cfg.buffer_cfg.tx_packet_count = TX_COUNT;
-    resource_cfg.buffer_cfg.rx_packet_count = RX_COUNT;
-
-#ifndef INCLUDE_FEATURE_DLE
-    resource_cfg.buffer_cfg.tx_packet_size  = SDC_DEFAULT_TX_PACKET_SIZE;
-    resource_cfg.buffer_cfg.rx_packet_size  = SDC_DEFAULT_RX_PACKET_SIZE;
-#else
-    resource_cfg.buffer_cfg.tx_packet_size  = TX_SIZE;
-    resource_cfg.buffer_cfg.rx_packet_size  = RX_SIZE;
-#endif
-
-    bytes_needed += sdc_cfg_set(SDC_DEFAULT_RESOURCE_CFG_TAG,
-                                SDC_CFG_TYPE_BUFFER_CFG,
-                                &resource_cfg);
+    rx_pool_init();
+    job_init(m_jobs, M_JOB_COUNT, SWI4_EGU4_IRQn);
+    m_rx_parser_init();
 
-    NRFX_ASSERT(bytes_needed > 0);
-    NRFX_ASSERT(bytes_needed <= sizeof(m_sdc_dynamic_mem));
+    m_p_transport->open(m_transport_event_handler, SOC_CONFIG_PRIO_LOW + 1);
 
-#ifdef INCLUDE_FEATURE_MASTER_ROLE
-    resource_cfg.master_count.count = MASTER_COUNT;
-    bytes_needed = sdc_cfg_set(SDC_DEFAULT_RESOURCE_CFG_TAG,
-                               SDC_CFG_TYPE_MASTER_COUNT,
-                               &resource_cfg);
-    NRFX_ASSERT(bytes_needed > 0);
-    NRFX_ASSERT(bytes_needed <= sizeof(m_sdc_dynamic_mem));
+    m_rx_resume();
 
+#if HCI_JOB_SWI
+    NVIC_SetPriority(SWI4_EGU4_IRQn, SOC_CONFIG_PRIO_LOW + 2);
+    NVIC_EnableIRQ(SWI4_EGU4_IRQn);
 #endif
 
-    resource_cfg.slave_count.count = SLAVE_COUNT;
-    bytes_needed = sdc_cfg_set(SDC_DEFAULT_RESOURCE_CFG_TAG,
-                               SDC_CFG_TYPE_SLAVE_COUNT,
-                               &resource_cfg);
-    NRFX_ASSERT(bytes_needed > 0);
-    NRFX_ASSERT(bytes_needed <= sizeof(m_sdc_dynamic_mem));
-
-    retcode = sdc_enable(host_event_interrupt, m_sdc_dynamic_mem);
-    NRFX_ASSERT(retcode >= 0);
-
-    nrfx_uarte_uninit(&uarte_instance);
-
-    (void)nrfx_uarte_init(&uarte_instance, &uarte_config, nrfx_uarte_event_handler);
-
-    m_state_recv_h4_header_enter();
-
-
-    NVIC_SetPriority(RADIO_IRQn,   SOC_CONFIG_PRIO_HIGH);
-    NVIC_SetPriority(RTC0_IRQn,    SOC_CONFIG_PRIO_HIGH);
-    NVIC_SetPriority(SWI5_IRQn,    SOC_CONFIG_PRIO_LOW);
-    NVIC_SetPriority(RNG_IRQn,     SOC_CONFIG_PRIO_LOW);
-    NVIC_SetPriority(UARTE0_UART0_IRQn,   SOC_CONFIG_PRIO_LOW + 1);
+    for (uint8_t i = 0; i < M_JOB_COUNT; i++)
+    {
+        job_post(i);
+    }
 
     for(;;)
     {
-        sample_job();
+        job_run();
+        m_idle_wait();
     }
 
     return 0;
@@ -516,7 +2214,11 @@ void SWI5_IRQHandler(void)
     mpsl_low_priority_process();
 }
 
-void UARTE0_UART0_IRQHandler(void)
+#if HCI_JOB_SWI
+void SWI4_EGU4_IRQHandler(void)
 {
-    nrfx_uarte_0_irq_handler();
+    job_swi_process();
+    /* The jobs may have left something for the main loop to poll. */
+    __SEV();
 }
+#endif
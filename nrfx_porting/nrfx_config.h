@@ -13,6 +13,13 @@
 
 #define NRFX_UARTE_ENABLED 1
 #define NRFX_UARTE0_ENABLED 1
+/* SPIS1 is only built in with HCI_TRANSPORT=transport_spis, see CMakeLists.txt */
+#ifndef NRFX_SPIS_ENABLED
+#define NRFX_SPIS_ENABLED 0
+#endif
+#ifndef NRFX_SPIS1_ENABLED
+#define NRFX_SPIS1_ENABLED 0
+#endif
 #define NRFX_PRS_ENABLED 0
 #define NRFX_RNG_ENABLED 1
 #define INCLUDE_FEATURE_SLAVE_ROLE 1
@@ -0,0 +1,76 @@
+#writes the RAM report of an executable, run after linking with
+#cmake -DNM=<nm> -DEXECUTABLE=<file> -DREPORT=<file> -P ram_report.cmake
+#the controller memory comes from the ram_report_* symbols set by main.c, the rest from the
+#sizes of the variables in the executable, and the code size to compare build profiles
+
+execute_process(COMMAND ${NM} --print-size ${EXECUTABLE}
+                OUTPUT_VARIABLE NM_OUTPUT
+                RESULT_VARIABLE NM_RESULT)
+if(NOT NM_RESULT EQUAL 0)
+    message(WARNING "RAM report: ${NM} failed on ${EXECUTABLE}")
+    return()
+endif()
+
+string(REPLACE "\n" ";" NM_LINES "${NM_OUTPUT}")
+
+#variables in RAM smaller than this are summed up as one line
+set(SMALL_SIZE 64)
+
+set(SYMBOL_LINES "")
+set(RAM_TOTAL 0)
+set(RAM_SMALL 0)
+set(RAM_SMALL_COUNT 0)
+set(CODE_TOTAL 0)
+
+foreach(LINE IN LISTS NM_LINES)
+    if(LINE MATCHES "^([0-9a-fA-F]+) [aA] ram_report_([a-z_]+)$")
+        math(EXPR VALUE "0x${CMAKE_MATCH_1}")
+        set(SDC_${CMAKE_MATCH_2} ${VALUE})
+    elseif(LINE MATCHES "^[0-9a-fA-F]+ ([0-9a-fA-F]+) [tTrR] ")
+        math(EXPR CODE_TOTAL "${CODE_TOTAL} + 0x${CMAKE_MATCH_1}")
+    elseif(LINE MATCHES "^[0-9a-fA-F]+ ([0-9a-fA-F]+) [bBdD] (.+)$")
+        math(EXPR SIZE "0x${CMAKE_MATCH_1}")
+        set(NAME "${CMAKE_MATCH_2}")
+        math(EXPR RAM_TOTAL "${RAM_TOTAL} + ${SIZE}")
+        if(SIZE LESS SMALL_SIZE)
+            math(EXPR RAM_SMALL "${RAM_SMALL} + ${SIZE}")
+            math(EXPR RAM_SMALL_COUNT "${RAM_SMALL_COUNT} + 1")
+        else()
+            #padded to sort as strings
+            string(LENGTH "${SIZE}" LENGTH)
+            math(EXPR PAD "8 - ${LENGTH}")
+            string(SUBSTRING "        " 0 ${PAD} SPACES)
+            list(APPEND SYMBOL_LINES "${SPACES}${SIZE}  ${NAME}")
+        endif()
+    endif()
+endforeach()
+
+list(SORT SYMBOL_LINES ORDER DESCENDING)
+
+if(NOT DEFINED SDC_sdc_mem)
+    message(WARNING "RAM report: no ram_report_* symbols in ${EXECUTABLE}")
+    return()
+endif()
+
+get_filename_component(EXECUTABLE_NAME ${EXECUTABLE} NAME)
+
+set(TEXT "RAM report for ${EXECUTABLE_NAME}\n\n")
+string(APPEND TEXT "Profile pool (m_profile_pool): ${SDC_profile_pool} bytes, for the controller and the ACL queues\n")
+string(APPEND TEXT "  Profile 0 (default):    ${SDC_profile_default} bytes\n")
+string(APPEND TEXT "  Profile 1 (many links): ${SDC_profile_many} bytes\n")
+string(APPEND TEXT "  Profile 2 (fast links): ${SDC_profile_fast} bytes\n\n")
+string(APPEND TEXT "Controller memory of profile 0: ${SDC_sdc_mem} bytes\n")
+string(APPEND TEXT "  Master links: ${SDC_master_links} x ${SDC_master_link} bytes, + ${SDC_master_shared} shared\n")
+string(APPEND TEXT "  Slave links:  ${SDC_slave_links} x ${SDC_slave_link} bytes, + ${SDC_slave_shared} shared\n")
+string(APPEND TEXT "  Per link:     ${SDC_tx_count} TX buffers of ${SDC_tx_size} bytes, ${SDC_tx_buffer} bytes each\n")
+string(APPEND TEXT "                ${SDC_rx_count} RX buffers of ${SDC_rx_size} bytes, ${SDC_rx_buffer} bytes each\n\n")
+string(APPEND TEXT "Variables (.data and .bss), largest first:\n")
+foreach(LINE IN LISTS SYMBOL_LINES)
+    string(APPEND TEXT "${LINE}\n")
+endforeach()
+string(APPEND TEXT "  ${RAM_SMALL} bytes in ${RAM_SMALL_COUNT} variables smaller than ${SMALL_SIZE} bytes\n")
+string(APPEND TEXT "  ${RAM_TOTAL} bytes in total, without stack and heap\n\n")
+string(APPEND TEXT "Functions and constants: ${CODE_TOTAL} bytes\n")
+
+file(WRITE ${REPORT} "${TEXT}")
+message(STATUS "RAM report: ${REPORT}, ${RAM_TOTAL} bytes of variables, ${SDC_profile_pool} for the controller pool")
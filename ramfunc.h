@@ -0,0 +1,23 @@
+#ifndef RAMFUNC_H__
+#define RAMFUNC_H__
+
+/* Functions on the transport interrupt path are marked RAMFUNC. With HCI_RAMFUNC set to 1 they
+   are placed in .data, copied to RAM by the startup code with the initialised variables, and
+   run without flash wait states. This costs RAM for their code, see ram_report.txt. Calls
+   between RAM and flash go through linker veneers, so the functions marked should call as
+   little outside of themselves as possible. The nrfx driver interrupt handlers stay in
+   flash. Has no effect in the host build.
+
+   The MDK linker script collects *(.data*) into .data. The section name has no dot after
+   .data, which would make the assembler expect writable data instead of code. */
+#ifndef HCI_RAMFUNC
+#define HCI_RAMFUNC 0
+#endif
+
+#if HCI_RAMFUNC && !defined(HCI_HOST_BUILD)
+#define RAMFUNC __attribute__((section(".data_ramfunc")))
+#else
+#define RAMFUNC
+#endif
+
+#endif // RAMFUNC_H__
@@ -1,4 +1,8 @@
+#include <stdatomic.h>
+
 #include "rand_numbers.h"
+#include "rand_pool.h"
+#include "ctr_drbg.h"
 #include "nrfx_rng.h"
 #include "nrf.h"
 
@@ -6,173 +10,482 @@
 #define NRFX_RNG_DEFAULT_CONFIG_IRQ_PRIORITY 7
 #endif
 
-#define RAND_POOL_CAPACITY    (64)
-#define RAND_POOL_SIZE        ( RAND_POOL_CAPACITY + 1 )
+/** With RAND_DRBG set, the pools are filled from a CTR_DRBG instead of directly from the RNG,
+    many bytes per RNG interrupt, and the RNG only provides its seeds. */
+#ifndef RAND_DRBG
+#define RAND_DRBG 0
+#endif
+
+/** Generate requests after which the DRBG is reseeded, as soon as a new seed has been
+    collected. Each request is at most RAND_POOL_SIZE bytes. */
+#ifndef RAND_DRBG_RESEED_INTERVAL
+#define RAND_DRBG_RESEED_INTERVAL 1024
+#endif
+
+/** Bytes held in both pools together once the RNG has stopped. They are shared out in
+    proportion to what each pool's consumer has taken recently, with at least
+    RAND_POOL_TARGET_MIN and at most RAND_POOL_SIZE for either. */
+#ifndef RAND_POOL_BUDGET
+#define RAND_POOL_BUDGET (RAND_POOL_SIZE + RAND_POOL_SIZE / 2)
+#endif
+#ifndef RAND_POOL_TARGET_MIN
+#define RAND_POOL_TARGET_MIN (RAND_POOL_SIZE / 4)
+#endif
+
+/** RNG values between two reassessments of the shares while the RNG runs. */
+#ifndef RAND_BALANCE_INTERVAL
+#define RAND_BALANCE_INTERVAL 32
+#endif
+
+#if (RAND_POOL_TARGET_MIN < 1) || (2 * RAND_POOL_TARGET_MIN > RAND_POOL_BUDGET) || (RAND_POOL_BUDGET > 2 * RAND_POOL_SIZE)
+#error "RAND_POOL_BUDGET must leave RAND_POOL_TARGET_MIN for both pools and fit in them"
+#endif
 
+/** Counters behind rand_stats_t, cleared on reading. */
+typedef struct
+{
+    atomic_uint bytes;
+    atomic_uint misses;
+    atomic_uint refills;
+} rand_pool_counters_t;
+
+/** A pool and the state used to keep it filled. The RNG is stopped once every pool holds its
+    target, its high watermark, and started again as soon as one falls below half of it, its
+    low watermark, or cannot serve a request. */
 typedef struct
 {
-  uint8_t    q[RAND_POOL_SIZE];
-  uint8_t    in;
-  uint8_t    out;
-} rand_queue_t;
+    rand_pool_t          pool;
+    volatile uint8_t     target;        ///< High watermark, set by the RNG interrupt
+    atomic_uint          taken;         ///< Bytes taken, never cleared
+    atomic_bool          refused;       ///< A request was refused while the RNG was being stopped
+    unsigned int         taken_seen;    ///< Value of taken at the last reassessment
+    uint32_t             demand;        ///< Bytes taken per reassessment, smoothed
+    rand_pool_counters_t counters;
+} rand_prio_pool_t;
+
+/** Pools of random numbers, filled by the RNG interrupt. The PRIO_HIGH pool is taken from
+    by the controller's high priority context only, the PRIO_LOW pool by its low priority
+    context and by rand_prio_low_vector_get_blocking. */
+static rand_prio_pool_t m_pools[RAND_PRIO_COUNT];
+
+static atomic_bool m_rng_stopped;
+static atomic_uint m_rng_values;
+static atomic_uint m_rng_stops;
+static uint8_t     m_balance_countdown;     ///< RNG interrupt only
+
+#if RAND_DRBG
+/** DRBG state and the seed being collected, used from the RNG interrupt only, or from a
+    context that blocks it. */
+static ctr_drbg_t m_drbg;
+static bool       m_drbg_seeded;
+static bool       m_drbg_failed;        ///< An encryption failed, the state is to be seeded again
+static uint8_t    m_seed[CTR_DRBG_SEED_SIZE];
+static uint8_t    m_seed_length;
+#endif
 
 
-/** Threadsafe queues for random numbers */
-static  rand_queue_t m_prio_low_pool;    ///< PRIO_LOW pool
-static  rand_queue_t m_prio_high_pool;      ///< PRIO_HIGH pool
 
+/** Share RAND_POOL_BUDGET out by recent demand. RNG interrupt only. */
+static void m_pools_balance(void)
+{
+    uint32_t total = 0;
+    uint32_t high_target;
 
-/** @brief Initialize a pool. */
-static void m_pool_init(rand_queue_t * p_queue);
+    for (uint8_t i = 0; i < RAND_PRIO_COUNT; i++)
+    {
+        rand_prio_pool_t * p_pool = &m_pools[i];
+        unsigned int       taken = atomic_load_explicit(&p_pool->taken, memory_order_relaxed);
 
-/** @brief Check if a pool is full. */
-static bool m_pool_full(rand_queue_t * p_queue);
+        p_pool->demand = (p_pool->demand + (taken - p_pool->taken_seen)) / 2;
+        p_pool->taken_seen = taken;
+        total += p_pool->demand;
+    }
 
-/** @brief Get the number of elements in the pool. */
-static uint8_t m_pool_count(rand_queue_t * p_queue);
+    high_target = (total == 0)
+                ? RAND_POOL_BUDGET / 2
+                : (uint32_t)(((uint64_t)RAND_POOL_BUDGET * m_pools[RAND_PRIO_HIGH].demand) / total);
+    if (high_target < RAND_POOL_TARGET_MIN)
+    {
+        high_target = RAND_POOL_TARGET_MIN;
+    }
+    else if (high_target > RAND_POOL_BUDGET - RAND_POOL_TARGET_MIN)
+    {
+        high_target = RAND_POOL_BUDGET - RAND_POOL_TARGET_MIN;
+    }
+    if (high_target > RAND_POOL_SIZE)
+    {
+        high_target = RAND_POOL_SIZE;
+    }
+    else if (RAND_POOL_BUDGET - high_target > RAND_POOL_SIZE)
+    {
+        high_target = RAND_POOL_BUDGET - RAND_POOL_SIZE;
+    }
 
-/** @brief Add a random number to the pool. */
-static void m_pool_enqueue(rand_queue_t * p_queue, uint8_t value);
+    m_pools[RAND_PRIO_HIGH].target = (uint8_t)high_target;
+    m_pools[RAND_PRIO_LOW].target = (uint8_t)(RAND_POOL_BUDGET - high_target);
+}
 
-/** @brief Get a random number from the pool. */
-static void m_pool_dequeue(rand_queue_t * p_queue, uint8_t * p_rand);
+static bool m_pools_at_target(void)
+{
+    for (uint8_t i = 0; i < RAND_PRIO_COUNT; i++)
+    {
+        if (rand_pool_count(&m_pools[i].pool) < m_pools[i].target)
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-/** @brief Get N random numbers from the pool. */
-static uint8_t m_pool_vector_get(rand_queue_t * p_queue, uint8_t * p_buff, uint8_t length);
+/** Start the RNG if it was stopped. Any context. */
+static void m_rng_restart(rand_prio_pool_t * p_pool)
+{
+    if (atomic_exchange(&m_rng_stopped, false))
+    {
+        atomic_fetch_add_explicit(&p_pool->counters.refills, 1, memory_order_relaxed);
+        nrfx_rng_start();
+    }
+}
 
-/** @brief Get N random numbers from the pool. */
-static uint8_t m_pool_vector_get(rand_queue_t * p_queue, uint8_t * p_buff, uint8_t length);
+/** Stop the RNG once nothing more is needed from it. RNG interrupt only. */
+static void m_rng_stop_check(void)
+{
+    bool idle;
 
+    /* Cleared before the pools are looked at, so that a consumer refused after they were
+       found full is still seen below. One refused before finds the pools full when it
+       retries, or the RNG still running. */
+    for (uint8_t i = 0; i < RAND_PRIO_COUNT; i++)
+    {
+        atomic_store(&m_pools[i].refused, false);
+    }
 
+    idle = m_pools_at_target();
+#if RAND_DRBG
+    idle = idle && (m_seed_length == CTR_DRBG_SEED_SIZE);
+#endif
+    if (!idle)
+    {
+        return;
+    }
 
-static void rng_handler(uint8_t rng_val)
-{
-    static rand_queue_t * all_pools[] = {&m_prio_high_pool, &m_prio_low_pool};
+    /* Stopped before the flag is set, so that a consumer that sees the flag set restarts the
+       RNG after this. Checked again in case a consumer took from a pool in between, or was
+       refused while the flag was still clear and so did not restart it. */
+    nrfx_rng_stop();
+    atomic_store(&m_rng_stopped, true);
+    atomic_fetch_add_explicit(&m_rng_stops, 1, memory_order_relaxed);
 
-    /* Find first pool that is not full (in priority order) and enqueue. */
-    for (uint8_t i = 0; i < (sizeof((all_pools)) / sizeof(all_pools[0])); i++)
+    for (uint8_t i = 0; i < RAND_PRIO_COUNT; i++)
     {
-        rand_queue_t *p_pool = all_pools[i];
-        if (!m_pool_full(p_pool))
+        if (rand_pool_count(&m_pools[i].pool) < m_pools[i].target / 2 ||
+            atomic_load(&m_pools[i].refused))
         {
-            m_pool_enqueue(p_pool, rng_val);
-        break;
+            m_rng_restart(&m_pools[i]);
+            break;
         }
     }
 }
 
-void rand_init(void) {
-    nrfx_rng_config_t config = NRFX_RNG_DEFAULT_CONFIG;
-
-    m_pool_init(&m_prio_low_pool);
-    m_pool_init(&m_prio_high_pool);
+/** Take from a pool, and restart the RNG if that leaves it at its low watermark or if the
+    request cannot be served. A retry of a refused request is not counted again. */
+static uint8_t m_pool_get(rand_prio_pool_t * p_pool, uint8_t * p_buff, uint8_t length, bool retry)
+{
+    uint8_t taken = rand_pool_get(&p_pool->pool, p_buff, length);
 
-    uint32_t err_code = nrfx_rng_init(&config, rng_handler);
-    NRFX_ASSERT(err_code == NRFX_SUCCESS);
+    if (taken != 0)
+    {
+        atomic_fetch_add_explicit(&p_pool->taken, taken, memory_order_relaxed);
+        atomic_fetch_add_explicit(&p_pool->counters.bytes, taken, memory_order_relaxed);
+    }
+    else if (!retry)
+    {
+        /* Counted as demand as well, or a pool that is too small would stay so. */
+        atomic_fetch_add_explicit(&p_pool->taken, length, memory_order_relaxed);
+        atomic_fetch_add_explicit(&p_pool->counters.misses, 1, memory_order_relaxed);
+    }
 
-    nrfx_rng_start();
+    if (taken == 0)
+    {
+        atomic_store(&p_pool->refused, true);
+    }
+    if (taken == 0 || rand_pool_count(&p_pool->pool) < p_pool->target / 2)
+    {
+        m_rng_restart(p_pool);
+    }
+    return taken;
 }
 
-uint8_t rand_prio_low_vector_get(uint8_t * p_buff, uint8_t length)
+/** Put a value from the RNG into a pool as it is. */
+static void m_pools_put(uint8_t rng_val)
 {
-    bool status = false;
+    rand_prio_pool_t * p_best = NULL;
+    int                best_deficit = 0;
 
-    if ( length <= m_pool_count(&m_prio_low_pool) )
+    /* The pool furthest below its target, then any pool that is not full, in priority
+       order. */
+    for (uint8_t i = 0; i < RAND_PRIO_COUNT; i++)
     {
-        for(uint8_t i = 0; i < length; i++)
+        int deficit = (int)m_pools[i].target - (int)rand_pool_count(&m_pools[i].pool);
+
+        if (deficit > best_deficit)
         {
-            m_pool_dequeue(&m_prio_low_pool, &p_buff[i]);
+            p_best = &m_pools[i];
+            best_deficit = deficit;
         }
-        status = true;
     }
-
-    if (status) {
-        return length;
+    if (p_best != NULL && rand_pool_put(&p_best->pool, rng_val))
+    {
+        return;
+    }
+    for (uint8_t i = 0; i < RAND_PRIO_COUNT; i++)
+    {
+        if (rand_pool_put(&m_pools[i].pool, rng_val))
+        {
+            return;
+        }
     }
-    return 0;
 }
 
-uint8_t rand_prio_high_vector_get(uint8_t * p_buff, uint8_t length)
+#if RAND_DRBG
+/** Top up a pool to level bytes if it holds fewer. Nothing is put in on an error. */
+static int32_t m_pool_refill(rand_prio_pool_t * p_pool, uint8_t level)
 {
-    bool status = false;
+    uint8_t buff[RAND_POOL_SIZE];
+    uint8_t count = rand_pool_count(&p_pool->pool);
+    uint8_t length;
+    int32_t err_code;
 
-    if ( length <= m_pool_count(&m_prio_high_pool) )
+    if (count >= level)
     {
-        for(uint8_t i = 0; i < length; i++)
-        {
-            m_pool_dequeue(&m_prio_high_pool, &p_buff[i]);
-        }
-        status = true;
+        return 0;
     }
+    length = level - count;
 
-    if (status) {
-        return length;
+    err_code = ctr_drbg_generate(&m_drbg, buff, length);
+    if (err_code != 0)
+    {
+        return err_code;
+    }
+    for (uint8_t i = 0; i < length; i++)
+    {
+        (void)rand_pool_put(&p_pool->pool, buff[i]);
     }
     return 0;
 }
 
-void rand_prio_low_vector_get_blocking(uint8_t * p_buff, uint8_t length)
+/** The DRBG could not encrypt: start again from a fresh seed. */
+static void m_drbg_fail(void)
 {
-    NRFX_ASSERT(length <= RAND_POOL_SIZE);
+    m_drbg_seeded = false;
+    m_drbg_failed = true;
+    m_seed_length = 0;
+}
 
-    bool current_prio_blocks_rng_irq =
-        (NVIC_GetPriority((IRQn_Type)(((SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk)>>SCB_ICSR_VECTACTIVE_Pos)-16)) & 0xFF)
-        <=
-        (NVIC_GetPriority(RNG_IRQn) & 0xFF);
+static void m_pools_fill(uint8_t rng_val)
+{
+    /* After a failure, the pools take the values from the RNG as they are, and the seed gets
+       what they leave over. A value is never used for both. */
+    if (m_drbg_failed && !m_pools_at_target())
+    {
+        m_pools_put(rng_val);
+        return;
+    }
 
-    while (!m_pool_vector_get(&m_prio_low_pool, p_buff, length))
+    if (m_seed_length < CTR_DRBG_SEED_SIZE)
     {
-        if(current_prio_blocks_rng_irq)
+        m_seed[m_seed_length++] = rng_val;
+    }
+
+    /* Each seed is used once. */
+    if (m_seed_length == CTR_DRBG_SEED_SIZE)
+    {
+        if (!m_drbg_seeded)
         {
-            while (!nrf_rng_event_check(NRF_RNG, NRF_RNG_EVENT_VALRDY)) {}
-            nrfx_rng_irq_handler();
+            m_seed_length = 0;
+            if (ctr_drbg_instantiate(&m_drbg, m_seed) != 0)
+            {
+                m_drbg_fail();
+                return;
+            }
+            m_drbg_seeded = true;
+            m_drbg_failed = false;
+        }
+        else if (m_drbg.reseed_counter > RAND_DRBG_RESEED_INTERVAL)
+        {
+            m_seed_length = 0;
+            if (ctr_drbg_reseed(&m_drbg, m_seed) != 0)
+            {
+                m_drbg_fail();
+                return;
+            }
         }
-        else {}
     }
-}
 
+    /* Consumers restart the RNG at half the target, so a refill is usually half a pool and
+       the two extra block encryptions of a generate request are shared out. */
+    if (m_drbg_seeded)
+    {
+        for (uint8_t i = 0; i < RAND_PRIO_COUNT; i++)
+        {
+            if (m_pool_refill(&m_pools[i], m_pools[i].target) != 0)
+            {
+                m_drbg_fail();
+                return;
+            }
+        }
+    }
+}
+#else
+static void m_pools_fill(uint8_t rng_val)
+{
+    m_pools_put(rng_val);
+}
+#endif
 
-static void m_pool_init(rand_queue_t * p_queue)
+static void rng_handler(uint8_t rng_val)
 {
-    p_queue->in = p_queue->out = 0;
+    atomic_fetch_add_explicit(&m_rng_values, 1, memory_order_relaxed);
+
+    if (m_balance_countdown == 0)
+    {
+        m_pools_balance();
+        m_balance_countdown = RAND_BALANCE_INTERVAL;
+    }
+    m_balance_countdown--;
+
+    m_pools_fill(rng_val);
+    m_rng_stop_check();
+}
+
+void rand_init(void) {
+    nrfx_rng_config_t config = NRFX_RNG_DEFAULT_CONFIG;
+
+    for (uint8_t i = 0; i < RAND_PRIO_COUNT; i++)
+    {
+        rand_pool_init(&m_pools[i].pool);
+        m_pools[i].target = RAND_POOL_BUDGET / 2;
+        atomic_init(&m_pools[i].refused, false);
+    }
+    atomic_init(&m_rng_stopped, false);
+
+    uint32_t err_code = nrfx_rng_init(&config, rng_handler);
+    NRFX_ASSERT(err_code == NRFX_SUCCESS);
+
+    nrfx_rng_start();
 }
 
-static bool m_pool_full(rand_queue_t * p_queue)
+uint8_t rand_prio_low_vector_get(uint8_t * p_buff, uint8_t length)
 {
-    return (p_queue->in + 1) % RAND_POOL_SIZE == p_queue->out;
+    return m_pool_get(&m_pools[RAND_PRIO_LOW], p_buff, length, false);
 }
 
-static uint8_t m_pool_count(rand_queue_t * p_queue)
+uint8_t rand_prio_high_vector_get(uint8_t * p_buff, uint8_t length)
 {
-    return p_queue->in >= p_queue->out
-         ? p_queue->in - p_queue->out
-         : (RAND_POOL_SIZE - p_queue->out) + p_queue->in;
+    return m_pool_get(&m_pools[RAND_PRIO_HIGH], p_buff, length, false);
 }
 
-static void m_pool_enqueue(rand_queue_t * p_queue, uint8_t value)
+/** Take from the PRIO_LOW pool in a context the controller's low priority context may
+    preempt. That context, SWI5, takes from the same pool, so interrupts down from the more
+    urgent of it and the RNG are masked to keep a single consumer. The radio and the
+    controller's high priority context still run. The copy is short. */
+static uint8_t m_prio_low_vector_get_masked(uint8_t * p_buff, uint8_t length, bool retry)
 {
-    p_queue->q[p_queue->in] = value;
-    p_queue->in = (p_queue->in + 1) % RAND_POOL_SIZE;
+    uint32_t prio = NVIC_GetPriority(SWI5_IRQn);
+    uint8_t  taken;
+
+    if (NVIC_GetPriority(RNG_IRQn) < prio)
+    {
+        prio = NVIC_GetPriority(RNG_IRQn);
+    }
+
+    if (prio == 0)
+    {
+        /* BASEPRI 0 masks nothing. Only while the priorities are not set up yet, when
+           masking everything for the copy does no harm. */
+        uint32_t primask = __get_PRIMASK();
+
+        __disable_irq();
+        taken = m_pool_get(&m_pools[RAND_PRIO_LOW], p_buff, length, retry);
+        __set_PRIMASK(primask);
+    }
+    else
+    {
+        uint32_t basepri = __get_BASEPRI();
+
+        __set_BASEPRI_MAX(prio << (8U - __NVIC_PRIO_BITS));
+        taken = m_pool_get(&m_pools[RAND_PRIO_LOW], p_buff, length, retry);
+        __set_BASEPRI(basepri);
+    }
+
+    return taken;
 }
 
-static void m_pool_dequeue(rand_queue_t * p_queue, uint8_t * p_rand)
+uint8_t rand_vector_get(uint8_t * p_buff, uint8_t length)
 {
-    *p_rand = p_queue->q[p_queue->out];
-    p_queue->out = (p_queue->out + 1) % RAND_POOL_SIZE;
+    return m_prio_low_vector_get_masked(p_buff, length, false);
 }
 
-static uint8_t m_pool_vector_get(rand_queue_t * p_queue, uint8_t * p_buff, uint8_t length)
+void rand_prio_low_vector_get_blocking(uint8_t * p_buff, uint8_t length)
 {
-    bool status = false;
+    NRFX_ASSERT(length <= RAND_POOL_SIZE);
+
+    bool current_prio_blocks_rng_irq =
+        (NVIC_GetPriority((IRQn_Type)(((SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk)>>SCB_ICSR_VECTACTIVE_Pos)-16)) & 0xFF)
+        <=
+        (NVIC_GetPriority(RNG_IRQn) & 0xFF);
 
-    if ( length <= m_pool_count(p_queue) )
+    for (bool retry = false; ; retry = true)
     {
-        for(uint8_t i = 0; i < length; i++)
+        /* A refused request restarts the RNG if it was stopped. */
+        if (m_prio_low_vector_get_masked(p_buff, length, retry) != 0)
         {
-            m_pool_dequeue(p_queue, &p_buff[i]);
+            break;
+        }
+
+        if(current_prio_blocks_rng_irq)
+        {
+#if RAND_DRBG
+            /* Refill from the DRBG at once, rather than waiting for the RNG. */
+            if (m_drbg_seeded)
+            {
+                if (m_pool_refill(&m_pools[RAND_PRIO_LOW], RAND_POOL_SIZE) == 0)
+                {
+                    continue;
+                }
+                m_drbg_fail();
+            }
+#endif
+            while (!nrf_rng_event_check(NRF_RNG, NRF_RNG_EVENT_VALRDY)) {}
+            nrfx_rng_irq_handler();
         }
-        status = true;
     }
+}
 
-    return status ? length : 0;
+void rand_stats_get(rand_stats_t * p_stats, bool reset)
+{
+    for (uint8_t i = 0; i < RAND_PRIO_COUNT; i++)
+    {
+        rand_prio_pool_t * p_pool = &m_pools[i];
+
+        p_stats->pools[i].count = rand_pool_count(&p_pool->pool);
+        p_stats->pools[i].target = p_pool->target;
+        p_stats->pools[i].bytes = atomic_load(&p_pool->counters.bytes);
+        p_stats->pools[i].misses = atomic_load(&p_pool->counters.misses);
+        p_stats->pools[i].refills = atomic_load(&p_pool->counters.refills);
+        if (reset)
+        {
+            atomic_store(&p_pool->counters.bytes, 0);
+            atomic_store(&p_pool->counters.misses, 0);
+            atomic_store(&p_pool->counters.refills, 0);
+        }
+    }
+    p_stats->rng_values = atomic_load(&m_rng_values);
+    p_stats->rng_stops = atomic_load(&m_rng_stops);
+    p_stats->rng_running = !atomic_load(&m_rng_stopped);
+    if (reset)
+    {
+        atomic_store(&m_rng_values, 0);
+        atomic_store(&m_rng_stops, 0);
+    }
 }
@@ -1,7 +1,38 @@
 #include <stdint.h>
+#include <stdbool.h>
 
 void rand_init(void);
 
 uint8_t rand_prio_low_vector_get(uint8_t * p_buff, uint8_t length);
 uint8_t rand_prio_high_vector_get(uint8_t * p_buff, uint8_t length);
 void rand_prio_low_vector_get_blocking(uint8_t * p_buff, uint8_t length);
+
+/** Take from the PRIO_LOW pool outside of the controller's contexts, without waiting. Returns
+    length, or 0 if the pool holds fewer bytes. */
+uint8_t rand_vector_get(uint8_t * p_buff, uint8_t length);
+
+/** Pools, in the order of rand_stats_t::pools. */
+typedef enum
+{
+    RAND_PRIO_HIGH,
+    RAND_PRIO_LOW,
+    RAND_PRIO_COUNT
+} rand_prio_t;
+
+typedef struct
+{
+    struct
+    {
+        uint8_t  count;         ///< Bytes in the pool
+        uint8_t  target;        ///< Fill level at which the RNG may stop, follows demand
+        uint32_t bytes;         ///< Bytes taken
+        uint32_t misses;        ///< Requests refused for want of bytes
+        uint32_t refills;       ///< Times taking from the pool restarted the RNG
+    } pools[RAND_PRIO_COUNT];
+    uint32_t rng_values;        ///< RNG interrupts
+    uint32_t rng_stops;         ///< Times the RNG was stopped with the pools at their targets
+    bool     rng_running;
+} rand_stats_t;
+
+/** Read the pool levels and counters, and clear the counters if reset is set. */
+void rand_stats_get(rand_stats_t * p_stats, bool reset);
@@ -0,0 +1,60 @@
+#include <string.h>
+
+#include "rand_pool.h"
+
+#define RAND_POOL_MASK (RAND_POOL_SIZE - 1)
+
+
+void rand_pool_init(rand_pool_t * p_pool)
+{
+    atomic_init(&p_pool->in, 0);
+    atomic_init(&p_pool->out, 0);
+}
+
+uint8_t rand_pool_count(rand_pool_t * p_pool)
+{
+    unsigned int in = atomic_load_explicit(&p_pool->in, memory_order_acquire);
+    unsigned int out = atomic_load_explicit(&p_pool->out, memory_order_acquire);
+
+    return (uint8_t)(in - out);
+}
+
+bool rand_pool_put(rand_pool_t * p_pool, uint8_t value)
+{
+    unsigned int in = atomic_load_explicit(&p_pool->in, memory_order_relaxed);
+    unsigned int out = atomic_load_explicit(&p_pool->out, memory_order_acquire);
+
+    if (in - out == RAND_POOL_SIZE)
+    {
+        return false;
+    }
+
+    p_pool->q[in & RAND_POOL_MASK] = value;
+    atomic_store_explicit(&p_pool->in, in + 1, memory_order_release);
+    return true;
+}
+
+uint8_t rand_pool_get(rand_pool_t * p_pool, uint8_t * p_buff, uint8_t length)
+{
+    unsigned int out = atomic_load_explicit(&p_pool->out, memory_order_relaxed);
+    unsigned int in = atomic_load_explicit(&p_pool->in, memory_order_acquire);
+    unsigned int start = out & RAND_POOL_MASK;
+    unsigned int first;
+
+    if (length == 0 || in - out < length)
+    {
+        return 0;
+    }
+
+    /* Up to the end of the array, then the rest from the start. */
+    first = RAND_POOL_SIZE - start;
+    if (first > length)
+    {
+        first = length;
+    }
+    memcpy(p_buff, &p_pool->q[start], first);
+    memcpy(&p_buff[first], p_pool->q, length - first);
+
+    atomic_store_explicit(&p_pool->out, out + length, memory_order_release);
+    return length;
+}
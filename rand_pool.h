@@ -0,0 +1,44 @@
+#ifndef RAND_POOL_H__
+#define RAND_POOL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/* Ring of random bytes with one producer and one consumer, which may preempt each other, or
+   run on different threads in the host build.
+
+   The indexes run freely and are masked with the power of two size, so the full size is
+   usable and the fill level is in - out. The producer writes a byte before publishing it
+   with a release store of in, and the consumer reads bytes after an acquire load of in,
+   then frees them with a release store of out. Each side only writes its own index. */
+#ifndef RAND_POOL_SIZE
+#define RAND_POOL_SIZE 64
+#endif
+
+#if (RAND_POOL_SIZE < 2) || (RAND_POOL_SIZE > 128) || ((RAND_POOL_SIZE & (RAND_POOL_SIZE - 1)) != 0)
+#error "RAND_POOL_SIZE must be a power of two from 2 to 128"
+#endif
+
+typedef struct
+{
+    uint8_t     q[RAND_POOL_SIZE];
+    atomic_uint in;             /* Written by the producer only */
+    atomic_uint out;            /* Written by the consumer only */
+} rand_pool_t;
+
+/* Empty the pool. Neither side may use it meanwhile. */
+void rand_pool_init(rand_pool_t * p_pool);
+
+/* Bytes in the pool. Exact for the consumer, a lower bound of the free space for the
+   producer. */
+uint8_t rand_pool_count(rand_pool_t * p_pool);
+
+/* Producer: add a byte. Returns false if the pool is full. */
+bool rand_pool_put(rand_pool_t * p_pool, uint8_t value);
+
+/* Consumer: take length bytes, copied in at most two spans. Takes nothing and returns 0 if
+   fewer are available, returns length otherwise. */
+uint8_t rand_pool_get(rand_pool_t * p_pool, uint8_t * p_buff, uint8_t length);
+
+#endif // RAND_POOL_H__
@@ -0,0 +1,158 @@
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "rx_pool.h"
+#include "ramfunc.h"
+
+typedef struct
+{
+    uint8_t    free[RX_POOL_COUNT];    ///< Stack of free buffer indexes
+    uint8_t    free_count;
+} rx_pool_class_t;
+
+static uint8_t m_small_buffers[RX_POOL_SMALL_COUNT][RX_POOL_SMALL_SIZE];
+static uint8_t m_large_buffers[RX_POOL_LARGE_COUNT][RX_POOL_LARGE_SIZE];
+
+static rx_pool_class_t m_small_class;
+static rx_pool_class_t m_large_class;
+
+/** FIFO of received packets, one slot more than there are buffers so it never fills up. The
+    release store of an index publishes the slots before it, as in rand_pool.c. */
+typedef struct
+{
+    uint8_t *      q[RX_POOL_COUNT + 1];
+    atomic_uint    in;      ///< Written by the transport interrupt only
+    atomic_uint    out;     ///< Written by the main loop only
+} rx_pool_fifo_t;
+
+static rx_pool_fifo_t m_fifos[RX_POOL_QUEUE_COUNT];
+
+static uint8_t m_high_water;    ///< Most buffers in use at once
+
+
+/** @brief Take a buffer index from a size class, or return false if the class is empty. */
+static bool m_class_take(rx_pool_class_t * p_class, uint8_t * p_index);
+
+/** @brief Number of buffers currently allocated. */
+static uint8_t m_in_use(void);
+
+
+void rx_pool_init(void)
+{
+    m_small_class.free_count = 0;
+    for (uint8_t i = 0; i < RX_POOL_SMALL_COUNT; i++)
+    {
+        m_small_class.free[m_small_class.free_count++] = i;
+    }
+
+    m_large_class.free_count = 0;
+    for (uint8_t i = 0; i < RX_POOL_LARGE_COUNT; i++)
+    {
+        m_large_class.free[m_large_class.free_count++] = i;
+    }
+
+    for (uint8_t i = 0; i < RX_POOL_QUEUE_COUNT; i++)
+    {
+        atomic_init(&m_fifos[i].in, 0);
+        atomic_init(&m_fifos[i].out, 0);
+    }
+
+    m_high_water = 0;
+}
+
+RAMFUNC uint8_t * rx_pool_alloc(uint16_t length)
+{
+    uint8_t index;
+
+    uint8_t * p_buffer = NULL;
+
+    if (length <= RX_POOL_SMALL_SIZE && m_class_take(&m_small_class, &index))
+    {
+        p_buffer = m_small_buffers[index];
+    }
+    /* Small packets fall back to a large buffer rather than wait. */
+    else if (length <= RX_POOL_LARGE_SIZE && m_class_take(&m_large_class, &index))
+    {
+        p_buffer = m_large_buffers[index];
+    }
+
+    if (p_buffer != NULL && m_in_use() > m_high_water)
+    {
+        m_high_water = m_in_use();
+    }
+
+    return p_buffer;
+}
+
+void rx_pool_free(uint8_t * p_buffer)
+{
+    uint8_t * p_small_start = &m_small_buffers[0][0];
+    uint8_t * p_large_start = &m_large_buffers[0][0];
+
+    if (p_buffer >= p_small_start && p_buffer < p_small_start + sizeof(m_small_buffers))
+    {
+        m_small_class.free[m_small_class.free_count++] = (uint8_t)((p_buffer - p_small_start) / RX_POOL_SMALL_SIZE);
+    }
+    else if (p_buffer >= p_large_start && p_buffer < p_large_start + sizeof(m_large_buffers))
+    {
+        m_large_class.free[m_large_class.free_count++] = (uint8_t)((p_buffer - p_large_start) / RX_POOL_LARGE_SIZE);
+    }
+}
+
+uint8_t rx_pool_high_water_get(bool reset)
+{
+    uint8_t high_water = m_high_water;
+
+    if (reset)
+    {
+        m_high_water = m_in_use();
+    }
+    return high_water;
+}
+
+RAMFUNC void rx_pool_enqueue(rx_pool_queue_t queue, uint8_t * p_buffer)
+{
+    rx_pool_fifo_t * p_fifo = &m_fifos[queue];
+    unsigned int     in = atomic_load_explicit(&p_fifo->in, memory_order_relaxed);
+
+    p_fifo->q[in] = p_buffer;
+    atomic_store_explicit(&p_fifo->in, (in + 1) % (RX_POOL_COUNT + 1), memory_order_release);
+}
+
+uint8_t * rx_pool_peek(rx_pool_queue_t queue)
+{
+    rx_pool_fifo_t * p_fifo = &m_fifos[queue];
+    unsigned int     out = atomic_load_explicit(&p_fifo->out, memory_order_relaxed);
+    unsigned int     in = atomic_load_explicit(&p_fifo->in, memory_order_acquire);
+
+    return (out == in) ? NULL : p_fifo->q[out];
+}
+
+void rx_pool_dequeue(rx_pool_queue_t queue)
+{
+    rx_pool_fifo_t * p_fifo = &m_fifos[queue];
+    unsigned int     out = atomic_load_explicit(&p_fifo->out, memory_order_relaxed);
+    unsigned int     in = atomic_load_explicit(&p_fifo->in, memory_order_acquire);
+
+    if (out != in)
+    {
+        atomic_store_explicit(&p_fifo->out, (out + 1) % (RX_POOL_COUNT + 1), memory_order_release);
+    }
+}
+
+
+static bool m_class_take(rx_pool_class_t * p_class, uint8_t * p_index)
+{
+    if (p_class->free_count == 0)
+    {
+        return false;
+    }
+
+    *p_index = p_class->free[--p_class->free_count];
+    return true;
+}
+
+static uint8_t m_in_use(void)
+{
+    return RX_POOL_COUNT - m_small_class.free_count - m_large_class.free_count;
+}
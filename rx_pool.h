@@ -0,0 +1,50 @@
+#ifndef RX_POOL_H__
+#define RX_POOL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sdc_hci.h"
+
+/* Pool of buffers for packets received from the host, in two size classes. Small buffers
+   take commands and ACL data up to the default LE data length, large ones anything up to
+   the maximum HCI packet size. A buffer holds the whole H4 packet, including the type byte. */
+#ifndef RX_POOL_SMALL_SIZE
+#define RX_POOL_SMALL_SIZE 32
+#endif
+#ifndef RX_POOL_SMALL_COUNT
+#define RX_POOL_SMALL_COUNT 8
+#endif
+#define RX_POOL_LARGE_SIZE (1 + HCI_MSG_BUFFER_MAX_SIZE)
+#ifndef RX_POOL_LARGE_COUNT
+#define RX_POOL_LARGE_COUNT 4
+#endif
+
+#define RX_POOL_COUNT (RX_POOL_SMALL_COUNT + RX_POOL_LARGE_COUNT)
+
+void rx_pool_init(void);
+
+/* Allocation and freeing must not be preempted by each other: call them from the transport
+   interrupt, or with it disabled. */
+uint8_t * rx_pool_alloc(uint16_t length);
+void rx_pool_free(uint8_t * p_buffer);
+
+/* Most buffers that have been in use at once since init or the last reset. Same calling
+   context as allocation. */
+uint8_t rx_pool_high_water_get(bool reset);
+
+/* FIFOs of received packets, filled by the transport interrupt and emptied by the main loop.
+   Commands and ACL data are queued separately so that one can wait for the controller
+   without holding up the other. */
+typedef enum
+{
+    RX_POOL_QUEUE_CMD,
+    RX_POOL_QUEUE_ACL,
+    RX_POOL_QUEUE_COUNT
+} rx_pool_queue_t;
+
+void rx_pool_enqueue(rx_pool_queue_t queue, uint8_t * p_buffer);
+uint8_t * rx_pool_peek(rx_pool_queue_t queue);
+void rx_pool_dequeue(rx_pool_queue_t queue);
+
+#endif // RX_POOL_H__
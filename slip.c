@@ -0,0 +1,178 @@
+#include <string.h>
+
+#include "slip.h"
+
+#define BYTES_ONES  0x01010101UL
+#define BYTES_HIGHS 0x80808080UL
+
+/* Non-zero if any byte of word equals value. */
+static inline uint32_t m_word_has_byte(uint32_t word, uint8_t value)
+{
+    uint32_t x = word ^ (BYTES_ONES * value);
+
+    return (x - BYTES_ONES) & ~x & BYTES_HIGHS;
+}
+
+/* Number of leading bytes that are neither SLIP_END nor SLIP_ESC. */
+static size_t m_plain_run_get(uint8_t const * p_data, size_t length)
+{
+    size_t i = 0;
+
+    for (; i + sizeof(uint32_t) <= length; i += sizeof(uint32_t))
+    {
+        uint32_t word;
+
+        memcpy(&word, &p_data[i], sizeof(word));
+        if (m_word_has_byte(word, SLIP_END) | m_word_has_byte(word, SLIP_ESC))
+        {
+            break;
+        }
+    }
+
+    while (i < length && p_data[i] != SLIP_END && p_data[i] != SLIP_ESC)
+    {
+        i++;
+    }
+
+    return i;
+}
+
+static inline uint8_t * m_byte_encode(uint8_t * p_out, uint8_t byte)
+{
+    if (byte == SLIP_END || byte == SLIP_ESC)
+    {
+        *p_out++ = SLIP_ESC;
+        byte = (byte == SLIP_END) ? SLIP_ESC_END : SLIP_ESC_ESC;
+    }
+    *p_out++ = byte;
+    return p_out;
+}
+
+uint8_t * slip_encode(uint8_t * p_out, uint8_t const * p_in, size_t length)
+{
+    uint8_t const * p_end = p_in + length;
+
+    /* Words without special bytes are stored as they are loaded. */
+    while (p_end - p_in >= (ptrdiff_t)sizeof(uint32_t))
+    {
+        uint32_t word;
+
+        memcpy(&word, p_in, sizeof(word));
+        if ((m_word_has_byte(word, SLIP_END) | m_word_has_byte(word, SLIP_ESC)) == 0)
+        {
+            memcpy(p_out, &word, sizeof(word));
+            p_out += sizeof(word);
+            p_in += sizeof(word);
+            continue;
+        }
+
+        for (size_t i = 0; i < sizeof(word); i++)
+        {
+            p_out = m_byte_encode(p_out, *p_in++);
+        }
+    }
+
+    while (p_in < p_end)
+    {
+        p_out = m_byte_encode(p_out, *p_in++);
+    }
+
+    return p_out;
+}
+
+void slip_decoder_init(slip_decoder_t * p_decoder, uint8_t * p_frame, size_t size)
+{
+    memset(p_decoder, 0, sizeof(*p_decoder));
+    p_decoder->p_frame = p_frame;
+    p_decoder->size = size;
+}
+
+static void m_frame_byte_put(slip_decoder_t * p_decoder, uint8_t byte)
+{
+    if (p_decoder->length < p_decoder->size)
+    {
+        p_decoder->p_frame[p_decoder->length++] = byte;
+    }
+    else
+    {
+        p_decoder->discard = true;
+    }
+}
+
+size_t slip_decode(slip_decoder_t * p_decoder, uint8_t const * p_in, size_t length, bool * p_frame_end)
+{
+    size_t consumed = 0;
+
+    *p_frame_end = false;
+
+    if (p_decoder->complete)
+    {
+        p_decoder->complete = false;
+        p_decoder->length = 0;
+    }
+
+    while (consumed < length)
+    {
+        uint8_t byte;
+
+        if (p_decoder->escape)
+        {
+            byte = p_in[consumed++];
+            p_decoder->escape = false;
+
+            if (byte == SLIP_ESC_END || byte == SLIP_ESC_ESC)
+            {
+                m_frame_byte_put(p_decoder, (byte == SLIP_ESC_END) ? SLIP_END : SLIP_ESC);
+                continue;
+            }
+            /* Anything else is a broken escape, the frame is dropped, and a SLIP_END still
+               ends it. */
+            p_decoder->discard = true;
+            if (byte != SLIP_END)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            size_t run = m_plain_run_get(&p_in[consumed], length - consumed);
+            size_t copy = p_decoder->size - p_decoder->length;
+
+            if (run > copy)
+            {
+                p_decoder->discard = true;
+            }
+            else
+            {
+                copy = run;
+            }
+            memcpy(&p_decoder->p_frame[p_decoder->length], &p_in[consumed], copy);
+            p_decoder->length += copy;
+            consumed += run;
+
+            if (consumed == length)
+            {
+                break;
+            }
+
+            byte = p_in[consumed++];
+            if (byte == SLIP_ESC)
+            {
+                p_decoder->escape = true;
+                continue;
+            }
+        }
+
+        /* SLIP_END */
+        if (p_decoder->length > 0 && !p_decoder->discard)
+        {
+            p_decoder->complete = true;
+            *p_frame_end = true;
+            break;
+        }
+        p_decoder->length = 0;
+        p_decoder->discard = false;
+    }
+
+    return consumed;
+}
@@ -0,0 +1,42 @@
+#ifndef SLIP_H__
+#define SLIP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* SLIP framing as used by the Three-wire UART (H5): frames are delimited by SLIP_END, and
+   SLIP_END and SLIP_ESC in the data are sent as two byte escape sequences. Both directions
+   look for the two special bytes a word at a time and copy the runs in between with memcpy,
+   so data that needs no escaping costs little more than a copy. */
+#define SLIP_END     0xC0
+#define SLIP_ESC     0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+/* Most bytes length bytes take once encoded, without the delimiters. */
+#define SLIP_ENCODED_SIZE_MAX(length) (2 * (length))
+
+/* Escape length bytes into p_out, which must hold SLIP_ENCODED_SIZE_MAX(length) bytes.
+   Returns the end of the encoded data. The caller adds the delimiters. */
+uint8_t * slip_encode(uint8_t * p_out, uint8_t const * p_in, size_t length);
+
+/* Decoder state, collecting one frame at a time into a buffer of the caller. */
+typedef struct
+{
+    uint8_t * p_frame;
+    size_t    size;
+    size_t    length;       /* Bytes of the frame decoded so far */
+    bool      escape;       /* The last byte was SLIP_ESC */
+    bool      discard;      /* The frame is too long or badly escaped, and is dropped */
+    bool      complete;     /* The frame has been returned, the next call starts a new one */
+} slip_decoder_t;
+
+void slip_decoder_init(slip_decoder_t * p_decoder, uint8_t * p_frame, size_t size);
+
+/* Decode received bytes until a frame ends. Returns the number of bytes consumed, and sets
+   *p_frame_end if a frame ended: it is in p_frame, length bytes long, until the next call.
+   Empty, too long and badly escaped frames are dropped. */
+size_t slip_decode(slip_decoder_t * p_decoder, uint8_t const * p_in, size_t length, bool * p_frame_end);
+
+#endif // SLIP_H__
@@ -0,0 +1,90 @@
+#ifndef TRANSPORT_H__
+#define TRANSPORT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Byte transport between the host and the H4 framing in main.c. A backend moves bytes in
+   and out of buffers owned by main.c and reports completions from its interrupt:
+
+   - RX buffers are armed ahead of time. A second buffer armed while the first is in use is
+     chained after it. A buffer ends when it is full, when rx_flush() is called, when the
+     backend ends it after a shorter transfer, or on a line error. A buffer that ends before
+     it is full also drops the chained one, which has to be armed again.
+   - One TX buffer is sent at a time.
+
+   Backends, selected with HCI_TRANSPORT:
+   - transport_uarte: UARTE0 with hardware flow control.
+   - transport_spis:  SPIS1 with ready and data pending lines, see transport_spis.c.
+   - transport_h5: Three-wire UART (H5) on top of another backend, see transport_h5.c.
+   - transport_socket: Unix socket, host build only, see host/transport_socket.c. */
+
+/* Line errors reported with TRANSPORT_EVT_RX_ERROR. */
+#define TRANSPORT_ERROR_OVERRUN (1UL << 0)
+#define TRANSPORT_ERROR_PARITY  (1UL << 1)
+#define TRANSPORT_ERROR_FRAMING (1UL << 2)
+#define TRANSPORT_ERROR_BREAK   (1UL << 3)
+
+typedef enum
+{
+    TRANSPORT_EVT_TX_DONE,      /* The TX buffer has been sent */
+    TRANSPORT_EVT_RX_DONE,      /* An RX buffer has ended, p_data and bytes are set */
+    TRANSPORT_EVT_RX_ERROR,     /* An RX buffer has ended on a line error, error_mask is set too */
+    TRANSPORT_EVT_RX_WAKE,      /* Data has arrived after rx_wake_enable() */
+    TRANSPORT_EVT_DRIVER_ERROR, /* The driver refused to set up a transfer, poll() retries it */
+} transport_evt_type_t;
+
+typedef struct
+{
+    transport_evt_type_t type;
+    uint8_t *            p_data;
+    size_t               bytes;
+    uint32_t             error_mask;
+} transport_evt_t;
+
+typedef void (* transport_evt_handler_t)(transport_evt_t const * p_evt);
+
+typedef struct
+{
+    /* Start the transport. Events are delivered to handler from the transport interrupt,
+       which runs at irq_priority. */
+    void (* open)(transport_evt_handler_t handler, uint8_t irq_priority);
+
+    /* Arm an RX buffer, see above. */
+    void (* rx_arm)(uint8_t * p_data, size_t length);
+
+    /* End the RX buffer being filled with the bytes received so far. */
+    void (* rx_flush)(void);
+
+    /* Returns, and clears, whether bytes have been received since the last call. Used to
+       flush a partly filled buffer once the line is idle. Backends that end buffers on
+       their own after each transfer always return false. */
+    bool (* rx_activity_get)(void);
+
+    /* Send TRANSPORT_EVT_RX_WAKE once for the next received byte. */
+    void (* rx_wake_enable)(void);
+
+    void (* tx)(uint8_t const * p_data, size_t length);
+
+    /* Keep the transport interrupt from preempting the caller. */
+    void (* irq_disable)(void);
+    void (* irq_enable)(void);
+
+    /* Send without interrupts, from the fault handler. Does not return until sent, if at all. */
+    void (* panic_tx)(uint8_t const * p_data, size_t length);
+
+    /* Run timers, called from the main loop on every pass. Returns true while it has to be
+       called again soon, which keeps the main loop from sleeping. May be NULL. */
+    bool (* poll)(void);
+
+    /* The link pads with 0x00 bytes between packets, which the H4 receiver skips. */
+    bool rx_idle_fill;
+} transport_t;
+
+extern const transport_t transport_uarte;
+extern const transport_t transport_spis;
+extern const transport_t transport_h5;
+extern const transport_t transport_socket;
+
+#endif // TRANSPORT_H__
@@ -0,0 +1,756 @@
+#include <string.h>
+
+#include "nrfx.h"
+#include "sdc_hci.h"
+
+#include "transport.h"
+#include "transport_h5.h"
+#include "slip.h"
+#include "crc16.h"
+
+/* Three-wire UART (H5) on top of another transport, normally the UARTE without flow control.
+
+   Packets from the host are SLIP decoded as they arrive, checked, and passed on to the H4
+   framing in main.c as H4 packets: the H5 packet type is put in front of the payload. Events
+   and ACL data from main.c come as H4 batches, which are split into packets, kept in a
+   window of H5_WINDOW_SIZE slots until the host acknowledges them, and sent again if it has
+   not within H5_RETX_TIMEOUT_MS.
+
+   Flow control is by acknowledgement: a packet from the host is only taken, and
+   acknowledged, while the previous one has been handed to main.c. Otherwise it is dropped
+   and the host sends it again. Reception from the lower transport never stops.
+
+   Link establishment (SYNC and CONFIG) is retried every H5_LINK_TIMEOUT_MS, and packets from
+   main.c are held until it completes. The negotiated window is the smaller of the two, and
+   CRCs are sent if both sides ask for them. A SYNC on an active link means the host has
+   restarted, so the window is emptied and the link established again. Low power messages
+   are not supported, WAKEUP is answered with WOKEN. */
+
+#ifndef H5_LOWER_TRANSPORT
+#define H5_LOWER_TRANSPORT transport_uarte
+#endif
+
+/* Packets sent before an acknowledgement is needed, 1 to 7. */
+#ifndef H5_WINDOW_SIZE
+#define H5_WINDOW_SIZE 4
+#endif
+
+/* Ask for a CRC on every packet. */
+#ifndef H5_CRC
+#define H5_CRC 1
+#endif
+
+#ifndef H5_RETX_TIMEOUT_MS
+#define H5_RETX_TIMEOUT_MS 40
+#endif
+#ifndef H5_LINK_TIMEOUT_MS
+#define H5_LINK_TIMEOUT_MS 250
+#endif
+
+/* Reception from the lower transport, see the H4 DMA buffers in main.c. */
+#ifndef H5_RX_DMA_BUFFER_SIZE
+#define H5_RX_DMA_BUFFER_SIZE 64
+#endif
+#ifndef H5_RX_IDLE_TIMEOUT_US
+#define H5_RX_IDLE_TIMEOUT_US 50
+#endif
+
+#if (H5_WINDOW_SIZE < 1) || (H5_WINDOW_SIZE > 7)
+#error "H5_WINDOW_SIZE must be 1 to 7"
+#endif
+
+#define H5_FRAME_MAX (H5_HEADER_SIZE + H5_PAYLOAD_MAX + H5_CRC_SIZE)
+
+/* Most bytes a frame with length bytes of payload takes on the wire. */
+#define H5_FRAME_ENCODED_MAX(length) (2 + SLIP_ENCODED_SIZE_MAX(H5_HEADER_SIZE + (length) + H5_CRC_SIZE))
+
+/* Room for two frames of the largest size, more when they are smaller. */
+#define H5_TX_BUFFER_SIZE (2 * H5_FRAME_ENCODED_MAX(H5_PAYLOAD_MAX))
+
+typedef enum
+{
+    H5_STATE_UNINITIALIZED,
+    H5_STATE_INITIALIZED,
+    H5_STATE_ACTIVE,
+} h5_state_t;
+
+/* Link control messages waiting to be sent, a bit each. */
+typedef enum
+{
+    H5_MSG_SYNC,
+    H5_MSG_SYNC_RESPONSE,
+    H5_MSG_CONFIG,
+    H5_MSG_CONFIG_RESPONSE,
+    H5_MSG_WOKEN,
+    H5_MSG_COUNT
+} h5_msg_t;
+
+static const uint8_t m_msg_sync[] = {0x01, 0x7E};
+static const uint8_t m_msg_sync_response[] = {0x02, 0x7D};
+static const uint8_t m_msg_config[] = {0x03, 0xFC};
+static const uint8_t m_msg_config_response[] = {0x04, 0x7B};
+static const uint8_t m_msg_wakeup[] = {0x05, 0xFA};
+static const uint8_t m_msg_woken[] = {0x06, 0xF9};
+
+/* Configuration field: window size, no out of frame flow control, CRC, version 1.0. */
+#define H5_CONFIG_WINDOW_MSK 0x07
+#define H5_CONFIG_CRC_MSK    0x10
+
+typedef struct
+{
+    uint8_t  type;
+    uint16_t length;
+    uint8_t  payload[H5_PAYLOAD_MAX];
+} h5_slot_t;
+
+typedef struct
+{
+    uint8_t * p_data;
+    size_t    length;
+} rx_buffer_t;
+
+static transport_t const * const m_p_lower = &H5_LOWER_TRANSPORT;
+
+static transport_evt_handler_t m_handler;
+
+static h5_state_t m_state;
+static uint8_t    m_msgs_pending;
+static uint32_t   m_link_time;          /* When SYNC or CONFIG was last sent */
+static uint8_t    m_window;             /* Negotiated window size */
+static bool       m_crc;                /* Negotiated CRC use */
+
+/* Window of packets to the host, oldest first. */
+static h5_slot_t m_tx_slots[H5_WINDOW_SIZE];
+static uint8_t   m_tx_slot_oldest;
+static uint8_t   m_tx_seq_oldest;
+static uint8_t   m_tx_queued;           /* Slots in use */
+static uint8_t   m_tx_sent;             /* Of those, sent since the last retransmission */
+static uint32_t  m_retx_time;           /* When the window last moved or was sent again */
+
+/* H4 batch from main.c, split into the window as slots become free. */
+static uint8_t const * m_p_app_tx;
+static size_t          m_app_tx_length;
+static size_t          m_app_tx_offset;
+
+static uint8_t m_lower_tx_buffer[H5_TX_BUFFER_SIZE];
+static bool    m_lower_tx_busy;
+
+static uint8_t        m_rx_frame[H5_FRAME_MAX];
+static slip_decoder_t m_slip;
+static uint8_t        m_rx_seq_expected;
+static bool           m_ack_pending;
+
+/* Packet taken from the host, as H4, until main.c has received all of it. */
+static uint8_t  m_rx_packet[1 + H5_PAYLOAD_MAX];
+static uint16_t m_rx_packet_length;
+static uint16_t m_rx_packet_offset;
+static bool     m_rx_delivering;
+
+/* RX buffers armed by main.c, the first one is being filled. */
+static rx_buffer_t m_app_rx[2];
+static uint8_t     m_app_rx_count;
+static size_t      m_app_rx_filled;
+
+static uint8_t  m_lower_rx_buffers[2][H5_RX_DMA_BUFFER_SIZE];
+static bool     m_lower_rx_armed[2];
+static bool     m_lower_rx_flushing;
+static bool     m_lower_rx_idle_pending;
+static uint32_t m_lower_rx_activity_time;
+
+
+static uint32_t m_ms_to_cycles(uint32_t ms)
+{
+    return (SystemCoreClock / 1000) * ms;
+}
+
+static uint8_t m_config_field_get(void)
+{
+    return (uint8_t)(H5_WINDOW_SIZE | (H5_CRC ? H5_CONFIG_CRC_MSK : 0));
+}
+
+/* Take the peer's configuration field, from its CONFIG or CONFIG RESPONSE. */
+static void m_config_apply(uint8_t config)
+{
+    uint8_t window = config & H5_CONFIG_WINDOW_MSK;
+
+    m_window = (window != 0 && window < H5_WINDOW_SIZE) ? window : H5_WINDOW_SIZE;
+    m_crc = H5_CRC && ((config & H5_CONFIG_CRC_MSK) != 0);
+}
+
+/* Encode one frame at p_out, and return its end. The header carries the current ack. */
+static uint8_t * m_frame_encode(uint8_t * p_out, bool reliable, uint8_t seq, uint8_t type,
+                                uint8_t const * p_payload, uint16_t length)
+{
+    uint8_t header[H5_HEADER_SIZE];
+
+    header[0] = (uint8_t)(seq | (m_rx_seq_expected << H5_HDR_ACK_POS) |
+                          (m_crc ? H5_HDR_CRC_MSK : 0) | (reliable ? H5_HDR_RELIABLE_MSK : 0));
+    header[1] = (uint8_t)(type | ((length & 0x0F) << 4));
+    header[2] = (uint8_t)(length >> 4);
+    header[3] = (uint8_t)~(header[0] + header[1] + header[2]);
+
+    *p_out++ = SLIP_END;
+    p_out = slip_encode(p_out, header, sizeof(header));
+    p_out = slip_encode(p_out, p_payload, length);
+    if (m_crc)
+    {
+        uint16_t crc = crc16_ccitt_update(CRC16_CCITT_INIT, header, sizeof(header));
+        uint8_t  crc_bytes[H5_CRC_SIZE];
+
+        crc = crc16_bit_reverse(crc16_ccitt_update(crc, p_payload, length));
+        crc_bytes[0] = (uint8_t)(crc >> 8);
+        crc_bytes[1] = (uint8_t)crc;
+        p_out = slip_encode(p_out, crc_bytes, sizeof(crc_bytes));
+    }
+    *p_out++ = SLIP_END;
+
+    m_ack_pending = false;
+    return p_out;
+}
+
+static uint8_t * m_link_msgs_encode(uint8_t * p_out)
+{
+    static uint8_t const * const msgs[H5_MSG_COUNT] =
+        {
+            [H5_MSG_SYNC] = m_msg_sync,
+            [H5_MSG_SYNC_RESPONSE] = m_msg_sync_response,
+            [H5_MSG_CONFIG] = m_msg_config,
+            [H5_MSG_CONFIG_RESPONSE] = m_msg_config_response,
+            [H5_MSG_WOKEN] = m_msg_woken,
+        };
+
+    for (uint8_t i = 0; i < H5_MSG_COUNT; i++)
+    {
+        if (m_msgs_pending & (1U << i))
+        {
+            uint8_t msg[3] = {msgs[i][0], msgs[i][1], m_config_field_get()};
+            bool    config = (i == H5_MSG_CONFIG) || (i == H5_MSG_CONFIG_RESPONSE);
+
+            m_msgs_pending &= (uint8_t)~(1U << i);
+            p_out = m_frame_encode(p_out, false, 0, H5_TYPE_LINK_CONTROL, msg, config ? 3 : 2);
+        }
+    }
+    return p_out;
+}
+
+/* Send whatever is due, unless the lower transport is busy: link control messages, packets
+   of the window not sent yet, or else a bare acknowledgement. */
+static void m_tx_kick(void)
+{
+    uint8_t * p_start = m_lower_tx_buffer;
+    uint8_t * p_end = &m_lower_tx_buffer[H5_TX_BUFFER_SIZE];
+    uint8_t * p_out = p_start;
+
+    if (m_lower_tx_busy)
+    {
+        return;
+    }
+
+    p_out = m_link_msgs_encode(p_out);
+
+    while (m_state == H5_STATE_ACTIVE && m_tx_sent < m_tx_queued && m_tx_sent < m_window)
+    {
+        h5_slot_t * p_slot = &m_tx_slots[(m_tx_slot_oldest + m_tx_sent) % H5_WINDOW_SIZE];
+
+        if ((size_t)(p_end - p_out) < H5_FRAME_ENCODED_MAX(p_slot->length))
+        {
+            break;
+        }
+
+        p_out = m_frame_encode(p_out, true, (m_tx_seq_oldest + m_tx_sent) & H5_SEQ_MASK,
+                               p_slot->type, p_slot->payload, p_slot->length);
+        if (m_tx_sent == 0)
+        {
+            m_retx_time = DWT->CYCCNT;
+        }
+        m_tx_sent++;
+    }
+
+    if (p_out == p_start && m_ack_pending && m_state == H5_STATE_ACTIVE)
+    {
+        p_out = m_frame_encode(p_out, false, 0, H5_TYPE_ACK, NULL, 0);
+    }
+
+    if (p_out != p_start)
+    {
+        m_lower_tx_busy = true;
+        m_p_lower->tx(p_start, (size_t)(p_out - p_start));
+    }
+}
+
+/* Length of the H4 packet at p_h4, 0 if it is not one that is sent to the host. */
+static size_t m_h4_packet_length_get(uint8_t const * p_h4, size_t available)
+{
+    size_t length = 0;
+
+    switch (p_h4[0])
+    {
+    case H5_TYPE_EVENT:
+        length = (available >= 1 + HCI_EVT_HEADER_SIZE) ? (1 + HCI_EVT_HEADER_SIZE + p_h4[2]) : 0;
+        break;
+    case H5_TYPE_ACL_DATA:
+        length = (available >= 1 + HCI_DATA_HEADER_SIZE) ? (1 + HCI_DATA_HEADER_SIZE + (p_h4[3] | (p_h4[4] << 8))) : 0;
+        break;
+    default:
+        break;
+    }
+
+    return (length <= available && length - 1 <= H5_PAYLOAD_MAX) ? length : 0;
+}
+
+/* Move packets of the H4 batch into free window slots. TX_DONE is given once all of them
+   are in the window. */
+static void m_app_tx_consume(void)
+{
+    transport_evt_t evt = {.type = TRANSPORT_EVT_TX_DONE};
+
+    if (m_p_app_tx == NULL)
+    {
+        return;
+    }
+
+    while (m_app_tx_offset < m_app_tx_length && m_tx_queued < H5_WINDOW_SIZE)
+    {
+        uint8_t const * p_h4 = &m_p_app_tx[m_app_tx_offset];
+        size_t          length = m_h4_packet_length_get(p_h4, m_app_tx_length - m_app_tx_offset);
+        h5_slot_t *     p_slot = &m_tx_slots[(m_tx_slot_oldest + m_tx_queued) % H5_WINDOW_SIZE];
+
+        if (length == 0)
+        {
+            break;
+        }
+
+        p_slot->type = p_h4[0];
+        p_slot->length = (uint16_t)(length - 1);
+        memcpy(p_slot->payload, &p_h4[1], length - 1);
+        m_tx_queued++;
+        m_app_tx_offset += length;
+    }
+
+    if (m_app_tx_offset < m_app_tx_length && m_tx_queued < H5_WINDOW_SIZE)
+    {
+        /* Stopped on something that is not a packet, the rest of the batch is dropped. */
+        m_app_tx_offset = m_app_tx_length;
+    }
+
+    m_tx_kick();
+
+    if (m_app_tx_offset == m_app_tx_length)
+    {
+        evt.p_data = (uint8_t *)m_p_app_tx;
+        evt.bytes = m_app_tx_length;
+        m_p_app_tx = NULL;
+        m_handler(&evt);
+    }
+}
+
+/* Drop the window and restart the sequence numbers, for a new link. */
+static void m_window_reset(void)
+{
+    m_tx_slot_oldest = 0;
+    m_tx_seq_oldest = 0;
+    m_tx_queued = 0;
+    m_tx_sent = 0;
+    m_rx_seq_expected = 0;
+    m_ack_pending = false;
+}
+
+static void m_tx_ack_process(uint8_t ack)
+{
+    uint8_t acked = (ack - m_tx_seq_oldest) & H5_SEQ_MASK;
+
+    if (acked == 0 || acked > m_tx_sent)
+    {
+        return;
+    }
+
+    m_tx_slot_oldest = (m_tx_slot_oldest + acked) % H5_WINDOW_SIZE;
+    m_tx_seq_oldest = ack;
+    m_tx_queued -= acked;
+    m_tx_sent -= acked;
+    m_retx_time = DWT->CYCCNT;
+
+    m_app_tx_consume();
+}
+
+/* Hand the packet taken from the host to main.c, as far as it has buffers armed. A buffer
+   ends when it is full, or before that at the end of the packet. */
+static void m_rx_deliver(void)
+{
+    if (m_rx_delivering)
+    {
+        /* Called back from the handler below, the loop carries on with the new buffer. */
+        return;
+    }
+    m_rx_delivering = true;
+
+    while (m_rx_packet_offset < m_rx_packet_length && m_app_rx_count > 0)
+    {
+        transport_evt_t evt = {.type = TRANSPORT_EVT_RX_DONE};
+        rx_buffer_t *   p_buffer = &m_app_rx[0];
+        size_t          chunk = p_buffer->length - m_app_rx_filled;
+
+        if (chunk > (size_t)(m_rx_packet_length - m_rx_packet_offset))
+        {
+            chunk = m_rx_packet_length - m_rx_packet_offset;
+        }
+        memcpy(&p_buffer->p_data[m_app_rx_filled], &m_rx_packet[m_rx_packet_offset], chunk);
+        m_app_rx_filled += chunk;
+        m_rx_packet_offset += chunk;
+
+        evt.p_data = p_buffer->p_data;
+        evt.bytes = m_app_rx_filled;
+        if (m_app_rx_filled == p_buffer->length)
+        {
+            m_app_rx[0] = m_app_rx[1];
+            m_app_rx_count--;
+        }
+        else if (m_rx_packet_offset == m_rx_packet_length)
+        {
+            /* Ended before it was full, which drops the chained buffer. */
+            m_app_rx_count = 0;
+        }
+        else
+        {
+            continue;
+        }
+        m_app_rx_filled = 0;
+        m_handler(&evt);
+    }
+
+    m_rx_delivering = false;
+}
+
+static void m_link_control_process(uint8_t const * p_msg, uint16_t length)
+{
+    if (length < 2)
+    {
+        return;
+    }
+
+    if (memcmp(p_msg, m_msg_sync, 2) == 0)
+    {
+        if (m_state == H5_STATE_ACTIVE)
+        {
+            /* The host has restarted. */
+            m_window_reset();
+            m_state = H5_STATE_UNINITIALIZED;
+        }
+        m_msgs_pending |= 1U << H5_MSG_SYNC_RESPONSE;
+    }
+    else if (memcmp(p_msg, m_msg_sync_response, 2) == 0)
+    {
+        if (m_state == H5_STATE_UNINITIALIZED)
+        {
+            m_state = H5_STATE_INITIALIZED;
+            m_msgs_pending |= 1U << H5_MSG_CONFIG;
+            m_link_time = DWT->CYCCNT;
+        }
+    }
+    else if (memcmp(p_msg, m_msg_config, 2) == 0)
+    {
+        if (m_state != H5_STATE_UNINITIALIZED)
+        {
+            m_config_apply((length >= 3) ? p_msg[2] : 0);
+            m_msgs_pending |= 1U << H5_MSG_CONFIG_RESPONSE;
+        }
+    }
+    else if (memcmp(p_msg, m_msg_config_response, 2) == 0)
+    {
+        if (m_state == H5_STATE_INITIALIZED)
+        {
+            m_config_apply((length >= 3) ? p_msg[2] : 0);
+            m_state = H5_STATE_ACTIVE;
+        }
+    }
+    else if (memcmp(p_msg, m_msg_wakeup, 2) == 0)
+    {
+        m_msgs_pending |= 1U << H5_MSG_WOKEN;
+    }
+}
+
+/* Check a decoded frame and act on it. Broken frames are dropped without a word, the host
+   sends reliable packets again when they are not acknowledged. */
+static void m_rx_frame_process(uint8_t const * p_frame, size_t length)
+{
+    uint16_t payload_length;
+    bool     crc_present;
+    bool     reliable;
+    uint8_t  type;
+
+    if (length < H5_HEADER_SIZE || (uint8_t)(p_frame[0] + p_frame[1] + p_frame[2] + p_frame[3]) != 0xFF)
+    {
+        return;
+    }
+
+    payload_length = (uint16_t)((p_frame[1] >> 4) | (p_frame[2] << 4));
+    crc_present = (p_frame[0] & H5_HDR_CRC_MSK) != 0;
+    reliable = (p_frame[0] & H5_HDR_RELIABLE_MSK) != 0;
+    type = p_frame[1] & 0x0F;
+
+    /* A frame without CRC fits in m_rx_frame with up to two bytes more payload than a packet
+       can hold. */
+    if (length != H5_HEADER_SIZE + payload_length + (crc_present ? H5_CRC_SIZE : 0u) ||
+        payload_length > H5_PAYLOAD_MAX)
+    {
+        return;
+    }
+
+    if (crc_present)
+    {
+        uint16_t crc = crc16_bit_reverse(crc16_ccitt_update(CRC16_CCITT_INIT, p_frame, length - H5_CRC_SIZE));
+
+        if (crc != (uint16_t)((p_frame[length - 2] << 8) | p_frame[length - 1]))
+        {
+            return;
+        }
+    }
+
+    if (type == H5_TYPE_LINK_CONTROL)
+    {
+        m_link_control_process(&p_frame[H5_HEADER_SIZE], payload_length);
+        return;
+    }
+
+    if (m_state != H5_STATE_ACTIVE)
+    {
+        return;
+    }
+
+    m_tx_ack_process((p_frame[0] >> H5_HDR_ACK_POS) & H5_SEQ_MASK);
+
+    if (!reliable)
+    {
+        return;
+    }
+
+    /* Acknowledge in every case, so that the host learns which packet is expected. */
+    m_ack_pending = true;
+
+    if ((p_frame[0] & H5_SEQ_MASK) != m_rx_seq_expected ||
+        m_rx_packet_offset < m_rx_packet_length ||
+        (type != H5_TYPE_COMMAND && type != H5_TYPE_ACL_DATA))
+    {
+        return;
+    }
+
+    m_rx_packet[0] = type;
+    memcpy(&m_rx_packet[1], &p_frame[H5_HEADER_SIZE], payload_length);
+    m_rx_packet_length = (uint16_t)(1 + payload_length);
+    m_rx_packet_offset = 0;
+    m_rx_seq_expected = (m_rx_seq_expected + 1) & H5_SEQ_MASK;
+}
+
+static void m_lower_rx_arm(void)
+{
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        if (!m_lower_rx_armed[i])
+        {
+            m_lower_rx_armed[i] = true;
+            m_p_lower->rx_arm(m_lower_rx_buffers[i], H5_RX_DMA_BUFFER_SIZE);
+        }
+    }
+}
+
+static void m_on_lower_rx_done(transport_evt_t const * p_evt)
+{
+    uint8_t index = (p_evt->p_data == m_lower_rx_buffers[0]) ? 0 : 1;
+    size_t  consumed = 0;
+
+    while (consumed < p_evt->bytes)
+    {
+        bool frame_end;
+
+        consumed += slip_decode(&m_slip, &p_evt->p_data[consumed], p_evt->bytes - consumed, &frame_end);
+        if (frame_end)
+        {
+            m_rx_frame_process(m_rx_frame, m_slip.length);
+        }
+    }
+
+    m_lower_rx_armed[index] = false;
+    if (p_evt->type == TRANSPORT_EVT_RX_ERROR)
+    {
+        /* Bytes were lost, the frame being received is broken. */
+        slip_decoder_init(&m_slip, m_rx_frame, sizeof(m_rx_frame));
+    }
+    if (p_evt->bytes < H5_RX_DMA_BUFFER_SIZE || p_evt->type == TRANSPORT_EVT_RX_ERROR)
+    {
+        /* The chained buffer has been dropped too. */
+        m_lower_rx_armed[0] = false;
+        m_lower_rx_armed[1] = false;
+        m_lower_rx_flushing = false;
+    }
+    m_lower_rx_arm();
+
+    m_rx_deliver();
+    m_tx_kick();
+}
+
+static void m_lower_event_handler(transport_evt_t const * p_evt)
+{
+    transport_evt_t wake = {.type = TRANSPORT_EVT_RX_WAKE};
+
+    switch (p_evt->type)
+    {
+    case TRANSPORT_EVT_TX_DONE:
+        m_lower_tx_busy = false;
+        m_tx_kick();
+        break;
+    case TRANSPORT_EVT_RX_DONE:
+    case TRANSPORT_EVT_RX_ERROR:
+        m_on_lower_rx_done(p_evt);
+        break;
+    case TRANSPORT_EVT_RX_WAKE:
+        break;
+    case TRANSPORT_EVT_DRIVER_ERROR:
+        m_handler(p_evt);
+        break;
+    }
+
+    /* Let the main loop run m_poll again. */
+    m_handler(&wake);
+}
+
+static void m_open(transport_evt_handler_t handler, uint8_t irq_priority)
+{
+    m_handler = handler;
+
+    slip_decoder_init(&m_slip, m_rx_frame, sizeof(m_rx_frame));
+    m_window_reset();
+    m_window = H5_WINDOW_SIZE;
+    m_crc = false;
+    m_state = H5_STATE_UNINITIALIZED;
+    m_msgs_pending = 1U << H5_MSG_SYNC;
+    m_link_time = DWT->CYCCNT;
+
+    m_p_lower->open(m_lower_event_handler, irq_priority);
+
+    m_p_lower->irq_disable();
+    m_lower_rx_arm();
+    m_tx_kick();
+    m_p_lower->irq_enable();
+}
+
+/* Flush a partly filled lower buffer once the line has been idle, resend link establishment
+   messages, and resend the window when it has not been acknowledged in time. */
+static bool m_poll(void)
+{
+    uint32_t now = DWT->CYCCNT;
+    bool     busy;
+    bool     lower_busy = (m_p_lower->poll != NULL) && m_p_lower->poll();
+
+    if (m_p_lower->rx_activity_get())
+    {
+        m_lower_rx_activity_time = now;
+        m_lower_rx_idle_pending = true;
+    }
+
+    m_p_lower->irq_disable();
+
+    if (m_lower_rx_idle_pending &&
+        (now - m_lower_rx_activity_time) >= (SystemCoreClock / 1000000) * H5_RX_IDLE_TIMEOUT_US)
+    {
+        m_lower_rx_idle_pending = false;
+        if (!m_lower_rx_flushing)
+        {
+            m_lower_rx_flushing = true;
+            m_p_lower->rx_flush();
+        }
+    }
+
+    if (m_state != H5_STATE_ACTIVE && (now - m_link_time) >= m_ms_to_cycles(H5_LINK_TIMEOUT_MS))
+    {
+        m_msgs_pending |= 1U << ((m_state == H5_STATE_UNINITIALIZED) ? H5_MSG_SYNC : H5_MSG_CONFIG);
+        m_link_time = now;
+    }
+
+    if (m_state == H5_STATE_ACTIVE && m_tx_sent > 0 && (now - m_retx_time) >= m_ms_to_cycles(H5_RETX_TIMEOUT_MS))
+    {
+        /* Go back to the oldest packet not acknowledged. */
+        m_tx_sent = 0;
+    }
+
+    m_app_tx_consume();
+    m_tx_kick();
+
+    busy = lower_busy || m_lower_rx_idle_pending || (m_state != H5_STATE_ACTIVE) || (m_tx_sent > 0);
+
+    m_p_lower->irq_enable();
+
+    return busy;
+}
+
+static void m_rx_arm(uint8_t * p_data, size_t length)
+{
+    if (m_app_rx_count < 2)
+    {
+        m_app_rx[m_app_rx_count].p_data = p_data;
+        m_app_rx[m_app_rx_count].length = length;
+        m_app_rx_count++;
+        m_rx_deliver();
+    }
+}
+
+/* Packets are handed over whole, so there is nothing to flush. */
+static void m_rx_flush(void)
+{
+}
+
+static bool m_rx_activity_get(void)
+{
+    return false;
+}
+
+static void m_rx_wake_enable(void)
+{
+    m_p_lower->rx_wake_enable();
+}
+
+static void m_tx(uint8_t const * p_data, size_t length)
+{
+    m_p_app_tx = p_data;
+    m_app_tx_length = length;
+    m_app_tx_offset = 0;
+    m_app_tx_consume();
+}
+
+static void m_irq_disable(void)
+{
+    m_p_lower->irq_disable();
+}
+
+static void m_irq_enable(void)
+{
+    m_p_lower->irq_enable();
+}
+
+/* Sent as an unreliable packet, there is no one to wait for the acknowledgement. */
+static void m_panic_tx(uint8_t const * p_data, size_t length)
+{
+    uint8_t * p_out;
+
+    if (length < 1 || length - 1 > H5_PAYLOAD_MAX)
+    {
+        return;
+    }
+
+    p_out = m_frame_encode(m_lower_tx_buffer, false, 0, p_data[0], &p_data[1], (uint16_t)(length - 1));
+    m_p_lower->panic_tx(m_lower_tx_buffer, (size_t)(p_out - m_lower_tx_buffer));
+}
+
+const transport_t transport_h5 =
+    {
+        .open = m_open,
+        .rx_arm = m_rx_arm,
+        .rx_flush = m_rx_flush,
+        .rx_activity_get = m_rx_activity_get,
+        .rx_wake_enable = m_rx_wake_enable,
+        .tx = m_tx,
+        .irq_disable = m_irq_disable,
+        .irq_enable = m_irq_enable,
+        .panic_tx = m_panic_tx,
+        .poll = m_poll,
+        .rx_idle_fill = false,
+};
@@ -0,0 +1,30 @@
+#ifndef TRANSPORT_H5_H__
+#define TRANSPORT_H5_H__
+
+#include "sdc_hci.h"
+
+/* Wire format of the Three-wire UART (H5), see the Core specification Vol 4, Part D, and
+   transport_h5.c. A packet is a 4 byte header, up to H5_PAYLOAD_MAX bytes of payload and
+   an optional CRC, SLIP framed. */
+#define H5_HEADER_SIZE  4u
+#define H5_CRC_SIZE     2u
+#define H5_PAYLOAD_MAX  HCI_MSG_BUFFER_MAX_SIZE
+
+#define H5_SEQ_MASK 0x07
+
+/* Header byte 0 */
+#define H5_HDR_ACK_POS      3
+#define H5_HDR_CRC_MSK      0x40
+#define H5_HDR_RELIABLE_MSK 0x80
+
+typedef enum
+{
+    H5_TYPE_ACK = 0,
+    H5_TYPE_COMMAND = 1,
+    H5_TYPE_ACL_DATA = 2,
+    H5_TYPE_SYNCHRONOUS_DATA = 3,
+    H5_TYPE_EVENT = 4,
+    H5_TYPE_LINK_CONTROL = 15,
+} h5_type_t;
+
+#endif // TRANSPORT_H5_H__
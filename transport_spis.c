@@ -0,0 +1,296 @@
+#include "nrfx_spis.h"
+#include "hal/nrf_gpio.h"
+
+#include "transport.h"
+
+/* Transport over SPIS1, for hosts that can clock the link faster than the UART runs.
+
+   SPI is full duplex and clocked by the host, so the slave needs two lines to tell the host
+   when to start a transaction:
+   - READY is high while an RX buffer is set up, the host may then send data.
+   - PENDING is high while there is data to send, the host should then start a transaction,
+     clocking out 0x00 padding if it has nothing to send itself.
+   The host must not send data while READY is low. Both sides pad with 0x00 after the last
+   packet of a transaction, which the receivers skip. The SPIS semaphore is only handed over
+   with buffers set, so a transaction always sees buffers that the backend knows about.
+
+   Each transaction ends the RX buffer, like a flush, unless it filled the buffer. A TX buffer
+   longer than the host clocks in one transaction is continued in the next ones. Data queued
+   while buffers are set waits for the transaction after the next one. */
+
+#ifndef TRANSPORT_SPIS_SCK_PIN
+#define TRANSPORT_SPIS_SCK_PIN 6
+#endif
+#ifndef TRANSPORT_SPIS_MOSI_PIN
+#define TRANSPORT_SPIS_MOSI_PIN 8
+#endif
+#ifndef TRANSPORT_SPIS_MISO_PIN
+#define TRANSPORT_SPIS_MISO_PIN 7
+#endif
+#ifndef TRANSPORT_SPIS_CSN_PIN
+#define TRANSPORT_SPIS_CSN_PIN 5
+#endif
+#ifndef TRANSPORT_SPIS_READY_PIN
+#define TRANSPORT_SPIS_READY_PIN 26
+#endif
+#ifndef TRANSPORT_SPIS_PENDING_PIN
+#define TRANSPORT_SPIS_PENDING_PIN 27
+#endif
+
+#define SPIS_PAD     0x00   /* Sent after the TX data, see H4_IDLE_FILL */
+#define SPIS_NOT_SET 0xFF   /* Sent when the host ignores READY and PENDING */
+
+#define RX_BUFFER_COUNT 2
+
+typedef struct
+{
+    uint8_t * p_data;
+    size_t    length;
+} rx_buffer_t;
+
+static transport_evt_handler_t m_handler;
+
+static const nrfx_spis_t m_spis = NRFX_SPIS_INSTANCE(1);
+
+static rx_buffer_t m_rx[RX_BUFFER_COUNT];   /* Armed buffers, the first one is set up next */
+static uint8_t     m_rx_count;
+static size_t      m_rx_set;                /* RX length of the buffers set, 0 if none */
+
+static uint8_t const * m_p_tx;
+static size_t          m_tx_length;
+static size_t          m_tx_done;
+static size_t          m_tx_set;            /* TX length of the buffers set */
+
+static volatile bool m_buffers_set;         /* Buffers set until the transaction ends */
+static volatile bool m_buffers_failed;      /* The driver refused the last buffers, see m_poll */
+
+/* Set up the next transaction, if there is something to receive into or to send. Called from
+   the SPIS interrupt, or with it disabled. */
+static void m_buffers_update(void)
+{
+    size_t     rx_length = (m_rx_count > 0) ? m_rx[0].length : 0;
+    nrfx_err_t err_code;
+
+    if (m_buffers_set || (rx_length == 0 && m_tx_done == m_tx_length))
+    {
+        return;
+    }
+
+    m_rx_set = rx_length;
+    m_tx_set = m_tx_length - m_tx_done;
+    m_buffers_set = true;
+    err_code = nrfx_spis_buffers_set(&m_spis,
+                                     (m_tx_set > 0) ? &m_p_tx[m_tx_done] : NULL, m_tx_set,
+                                     (m_rx_set > 0) ? m_rx[0].p_data : NULL, m_rx_set);
+    m_buffers_failed = (err_code != NRFX_SUCCESS);
+    if (m_buffers_failed)
+    {
+        transport_evt_t evt = {.type = TRANSPORT_EVT_DRIVER_ERROR};
+
+        /* No transaction will end to set them up again, so m_poll does. */
+        m_buffers_set = false;
+        m_handler(&evt);
+    }
+}
+
+static void m_on_xfer_done(size_t rx_amount, size_t tx_amount)
+{
+    transport_evt_t rx_evt = {.type = TRANSPORT_EVT_RX_DONE};
+    transport_evt_t tx_evt = {.type = TRANSPORT_EVT_TX_DONE};
+
+    m_buffers_set = false;
+    nrf_gpio_pin_clear(TRANSPORT_SPIS_READY_PIN);
+
+    /* Both buffers are accounted for before the handler can arm or send new ones. */
+    if (m_rx_set > 0 && rx_amount > 0)
+    {
+        rx_evt.p_data = m_rx[0].p_data;
+        rx_evt.bytes = (rx_amount < m_rx_set) ? rx_amount : m_rx_set;
+
+        if (rx_evt.bytes == m_rx_set)
+        {
+            m_rx[0] = m_rx[1];
+            m_rx_count--;
+        }
+        else
+        {
+            /* Ended before it was full, which drops the chained buffer. */
+            m_rx_count = 0;
+        }
+    }
+
+    if (m_tx_set > 0)
+    {
+        m_tx_done += (tx_amount < m_tx_set) ? tx_amount : m_tx_set;
+        if (m_tx_done == m_tx_length)
+        {
+            nrf_gpio_pin_clear(TRANSPORT_SPIS_PENDING_PIN);
+
+            tx_evt.p_data = (uint8_t *)m_p_tx;
+            tx_evt.bytes = m_tx_length;
+            m_tx_length = 0;
+            m_tx_done = 0;
+        }
+    }
+
+    if (rx_evt.p_data != NULL)
+    {
+        m_handler(&rx_evt);
+    }
+    if (tx_evt.p_data != NULL)
+    {
+        m_handler(&tx_evt);
+    }
+
+    m_buffers_update();
+}
+
+static void m_spis_event_handler(nrfx_spis_evt_t const * p_event, void * p_context)
+{
+    (void)p_context;
+
+    switch (p_event->evt_type)
+    {
+    case NRFX_SPIS_BUFFERS_SET_DONE:
+        if (m_rx_set > 0)
+        {
+            nrf_gpio_pin_set(TRANSPORT_SPIS_READY_PIN);
+        }
+        break;
+    case NRFX_SPIS_XFER_DONE:
+        m_on_xfer_done(p_event->rx_amount, p_event->tx_amount);
+        break;
+    default:
+        break;
+    }
+}
+
+static void m_spis_init(nrfx_spis_event_handler_t handler, uint8_t irq_priority)
+{
+    nrfx_spis_config_t config =
+        {
+            .miso_pin = TRANSPORT_SPIS_MISO_PIN,
+            .mosi_pin = TRANSPORT_SPIS_MOSI_PIN,
+            .sck_pin = TRANSPORT_SPIS_SCK_PIN,
+            .csn_pin = TRANSPORT_SPIS_CSN_PIN,
+            .mode = NRF_SPIS_MODE_0,
+            .bit_order = NRF_SPIS_BIT_ORDER_MSB_FIRST,
+            .csn_pullup = NRF_GPIO_PIN_NOPULL,
+            .miso_drive = NRF_GPIO_PIN_S0S1,
+            .def = SPIS_NOT_SET,
+            .orc = SPIS_PAD,
+            .irq_priority = irq_priority,
+        };
+
+    (void)nrfx_spis_init(&m_spis, &config, handler, NULL);
+}
+
+static void m_open(transport_evt_handler_t handler, uint8_t irq_priority)
+{
+    m_handler = handler;
+
+    nrf_gpio_pin_clear(TRANSPORT_SPIS_READY_PIN);
+    nrf_gpio_cfg_output(TRANSPORT_SPIS_READY_PIN);
+    nrf_gpio_pin_clear(TRANSPORT_SPIS_PENDING_PIN);
+    nrf_gpio_cfg_output(TRANSPORT_SPIS_PENDING_PIN);
+
+    m_spis_init(m_spis_event_handler, irq_priority);
+}
+
+static void m_rx_arm(uint8_t * p_data, size_t length)
+{
+    if (m_rx_count < RX_BUFFER_COUNT)
+    {
+        m_rx[m_rx_count].p_data = p_data;
+        m_rx[m_rx_count].length = length;
+        m_rx_count++;
+        m_buffers_update();
+    }
+}
+
+/* Every transaction ends the RX buffer, so there is nothing to flush. */
+static void m_rx_flush(void)
+{
+}
+
+static bool m_rx_activity_get(void)
+{
+    return false;
+}
+
+/* The end of each transaction is an interrupt already. */
+static void m_rx_wake_enable(void)
+{
+}
+
+static void m_tx(uint8_t const * p_data, size_t length)
+{
+    m_p_tx = p_data;
+    m_tx_length = length;
+    m_tx_done = 0;
+
+    nrf_gpio_pin_set(TRANSPORT_SPIS_PENDING_PIN);
+    m_buffers_update();
+}
+
+static void m_irq_disable(void)
+{
+    NVIC_DisableIRQ(SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn);
+}
+
+static void m_irq_enable(void)
+{
+    NVIC_EnableIRQ(SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQn);
+}
+
+/* Retry buffers the driver refused. */
+static bool m_poll(void)
+{
+    bool failed;
+
+    m_irq_disable();
+    if (m_buffers_failed)
+    {
+        m_buffers_update();
+    }
+    failed = m_buffers_failed;
+    m_irq_enable();
+
+    return failed;
+}
+
+static void m_panic_event_handler(nrfx_spis_evt_t const * p_event, void * p_context)
+{
+    (void)p_event;
+    (void)p_context;
+}
+
+/* Leave the data set up for the host to read, the fault handler does not return. */
+static void m_panic_tx(uint8_t const * p_data, size_t length)
+{
+    nrfx_spis_uninit(&m_spis);
+    m_spis_init(m_panic_event_handler, 0);
+    (void)nrfx_spis_buffers_set(&m_spis, p_data, length, NULL, 0);
+    nrf_gpio_pin_clear(TRANSPORT_SPIS_READY_PIN);
+    nrf_gpio_pin_set(TRANSPORT_SPIS_PENDING_PIN);
+}
+
+const transport_t transport_spis =
+    {
+        .open = m_open,
+        .rx_arm = m_rx_arm,
+        .rx_flush = m_rx_flush,
+        .rx_activity_get = m_rx_activity_get,
+        .rx_wake_enable = m_rx_wake_enable,
+        .tx = m_tx,
+        .irq_disable = m_irq_disable,
+        .irq_enable = m_irq_enable,
+        .panic_tx = m_panic_tx,
+        .poll = m_poll,
+        .rx_idle_fill = true,
+};
+
+void SPIM1_SPIS1_TWIM1_TWIS1_SPI1_TWI1_IRQHandler(void)
+{
+    nrfx_spis_1_irq_handler();
+}
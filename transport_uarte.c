@@ -0,0 +1,175 @@
+#include "nrfx_uarte.h"
+
+#include "transport.h"
+#include "ramfunc.h"
+
+/* Transport over UARTE0 with hardware flow control. Reception stops when no buffer is armed,
+   and RTS then holds off the host. Set TRANSPORT_UARTE_HWFC to 0 for boards that only route
+   TXD and RXD, for H5 which does without flow control lines. */
+
+#ifndef TRANSPORT_UARTE_HWFC
+#define TRANSPORT_UARTE_HWFC 1
+#endif
+
+static transport_evt_handler_t m_handler;
+
+static nrfx_uarte_t uarte_instance = {.p_reg = NRF_UARTE0};
+
+static nrfx_uarte_config_t uarte_config =
+    {
+#if TRANSPORT_UARTE_HWFC
+        .pselrts = 5,
+        .pselcts = 7,
+#else
+        .pselrts = NRF_UARTE_PSEL_DISCONNECTED,
+        .pselcts = NRF_UARTE_PSEL_DISCONNECTED,
+#endif
+        .pseltxd = 6,
+        .pselrxd = 8,
+        .p_context = NULL,
+        .baudrate = NRF_UARTE_BAUDRATE_1000000,
+        .interrupt_priority = 2,
+        .hal_cfg = {
+            .hwfc = TRANSPORT_UARTE_HWFC ? NRF_UARTE_HWFC_ENABLED : NRF_UARTE_HWFC_DISABLED,
+            .parity = NRF_UARTE_PARITY_EXCLUDED,
+#if defined(UARTE_CONFIG_STOP_Msk)
+            .stop = NRF_UARTE_STOP_ONE,
+#endif
+        },
+};
+
+static uint32_t m_error_mask_get(uint32_t errorsrc)
+{
+    uint32_t error_mask = 0;
+
+    error_mask |= (errorsrc & NRF_UARTE_ERROR_OVERRUN_MASK) ? TRANSPORT_ERROR_OVERRUN : 0;
+    error_mask |= (errorsrc & NRF_UARTE_ERROR_PARITY_MASK) ? TRANSPORT_ERROR_PARITY : 0;
+    error_mask |= (errorsrc & NRF_UARTE_ERROR_FRAMING_MASK) ? TRANSPORT_ERROR_FRAMING : 0;
+    error_mask |= (errorsrc & NRF_UARTE_ERROR_BREAK_MASK) ? TRANSPORT_ERROR_BREAK : 0;
+
+    /* The driver has stopped reception either way, so an error is always reported. */
+    return (error_mask != 0) ? error_mask : TRANSPORT_ERROR_FRAMING;
+}
+
+RAMFUNC static void m_uarte_event_handler(nrfx_uarte_event_t const *p_event,
+                                          void *p_context)
+{
+    transport_evt_t evt = {0};
+
+    (void)p_context;
+
+    switch (p_event->type)
+    {
+    case NRFX_UARTE_EVT_TX_DONE:
+        evt.type = TRANSPORT_EVT_TX_DONE;
+        evt.p_data = p_event->data.rxtx.p_data;
+        evt.bytes = p_event->data.rxtx.bytes;
+        break;
+    case NRFX_UARTE_EVT_RX_DONE:
+        evt.type = TRANSPORT_EVT_RX_DONE;
+        evt.p_data = p_event->data.rxtx.p_data;
+        evt.bytes = p_event->data.rxtx.bytes;
+        break;
+    case NRFX_UARTE_EVT_ERROR:
+        evt.type = TRANSPORT_EVT_RX_ERROR;
+        evt.p_data = p_event->data.error.rxtx.p_data;
+        evt.bytes = p_event->data.error.rxtx.bytes;
+        evt.error_mask = m_error_mask_get(p_event->data.error.error_mask);
+        break;
+    default:
+        return;
+    }
+
+    m_handler(&evt);
+}
+
+static void m_open(transport_evt_handler_t handler, uint8_t irq_priority)
+{
+    m_handler = handler;
+    uarte_config.interrupt_priority = irq_priority;
+
+    nrfx_uarte_uninit(&uarte_instance);
+    (void)nrfx_uarte_init(&uarte_instance, &uarte_config, m_uarte_event_handler);
+}
+
+static void m_rx_arm(uint8_t * p_data, size_t length)
+{
+    /* The second buffer is chained to the first with the ENDRX->STARTRX short. */
+    (void)nrfx_uarte_rx(&uarte_instance, p_data, length);
+}
+
+static void m_rx_flush(void)
+{
+    nrfx_uarte_rx_abort(&uarte_instance);
+}
+
+/* There is no idle line event, so RXDRDY is polled. */
+static bool m_rx_activity_get(void)
+{
+    if (nrf_uarte_event_check(uarte_instance.p_reg, NRF_UARTE_EVENT_RXDRDY))
+    {
+        nrf_uarte_event_clear(uarte_instance.p_reg, NRF_UARTE_EVENT_RXDRDY);
+        return true;
+    }
+    return false;
+}
+
+/* The RXDRDY event is left set for m_rx_activity_get. */
+static void m_rx_wake_enable(void)
+{
+    nrf_uarte_int_enable(uarte_instance.p_reg, NRF_UARTE_INT_RXDRDY_MASK);
+}
+
+static void m_tx(uint8_t const * p_data, size_t length)
+{
+    (void)nrfx_uarte_tx(&uarte_instance, p_data, length);
+}
+
+static void m_irq_disable(void)
+{
+    NVIC_DisableIRQ(UARTE0_UART0_IRQn);
+}
+
+static void m_irq_enable(void)
+{
+    NVIC_EnableIRQ(UARTE0_UART0_IRQn);
+}
+
+/* Re-initialize the UART to be used in blocking mode. */
+static void m_panic_tx(uint8_t const * p_data, size_t length)
+{
+    nrfx_uarte_uninit(&uarte_instance);
+    (void)nrfx_uarte_init(&uarte_instance, &uarte_config, NULL);
+    (void)nrfx_uarte_tx(&uarte_instance, p_data, length);
+}
+
+const transport_t transport_uarte =
+    {
+        .open = m_open,
+        .rx_arm = m_rx_arm,
+        .rx_flush = m_rx_flush,
+        .rx_activity_get = m_rx_activity_get,
+        .rx_wake_enable = m_rx_wake_enable,
+        .tx = m_tx,
+        .irq_disable = m_irq_disable,
+        .irq_enable = m_irq_enable,
+        .panic_tx = m_panic_tx,
+        .poll = NULL,
+        .rx_idle_fill = false,
+};
+
+RAMFUNC void UARTE0_UART0_IRQHandler(void)
+{
+    /* RXDRDY is only enabled as a wake source while the main loop sleeps, and is not
+       handled by the driver. */
+    if (nrf_uarte_int_enable_check(uarte_instance.p_reg, NRF_UARTE_INT_RXDRDY_MASK) &&
+        nrf_uarte_event_check(uarte_instance.p_reg, NRF_UARTE_EVENT_RXDRDY))
+    {
+        transport_evt_t evt = {.type = TRANSPORT_EVT_RX_WAKE};
+
+        nrf_uarte_int_disable(uarte_instance.p_reg, NRF_UARTE_INT_RXDRDY_MASK);
+        m_handler(&evt);
+    }
+
+    nrfx_uarte_0_irq_handler();
+}